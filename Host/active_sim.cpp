@@ -0,0 +1,161 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  active_sim.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Run the active cooling engine against a simulated zone whose fan speeds
+//  up its cooling, next to a policy that follows the trips directly, and
+//  report fan switches of both. The level lookup is then checked against a
+//  linear scan over every temperature and timed in decisions per second.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ActivePolicy.hpp"
+#include "bench.h"
+
+static uint32_t parseTrips(char *arg, uint32_t *trips) {
+    uint32_t count = 0;
+    for (char *token = strtok(arg, ","); token && count < ACTIVE_TRIP_COUNT; token = strtok(nullptr, ","))
+        trips[count++] = (uint32_t)strtoul(token, nullptr, 0);
+    return count;
+}
+
+struct Zone {
+    double temperature;
+    uint32_t seed;
+    uint32_t level;
+    uint32_t switches;
+    uint64_t percent;           // sum over ticks
+    uint64_t over;              // ticks above the hottest trip
+};
+
+// 25 C ambient, 4 K/W passive, the fan at full speed cools three times as well, 20 s time constant
+static uint32_t stepZone(Zone *zone, uint32_t i, uint32_t period, uint32_t levels) {
+    const double ambient = 2982, resistance = 40, tau = 20000.0 / period;
+    zone->seed = zone->seed * 1103515245 + 12345;
+    double power = (i / 300) % 2 ? 6 : 22;
+    power *= 0.8 + (zone->seed >> 16) % 100 / 250.0;
+    double fan = levels ? (double)zone->level / levels : 0;
+    double target = ambient + power * resistance / (1 + 2 * fan);
+    zone->temperature += (target - zone->temperature) / tau;
+    // Half a degree of sensor noise
+    zone->seed = zone->seed * 1103515245 + 12345;
+    return (uint32_t)(zone->temperature + (int)((zone->seed >> 16) % 11) - 5);
+}
+
+int main(int argc, char **argv) {
+    uint32_t trips[ACTIVE_TRIP_COUNT] = { 3232, 3332, 3432, 3532 };    // 50 to 80 C
+    uint32_t count = 4;
+    uint32_t hysteresis = 20;
+    uint32_t up = ACTIVE_RAMP_UP_MS, down = ACTIVE_RAMP_DOWN_MS;
+    uint32_t period = 1000;
+    uint32_t ticks = 86400;
+    uint32_t decisions = 10000000;
+    bool quiet = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:d:n:p:qu:y:")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 'a':
+                ok = (count = parseTrips(optarg, trips)) != 0;
+                break;
+            case 'b':
+                decisions = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'd':
+                down = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'n':
+                ticks = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'p':
+                period = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'u':
+                up = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'y':
+                hysteresis = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok || !period) {
+            fprintf(stderr, "usage: %s [-a trip,trip,...] [-y hysteresis_dK] [-u up_ms] [-d down_ms] [-p period_ms] [-n ticks] [-b decisions] [-q]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    ActivePolicy policy;
+    uint32_t levels = policy.configure(trips, count, hysteresis);
+    policy.setRamp(up, down);
+    if (!levels) {
+        fprintf(stderr, "no valid trips\n");
+        return 2;
+    }
+    uint32_t hottest = policy.getTrip(levels - 1);
+
+    // Same workload and noise for both, only the policy differs
+    Zone engine = { 2982, 1, 0, 0, 0, 0 }, direct = engine;
+    if (!quiet)
+        printf("# ms engine_dK engine_level direct_dK direct_level\n");
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t ms = i * period;
+        uint32_t temperature = stepZone(&engine, i, period, levels);
+        if (policy.update(temperature, ms))
+            engine.switches++;
+        engine.level = policy.getLevel();
+        engine.percent += policy.getPercent();
+        engine.over += temperature > hottest;
+
+        uint32_t reading = stepZone(&direct, i, period, levels);
+        uint32_t level = policy.levelOf(reading);
+        direct.switches += level != direct.level;
+        direct.level = level;
+        direct.percent += level * 100 / levels;
+        direct.over += reading > hottest;
+
+        if (!quiet)
+            printf("%u %u %u %u %u\n", ms, temperature, engine.level, reading, direct.level);
+    }
+    fprintf(stderr, "%u ticks, %u levels: engine %u switches, mean fan %.1f%%, %llu ticks over the top trip\n",
+            ticks, levels, engine.switches, ticks ? (double)engine.percent / ticks : 0.0, (unsigned long long)engine.over);
+    fprintf(stderr, "%u ticks, %u levels: direct %u switches, mean fan %.1f%%, %llu ticks over the top trip\n",
+            ticks, levels, direct.switches, ticks ? (double)direct.percent / ticks : 0.0, (unsigned long long)direct.over);
+
+    // Every temperature from below the first trip to past the last one
+    uint32_t errors = 0;
+    uint32_t low = policy.getTrip(0) > 1000 ? policy.getTrip(0) - 1000 : 0;
+    for (uint32_t t = low; t <= hottest + 1000; t++) {
+        uint32_t expected = 0;
+        while (expected < levels && t >= policy.getTrip(expected))
+            expected++;
+        if (policy.levelOf(t) != expected && errors++ < 10)
+            fprintf(stderr, "%u dK: level %u, expected %u\n", t, policy.levelOf(t), expected);
+    }
+
+    // Throughput over readings spread across the trips
+    uint32_t seed = 7, sum = 0, range = hottest + 200 - low;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < decisions; i++) {
+        seed = seed * 1103515245 + 12345;
+        sum += policy.update(low + (seed >> 8) % range, i * period);
+    }
+    uint64_t elapsed = now_ns() - start;
+    fprintf(stderr, "%u decisions in %.1f ms, %.1f M decisions/s, %u switches\n", decisions, elapsed / 1e6,
+            elapsed ? decisions * 1e3 / elapsed : 0.0, sum);
+
+    if (errors)
+        fprintf(stderr, "%u errors\n", errors);
+    return errors ? 1 : 0;
+}
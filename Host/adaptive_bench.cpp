@@ -0,0 +1,177 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  adaptive_bench.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Replay a synthetic input trace against the APCT table of captured GDDV
+//  blobs and compare full against incremental re-evaluation. Every tick
+//  moves the temperature, other inputs change occasionally, as they do on
+//  a real system. Both evaluators must agree on every tick.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "AdaptivePolicy.hpp"
+#include "bench.h"
+
+static bool loadImage(const char *path, std::vector<uint8_t> &blob, DataVaultCache &cache, DataVaultIndex &index) {
+    int err = checkDataVaultHeader(blob.data(), blob.size());
+    if (err != kDataVaultOK) {
+        fprintf(stderr, "%s: %s\n", path, dataVaultError(err));
+        return false;
+    }
+    const GDDVHeader *hdr = reinterpret_cast<const GDDVHeader *>(blob.data());
+    if (isDataVaultCompressed(hdr))
+        err = cache.load(hdr);
+    else if (hdr->version.major == 2)
+        err = kDataVaultUnsupported;
+    else
+        err = index.build(blob.data(), (uint32_t)blob.size());
+    if (err != kDataVaultOK) {
+        fprintf(stderr, "%s: %s\n", path, dataVaultError(err));
+        return false;
+    }
+    return true;
+}
+
+// One input change per tick, drawn from the values the table compares against.
+// Temperature steps go to one of the devices the table names, or the shared input.
+struct Step {
+    uint32_t condition;
+    uint32_t device;
+    int64_t value;
+};
+
+static void apply(const AdaptivePolicy &policy, AdaptiveInputs &inputs, const Step &step) {
+    if (step.condition == Temperature && step.device < policy.getDeviceCount())
+        inputs.setDevice(step.device, step.value);
+    else
+        inputs.set(step.condition, step.value);
+}
+
+static void makeTrace(const AdaptivePolicy &policy, unsigned ticks, std::vector<Step> &trace) {
+    std::vector<int64_t> values[ADAPTIVE_CONDITION_MAX];
+    for (uint32_t i = 0; i < policy.getConditionCount(); i++) {
+        const AdaptiveCondition *condition = policy.getCondition(i);
+        if (condition->condition > Default)
+            values[condition->condition].push_back(condition->argument);
+    }
+    std::vector<uint32_t> others;
+    for (uint32_t c = Default + 1; c < ADAPTIVE_CONDITION_MAX; c++)
+        if (!values[c].empty() && c != Temperature)
+            others.push_back(c);
+
+    srand(1);
+    for (unsigned i = 0; i < ticks; i++) {
+        uint32_t c = Temperature;
+        if ((values[Temperature].empty() || rand() % 8 == 0) && !others.empty())
+            c = others[rand() % others.size()];
+        if (values[c].empty())
+            continue;
+        uint32_t device = rand() % (policy.getDeviceCount() + 1);
+        trace.push_back({c, device, values[c][rand() % values[c].size()] + rand() % 3 - 1});
+    }
+}
+
+static int benchFile(const char *path, unsigned ticks) {
+    std::vector<uint8_t> blob;
+    if (!readFile(path, blob)) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return 1;
+    }
+
+    DataVaultCache cache;
+    DataVaultIndex plain;
+    if (!loadImage(path, blob, cache, plain))
+        return 1;
+    DataVaultIndex &index = cache.index.getCount() ? cache.index : plain;
+
+    DataVaultKey key;
+    uint32_t i;
+    for (i = 0; index.getKey(i, &key); i++)
+        if (key.type == ESIF_DATA_BINARY && classifyDataVaultKey(key.name) == kDataVaultTableAPCT)
+            break;
+    if (i == index.getCount()) {
+        fprintf(stderr, "%s: no APCT\n", path);
+        return 1;
+    }
+
+    AdaptivePolicy full, incremental;
+    int err = full.compile(key.value, key.length);
+    if (err == kDataVaultOK)
+        err = incremental.compile(key.value, key.length);
+    if (err != kDataVaultOK) {
+        fprintf(stderr, "%s: %s: %s\n", path, key.name, dataVaultError(err));
+        return 1;
+    }
+
+    std::vector<Step> trace;
+    makeTrace(full, ticks, trace);
+    std::vector<uint64_t> expected(trace.size()), actual(trace.size());
+
+    AdaptiveInputs inputs;
+    uint64_t start = now_ns();
+    for (size_t t = 0; t < trace.size(); t++) {
+        apply(full, inputs, trace[t]);
+        inputs.now = (t + 1) * 1000;
+        expected[t] = full.evaluate(inputs);
+    }
+    double full_ns = (double)(now_ns() - start) / (trace.size() ? trace.size() : 1);
+
+    AdaptiveInputs delta;
+    start = now_ns();
+    for (size_t t = 0; t < trace.size(); t++) {
+        apply(incremental, delta, trace[t]);
+        delta.now = (t + 1) * 1000;
+        actual[t] = incremental.update(delta);
+    }
+    double incremental_ns = (double)(now_ns() - start) / (trace.size() ? trace.size() : 1);
+
+    size_t changes = 0;
+    for (size_t t = 0; t < trace.size(); t++) {
+        if (expected[t] != actual[t]) {
+            fprintf(stderr, "%s: tick %zu: full %lld, incremental %lld\n", path, t,
+                    (long long)expected[t], (long long)actual[t]);
+            return 1;
+        }
+        changes += t && expected[t] != expected[t - 1];
+    }
+
+    printf("%s: %s v%llu, %u sets, %u conditions, %u devices, %zu ticks, %zu target changes\n", path, key.name,
+           (unsigned long long)full.getVersion(), full.getTargetCount(), full.getConditionCount(),
+           full.getDeviceCount(), trace.size(), changes);
+    printf("  full         %10.1f ns/tick\n", full_ns);
+    printf("  incremental  %10.1f ns/tick  (%.1fx)\n", incremental_ns, incremental_ns ? full_ns / incremental_ns : 0.0);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n ticks] gddv.bin...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned ticks = 100000;
+    int i, ret = 0;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            ticks = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (i == argc || ticks == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (; i < argc; i++)
+        ret |= benchFile(argv[i], ticks);
+    return ret;
+}
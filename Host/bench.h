@@ -0,0 +1,39 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  bench.h
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Clock and file helpers shared by the host tools.
+//
+
+#ifndef bench_h
+#define bench_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline bool readFile(const char *path, std::vector<uint8_t> &out) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        out.insert(out.end(), chunk, chunk + n);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+#endif /* bench_h */
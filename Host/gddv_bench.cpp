@@ -0,0 +1,483 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  gddv_bench.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Parse captured GDDV blobs repeatedly and report parse cost per key,
+//  both for a full walk and for the key index with on-demand decode.
+//  A blob is the raw buffer returned by GDDV, e.g. the data_vault attribute
+//  of INT3400 on Linux. Without blobs, only the payload_hash cache is checked
+//  on a compressed DataVault built in memory.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "DataVault.hpp"
+#include "bench.h"
+
+// Keeps decode results alive so the timed loops are not optimized out
+static volatile uint64_t sink;
+
+// Decode a table value the way the kext does, folding every field into a checksum
+static uint64_t decodeTable(int table, const uint8_t *data, uint32_t length) {
+    DataVaultCursor cursor(data, length);
+    uint64_t sum = 0, version = 0;
+
+    switch (table) {
+        case kDataVaultTableAPAT: {
+            APATEntry entry;
+            if (!readTableVersion(cursor, &version) || version != 2)
+                break;
+            while (nextAPATEntry(cursor, &entry))
+                sum += entry.target_id + entry.domain + entry.name[0] + entry.code[0];
+            break;
+        }
+
+        case kDataVaultTableAPCT: {
+            uint64_t target;
+            uint32_t count;
+            if (!readTableVersion(cursor, &version))
+                break;
+            while (nextAPCTTarget(cursor, version, &target, &count)) {
+                APCTCondition condition;
+                uint32_t index = 0;
+                while (nextAPCTCondition(cursor, version, index, count, &condition))
+                    sum += target + condition.condition + condition.comparison + condition.argument + condition.time;
+            }
+            break;
+        }
+
+        case kDataVaultTableAPPC: {
+            APPCEntry entry;
+            if (!readTableVersion(cursor, &version) || version != 1)
+                break;
+            while (nextAPPCEntry(cursor, &entry))
+                sum += entry.condition + entry.domain + entry.type + entry.name[0];
+            break;
+        }
+
+        case kDataVaultTablePPCC: {
+            PPCCTable ppcc;
+            if (readPPCC(data, length, &ppcc))
+                sum += ppcc.power_limit_min + ppcc.power_limit_max + ppcc.step_size + ppcc.extra_count;
+            break;
+        }
+
+        case kDataVaultTablePSVT: {
+            PSVTEntry entry;
+            if (!readTableVersion(cursor, &version) || version != 2)
+                break;
+            while (nextPSVTEntry(cursor, &entry))
+                sum += entry.priority + entry.sample_period + entry.temp + entry.limit + entry.source[0];
+            break;
+        }
+
+        case kDataVaultTableIDSP: {
+            const uint8_t *guid;
+            while (nextIDSPEntry(cursor, &guid))
+                sum += guid[0] + guid[15];
+            break;
+        }
+
+        default: {
+            BinaryItem item;
+            while (nextBinaryItem(cursor, &item))
+                sum += item.type + item.number + item.length;
+            break;
+        }
+    }
+    return sum + cursor.failed();
+}
+
+static uint64_t decodeKey(const DataVaultKey &key) {
+    if (key.name[0] != '/' || key.flags != 1)
+        return 0;
+
+    switch (key.type) {
+        case ESIF_DATA_BINARY:
+            return decodeTable(classifyDataVaultKey(key.name), key.value, key.length);
+
+        case ESIF_DATA_STRING:
+        case ESIF_DATA_JSON:
+            return strnlen(reinterpret_cast<const char *>(key.value), key.length);
+
+        default:
+            return key.length ? key.value[0] : 0;
+    }
+}
+
+class DecodeVisitor : public DataVaultVisitor {
+public:
+    uint64_t sum {0};
+    uint32_t keys {0};
+
+    bool visitKey(const DataVaultKey &key) override {
+        sum += decodeKey(key);
+        keys++;
+        return true;
+    }
+};
+
+class CollectVisitor : public DataVaultVisitor {
+public:
+    std::vector<DataVaultKey> keys;
+
+    bool visitKey(const DataVaultKey &key) override {
+        keys.push_back(key);
+        return true;
+    }
+};
+
+static const char *tableName(const DataVaultKey &key) {
+    static const char *names[] = {"binary", "apat", "apct", "appc", "ppcc", "psvt", "idsp"};
+    switch (key.type) {
+        case ESIF_DATA_BINARY:
+            return names[classifyDataVaultKey(key.name)];
+        case ESIF_DATA_STRING:
+            return "string";
+        case ESIF_DATA_JSON:
+            return "json";
+        case ESIF_DATA_TEMPERATURE:
+            return "temp";
+        case ESIF_DATA_UINT32:
+        case ESIF_DATA_POWER:
+            return "uint32";
+        default:
+            return "other";
+    }
+}
+
+// A cache hit must not decode at all: after loading, wipe the compressed stream but keep
+// payload_hash, then check the lookup still hits and serves the original image in place.
+// A different hash must miss, and load again.
+static bool checkCache(const char *path, const std::vector<uint8_t> &blob, unsigned iterations, double *hit_ns) {
+    std::vector<uint8_t> copy(blob);
+    GDDVHeader *hdr = reinterpret_cast<GDDVHeader *>(copy.data());
+    DataVaultCache cache;
+
+    if (cache.lookup(hdr) || cache.load(hdr) != kDataVaultOK) {
+        fprintf(stderr, "%s: cache load failed\n", path);
+        return false;
+    }
+    const uint8_t *image = cache.decoder.getImage();
+    uint32_t keys = cache.index.getCount();
+
+    memset(copy.data() + hdr->headersize, 0, copy.size() - hdr->headersize);
+    uint64_t start = now_ns();
+    for (unsigned i = 0; i < iterations; i++) {
+        if (!cache.lookup(hdr)) {
+            fprintf(stderr, "%s: cache missed an unchanged payload\n", path);
+            return false;
+        }
+    }
+    *hit_ns = (double)(now_ns() - start) / iterations;
+
+    if (cache.decoder.getImage() != image || cache.index.getCount() != keys || cache.misses != 1) {
+        fprintf(stderr, "%s: cache hit touched the decoded image\n", path);
+        return false;
+    }
+
+    hdr->v2.payload_hash[0] ^= 1;
+    if (cache.lookup(hdr) || cache.hits != iterations || cache.misses != 2) {
+        fprintf(stderr, "%s: cache hit on a different payload_hash\n", path);
+        return false;
+    }
+
+    // The new hash is cached once its payload is loaded
+    copy = blob;
+    hdr = reinterpret_cast<GDDVHeader *>(copy.data());
+    hdr->v2.payload_hash[0] ^= 1;
+    if (cache.load(hdr) != kDataVaultOK || !cache.lookup(hdr) || cache.index.getCount() != keys) {
+        fprintf(stderr, "%s: cache did not take the reloaded payload\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Range coder of LZMA, only ever coding literals. Enough to build a payload the real
+// decoder accepts without an encoder in the tree.
+class LiteralEncoder {
+    std::vector<uint8_t> &out;
+    uint64_t low {0};
+    uint32_t range {0xFFFFFFFF};
+    uint8_t cache {0};
+    uint64_t cacheSize {1};
+    // lc = 3, lp = 0, pb = 2
+    uint16_t isMatch[12 << 2];
+    uint16_t literal[0x300 << 3];
+
+    void shiftLow() {
+        if ((uint32_t)low < 0xFF000000 || (low >> 32)) {
+            uint8_t carry = (uint8_t)(low >> 32);
+            uint8_t temp = cache;
+            do {
+                out.push_back(temp + carry);
+                temp = 0xFF;
+            } while (--cacheSize);
+            cache = (uint8_t)((uint32_t)low >> 24);
+        }
+        cacheSize++;
+        low = (uint32_t)low << 8;
+    }
+
+    void encodeBit(uint16_t *prob, uint32_t bit) {
+        uint32_t bound = (range >> 11) * *prob;
+        if (!bit) {
+            range = bound;
+            *prob += (2048 - *prob) >> 5;
+        } else {
+            low += bound;
+            range -= bound;
+            *prob -= *prob >> 5;
+        }
+        while (range < (1u << 24)) {
+            range <<= 8;
+            shiftLow();
+        }
+    }
+
+public:
+    explicit LiteralEncoder(std::vector<uint8_t> &out) : out(out) {
+        for (uint16_t &prob : isMatch)
+            prob = 1024;
+        for (uint16_t &prob : literal)
+            prob = 1024;
+    }
+
+    void encode(const uint8_t *data, size_t length) {
+        uint8_t previous = 0;
+        for (size_t pos = 0; pos < length; pos++) {
+            // Only literals, so the state stays 0
+            encodeBit(&isMatch[pos & 3], 0);
+            uint16_t *probs = &literal[0x300 * (previous >> 5)];
+            uint32_t symbol = 1;
+            for (int bit = 7; bit >= 0; bit--) {
+                uint32_t b = (data[pos] >> bit) & 1;
+                encodeBit(&probs[symbol], b);
+                symbol = (symbol << 1) | b;
+            }
+            previous = data[pos];
+        }
+        for (int i = 0; i < 5; i++)
+            shiftLow();
+    }
+};
+
+static void appendKey(std::vector<uint8_t> &image, const char *name, uint32_t type, const void *value, uint32_t length) {
+    GDDVKeyHeader key = { 1, (uint32_t)strlen(name) + 1 };
+    GDDVKeyHeader val = { type, length };
+    image.insert(image.end(), reinterpret_cast<const uint8_t *>(&key), reinterpret_cast<const uint8_t *>(&key + 1));
+    image.insert(image.end(), name, name + key.length);
+    image.insert(image.end(), reinterpret_cast<const uint8_t *>(&val), reinterpret_cast<const uint8_t *>(&val + 1));
+    image.insert(image.end(), reinterpret_cast<const uint8_t *>(value), reinterpret_cast<const uint8_t *>(value) + length);
+}
+
+// A v1 image of a few keys, compressed into a v2 DataVault as firmware ships it
+static std::vector<uint8_t> syntheticDataVault() {
+    std::vector<uint8_t> image(offsetof(GDDVHeader, v1) + sizeof(uint32_t));
+    GDDVHeader *inner = reinterpret_cast<GDDVHeader *>(image.data());
+    inner->signature = ESIFDV_HEADER_SIGNATURE;
+    inner->headersize = (uint16_t)image.size();
+    inner->version.major = 1;
+    uint32_t number = 42;
+    appendKey(image, "/participants/IETM.D0/_ppcc", ESIF_DATA_UINT32, &number, sizeof(number));
+    appendKey(image, "/shared/export/workload", ESIF_DATA_STRING, "balanced", sizeof("balanced"));
+    appendKey(image, "/shared/tables/psvt/_psv", ESIF_DATA_BINARY, "\x02\x00", 2);
+
+    std::vector<uint8_t> blob(sizeof(GDDVHeader));
+    const uint8_t lzma[5] = { 0x5D, 0x00, 0x00, 0x01, 0x00 };
+    uint64_t size = image.size();
+    blob.insert(blob.end(), lzma, lzma + sizeof(lzma));
+    blob.insert(blob.end(), reinterpret_cast<const uint8_t *>(&size), reinterpret_cast<const uint8_t *>(&size + 1));
+    LiteralEncoder(blob).encode(image.data(), image.size());
+
+    GDDVHeader *hdr = reinterpret_cast<GDDVHeader *>(blob.data());
+    hdr->signature = ESIFDV_HEADER_SIGNATURE;
+    hdr->headersize = sizeof(GDDVHeader);
+    hdr->version.major = 2;
+    hdr->v2.flags = ESIF_SERVICE_CONFIG_COMPRESSED;
+    hdr->v2.payload_size = (uint32_t)(blob.size() - sizeof(GDDVHeader));
+    for (int i = 0; i < SHA256_HASH_BYTES; i++)
+        hdr->v2.payload_hash[i] = (uint8_t)(i * 7 + 1);
+    return blob;
+}
+
+static bool checkSyntheticCache(unsigned iterations) {
+    std::vector<uint8_t> blob = syntheticDataVault();
+    const char *path = "synthetic";
+    int err = checkDataVaultHeader(blob.data(), blob.size());
+    if (err != kDataVaultOK) {
+        fprintf(stderr, "%s: %s\n", path, dataVaultError(err));
+        return false;
+    }
+
+    DataVaultCache cache;
+    GDDVHeader *hdr = reinterpret_cast<GDDVHeader *>(blob.data());
+    DataVaultKey key;
+    if ((err = cache.load(hdr)) != kDataVaultOK || cache.index.getCount() != 3 ||
+        !cache.index.find("/shared/export/workload", &key) || strcmp(reinterpret_cast<const char *>(key.value), "balanced")) {
+        fprintf(stderr, "%s: decoded payload does not match: %s\n", path, dataVaultError(err));
+        return false;
+    }
+
+    // Firmware that leaves the hash empty is decoded every time
+    memset(hdr->v2.payload_hash, 0, SHA256_HASH_BYTES);
+    if (cache.load(hdr) != kDataVaultOK || cache.lookup(hdr)) {
+        fprintf(stderr, "%s: cache hit on an empty payload_hash\n", path);
+        return false;
+    }
+
+    double hit_ns;
+    if (!checkCache(path, syntheticDataVault(), iterations, &hit_ns))
+        return false;
+    printf("%s: %zu bytes, payload_hash cache hit %.1f ns\n", path, blob.size(), hit_ns);
+    return true;
+}
+
+static int benchFile(const char *path, unsigned iterations, bool verbose) {
+    std::vector<uint8_t> blob, image;
+    if (!readFile(path, blob)) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return 1;
+    }
+
+    int err = checkDataVaultHeader(blob.data(), blob.size());
+    if (err != kDataVaultOK) {
+        fprintf(stderr, "%s: %s\n", path, dataVaultError(err));
+        return 1;
+    }
+
+    const GDDVHeader *hdr = reinterpret_cast<const GDDVHeader *>(blob.data());
+    double decompress_ns = 0, stream_ns = 0, hit_ns = 0;
+    if (isDataVaultCompressed(hdr)) {
+        DataVaultDecoder decoder;
+        uint64_t start = now_ns();
+        for (unsigned i = 0; i < iterations; i++) {
+            if ((err = decoder.begin(hdr)) != kDataVaultOK || (err = decoder.decode(nullptr)) != kDataVaultOK) {
+                fprintf(stderr, "%s: %s\n", path, dataVaultError(err));
+                return 1;
+            }
+        }
+        decompress_ns = (double)(now_ns() - start) / iterations;
+        image.assign(decoder.getImage(), decoder.getImage() + decoder.getLength());
+
+        // Index keys while decoding, as the kext does at boot
+        DataVaultIndex index;
+        start = now_ns();
+        for (unsigned i = 0; i < iterations; i++) {
+            DataVaultIndexBuilder builder(index);
+            decoder.begin(hdr);
+            index.reset(decoder.getImage(), decoder.getLength());
+            err = decoder.decode(&builder);
+            index.finish();
+        }
+        stream_ns = (double)(now_ns() - start) / iterations;
+        if (err != kDataVaultOK)
+            fprintf(stderr, "%s: streaming walk stopped: %s\n", path, dataVaultError(err));
+
+        if (!checkCache(path, blob, iterations, &hit_ns))
+            return 1;
+    } else if (hdr->version.major == 2) {
+        fprintf(stderr, "%s: uncompressed v2 payload not supported\n", path);
+        return 1;
+    } else {
+        image = blob;
+    }
+
+    CollectVisitor collect;
+    err = walkDataVault(image.data(), (uint32_t)image.size(), collect);
+    if (err != kDataVaultOK)
+        fprintf(stderr, "%s: walk stopped: %s\n", path, dataVaultError(err));
+
+    DecodeVisitor decode;
+    uint64_t start = now_ns();
+    for (unsigned i = 0; i < iterations; i++)
+        walkDataVault(image.data(), (uint32_t)image.size(), decode);
+    double parse_ns = (double)(now_ns() - start) / iterations;
+
+    DataVaultIndex index;
+    start = now_ns();
+    for (unsigned i = 0; i < iterations; i++)
+        index.build(image.data(), (uint32_t)image.size());
+    double index_ns = (double)(now_ns() - start) / iterations;
+
+    // Look every key up by path and decode it, as a GDDVQuery would
+    uint64_t found = 0;
+    start = now_ns();
+    for (unsigned i = 0; i < iterations; i++) {
+        for (const DataVaultKey &key : collect.keys) {
+            DataVaultKey match;
+            if (index.find(key.name, &match))
+                found += decodeKey(match);
+        }
+    }
+    double lookup_ns = (double)(now_ns() - start) / iterations;
+    sink += found;
+
+    size_t keys = collect.keys.size();
+    printf("%s: %zu bytes, %zu decompressed, %zu keys\n", path, blob.size(), image.size(), keys);
+    if (decompress_ns)
+        printf("  decompress   %12.0f ns  %8.1f MB/s\n", decompress_ns, blob.size() * 1e3 / decompress_ns);
+    if (stream_ns)
+        printf("  decode+index %12.0f ns  %8.1f MB/s\n", stream_ns, blob.size() * 1e3 / stream_ns);
+    if (hit_ns)
+        printf("  cache hit    %12.1f ns\n", hit_ns);
+    printf("  walk+decode  %12.0f ns  %8.1f MB/s  %8.1f ns/key  (checksum %llx)\n",
+           parse_ns, image.size() * 1e3 / parse_ns, keys ? parse_ns / keys : 0.0,
+           (unsigned long long)decode.sum);
+    printf("  index build  %12.0f ns  %8.1f MB/s  %8.1f ns/key  (%zu bytes)\n",
+           index_ns, image.size() * 1e3 / index_ns, keys ? index_ns / keys : 0.0, index.getIndexSize());
+    printf("  find+decode  %12.0f ns  %8s       %8.1f ns/key\n", lookup_ns, "", keys ? lookup_ns / keys : 0.0);
+
+    if (!verbose)
+        return 0;
+
+    printf("  %-48s %-7s %8s %10s %8s\n", "key", "kind", "bytes", "ns", "MB/s");
+    for (const DataVaultKey &key : collect.keys) {
+        uint64_t sum = 0;
+        start = now_ns();
+        for (unsigned i = 0; i < iterations; i++)
+            sum += decodeKey(key);
+        double key_ns = (double)(now_ns() - start) / iterations;
+        sink += sum;
+        printf("  %-48s %-7s %8u %10.1f %8.1f\n", key.name, tableName(key), key.length, key_ns,
+               key_ns ? key.length * 1e3 / key_ns : 0.0);
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n iterations] [-q] gddv.bin...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned iterations = 1000;
+    bool verbose = true;
+    int i, ret = 0;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "-q")) {
+            verbose = false;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!checkSyntheticCache(iterations))
+        ret = 1;
+    for (; i < argc; i++)
+        ret |= benchFile(argv[i], iterations, verbose);
+    return ret;
+}
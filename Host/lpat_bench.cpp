@@ -0,0 +1,132 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  lpat_bench.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Time LPAT conversions on thermistor-like tables of several sizes. The
+//  linear scan and the binary search are checked against each other and
+//  against the division-per-read conversion of linux/drivers/acpi/acpi_lpat.c.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "LPAT.hpp"
+#include "bench.h"
+
+// Raw value falls as the temperature rises, like an NTC divider, from -40 to 110 deci-Celsius
+static std::vector<int32_t> makeTable(uint32_t points) {
+    std::vector<int32_t> values;
+    for (uint32_t i = 0; i < points; i++) {
+        double x = (double)i / (points - 1);
+        values.push_back(-400 + (int32_t)(1500 * x));
+        values.push_back(4000 - (int32_t)(3800 * pow(x, 1.5)) - (int32_t)i);
+    }
+    return values;
+}
+
+static bool reference(const std::vector<int32_t> &values, int32_t raw, int32_t *temp) {
+    size_t count = values.size() / 2;
+    int32_t delta = values[3] - values[1];
+    size_t i;
+    for (i = 0; i < count; i++) {
+        int32_t point = values[i * 2 + 1];
+        if ((delta > 0 && raw <= point) || (delta < 0 && raw >= point))
+            break;
+    }
+    // acpi_lpat rejects the first point itself, LPATTable accepts the closed range
+    if (i == count || (i == 0 && raw != values[1]))
+        return false;
+    if (i == 0)
+        i = 1;
+    int32_t t0 = values[(i - 1) * 2], r0 = values[(i - 1) * 2 + 1];
+    int32_t t1 = values[i * 2], r1 = values[i * 2 + 1];
+    *temp = (t1 - t0) * (raw - r0) / (r1 - r0) + t0;
+    return true;
+}
+
+typedef bool (LPATTable::*Converter)(int32_t, int32_t *) const;
+
+static double timeConverter(const LPATTable &table, Converter convert, const std::vector<int32_t> &raws, int rounds, int64_t *sum) {
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int32_t raw : raws) {
+            int32_t temp = 0;
+            (table.*convert)(raw, &temp);
+            *sum += temp;
+        }
+    }
+    return (double)(now_ns() - start) / ((double)rounds * raws.size());
+}
+
+int main(int argc, char **argv) {
+    int rounds = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n')
+            rounds = atoi(optarg);
+        else {
+            fprintf(stderr, "usage: %s [-n rounds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    bool ok = true;
+    int64_t sum = 0;
+    const uint32_t sizes[] = {4, 8, 12, 16, 24, 32, 64};
+    for (uint32_t points : sizes) {
+        std::vector<int32_t> values = makeTable(points);
+        LPATTable table;
+        if (!table.build(values.data(), (uint32_t)values.size())) {
+            fprintf(stderr, "%u points: build failed\n", points);
+            return 1;
+        }
+
+        int32_t low = values[values.size() - 1], high = values[1];
+        std::vector<int32_t> raws;
+        srand(points);
+        for (int i = 0; i < 4096; i++)
+            raws.push_back(low + rand() % (high - low + 1));
+
+        for (int32_t raw = low - 1; raw <= high + 1; raw++) {
+            int32_t expected = 0, linear = 0, search = 0;
+            bool inRange = reference(values, raw, &expected);
+            bool okSearch = table.convertSearch(raw, &search);
+            bool okLinear = points > LPAT_LINEAR_POINTS || table.convertLinear(raw, &linear);
+            if (okSearch != inRange || (points <= LPAT_LINEAR_POINTS && okLinear != inRange) ||
+                (inRange && (abs(search - expected) > 1 || (points <= LPAT_LINEAR_POINTS && linear != search)))) {
+                fprintf(stderr, "%u points: raw %d gives %d/%d, expected %d\n", points, raw, linear, search, expected);
+                ok = false;
+                break;
+            }
+        }
+
+        uint64_t start = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            for (int32_t raw : raws) {
+                int32_t temp = 0;
+                reference(values, raw, &temp);
+                sum += temp;
+            }
+        }
+        double ref = (double)(now_ns() - start) / ((double)rounds * raws.size());
+        double search = timeConverter(table, &LPATTable::convertSearch, raws, rounds, &sum);
+        double linear = points <= LPAT_LINEAR_POINTS ? timeConverter(table, &LPATTable::convertLinear, raws, rounds, &sum) : 0;
+        double chosen = timeConverter(table, &LPATTable::convert, raws, rounds, &sum);
+
+        printf("%2u points: reference %.2f ns, search %.2f ns, ", points, ref, search);
+        if (linear)
+            printf("linear %.2f ns, ", linear);
+        else
+            printf("linear n/a, ");
+        printf("convert %.2f ns per conversion\n", chosen);
+    }
+    if (!sum)
+        printf("\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  power_trace.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Feed the power-limit controller a temperature trace and print the limits
+//  it programs, one line per tick. A trace file holds "ms deci-Kelvin" lines.
+//  Without one, a lumped thermal model is run in closed loop with a bursty
+//  workload drawing up to the programmed PL1. Every limit is checked to stay
+//  inside its PPCC range on a step boundary.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "PowerController.hpp"
+#include "bench.h"
+
+static bool parseRange(const char *arg, PowerLimitRange *range) {
+    return sscanf(arg, "%u,%u,%u", &range->min_uw, &range->max_uw, &range->step_uw) == 3 &&
+           range->min_uw <= range->max_uw;
+}
+
+struct Sample {
+    uint32_t ms;
+    uint32_t temperature;
+};
+
+static bool readTrace(const char *path, std::vector<Sample> *trace) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        Sample sample;
+        if (line[0] == '#' || sscanf(line, "%u %u", &sample.ms, &sample.temperature) != 2)
+            continue;
+        trace->push_back(sample);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool inRange(const PowerLimitRange &range, uint32_t limit) {
+    if (limit < range.min_uw || limit > range.max_uw)
+        return false;
+    return limit == range.max_uw || !range.step_uw || (limit - range.min_uw) % range.step_uw == 0;
+}
+
+int main(int argc, char **argv) {
+    PowerLimitRange ranges[POWER_LIMIT_COUNT] = {
+        { 15000000, 28000000, 250000 },
+        { 28000000, 51000000, 250000 },
+    };
+    uint32_t rangeCount = POWER_LIMIT_COUNT;
+    PowerControllerInputs inputs = { 0, 3532, 0 };     // hold 80 C
+    uint32_t period = 1000;
+    uint32_t ticks = 3600;
+    bool quiet = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "1:2:c:n:p:qt:")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case '1':
+                ok = parseRange(optarg, &ranges[0]);
+                break;
+            case '2':
+                if (!strcmp(optarg, "none"))
+                    rangeCount = 1;
+                else
+                    ok = parseRange(optarg, &ranges[1]);
+                break;
+            case 'c':
+                inputs.ceiling_uw = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'n':
+                ticks = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'p':
+                period = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 't':
+                inputs.target = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok || !period) {
+            fprintf(stderr, "usage: %s [-1 min,max,step] [-2 min,max,step|none] [-c ceiling_uw] [-t target_dK] [-p period_ms] [-n ticks] [-q] [trace]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Sample> trace;
+    bool simulate = optind >= argc;
+    if (!simulate) {
+        if (!readTrace(argv[optind], &trace))
+            return 1;
+        ticks = (uint32_t)trace.size();
+    }
+
+    PowerController controller;
+    controller.configure(ranges, rangeCount);
+
+    // Lumped model: 25 C ambient, 2.5 K/W to ambient, 30 s time constant
+    const double ambient = 2982, resistance = 25, tau = 30000.0 / period;
+    double temperature = ambient;
+    uint32_t seed = 1;
+
+    uint64_t over = 0, errors = 0, sum = 0, elapsed = 0;
+    uint32_t hottest = 0;
+    if (!quiet)
+        printf("# ms temperature_dK pl1_uw pl2_uw\n");
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t ms;
+        if (simulate) {
+            // Alternate heavy and light phases with some noise
+            seed = seed * 1103515245 + 12345;
+            double demand = (i / 120) % 2 ? 8e6 : 45e6;
+            demand *= 0.9 + (seed >> 16) % 100 / 500.0;
+            double power = demand < controller.getLimit(0) ? demand : controller.getLimit(0);
+            temperature += (ambient + power / 1e6 * resistance - temperature) / tau;
+            inputs.temperature = (uint32_t)temperature;
+            ms = i * period;
+        } else {
+            inputs.temperature = trace[i].temperature;
+            ms = trace[i].ms;
+        }
+
+        uint64_t start = now_ns();
+        controller.step(inputs);
+        elapsed += now_ns() - start;
+
+        for (uint32_t j = 0; j < rangeCount; j++) {
+            if (!inRange(ranges[j], controller.getLimit(j)) && errors++ < 10)
+                fprintf(stderr, "tick %u: PL%u %u outside %u-%u step %u\n", i, j + 1, controller.getLimit(j),
+                        ranges[j].min_uw, ranges[j].max_uw, ranges[j].step_uw);
+        }
+        if (inputs.ceiling_uw && controller.getLimit(0) > inputs.ceiling_uw &&
+            controller.getLimit(0) > ranges[0].min_uw && errors++ < 10)
+            fprintf(stderr, "tick %u: PL1 %u over the ceiling\n", i, controller.getLimit(0));
+
+        if (inputs.temperature > inputs.target)
+            over++;
+        if (inputs.temperature > hottest)
+            hottest = inputs.temperature;
+        sum += controller.getLimit(0);
+        if (!quiet)
+            printf("%u %u %u %u\n", ms, inputs.temperature, controller.getLimit(0), controller.getLimit(1));
+    }
+
+    const PowerControllerState *state = controller.getState();
+    fprintf(stderr, "%u ticks: %u limit changes, %llu ticks over target, hottest %u dK, mean PL1 %.2f W, %.1f ns/tick\n",
+            ticks, state->changes, (unsigned long long)over, hottest,
+            ticks ? (double)sum / ticks / 1e6 : 0.0, ticks ? (double)elapsed / ticks : 0.0);
+    if (errors)
+        fprintf(stderr, "%llu errors\n", (unsigned long long)errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ring_check.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Check the sample ring on a quiet ring, where every kept sample has to come
+//  back, then with a sampler thread appending while readers copy, where every
+//  copy has to be a run of consecutive samples.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "ReadingRing.hpp"
+
+// Derived from the sequence number, so a sample from the wrong lap shows
+static uint32_t temperatureOf(uint32_t seq) {
+    return 2732 + (seq * 2654435761u >> 22);
+}
+
+static bool consecutive(const ThermalSample *out, uint32_t count, uint32_t *errors) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (out[i].time != out[0].time + i || out[i].temperature != temperatureOf(out[i].time)) {
+            if ((*errors)++ < 10)
+                fprintf(stderr, "sample %u of %u: %u at %u, expected %u\n", i, count, out[i].temperature,
+                        out[i].time, out[0].time + i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t pushes = 10000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                pushes = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n concurrent_pushes]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static ReadingRing ring;
+    ThermalSample out[READING_RING_SIZE + 1];
+    uint32_t errors = 0;
+
+    // Nothing is written while copying, so the count only depends on how many were pushed
+    for (uint32_t pushed = 0; pushed <= 3 * READING_RING_SIZE; pushed++) {
+        ring.reset();
+        for (uint32_t seq = 0; seq < pushed; seq++)
+            ring.push(seq, temperatureOf(seq));
+        for (uint32_t wanted = 0; wanted <= READING_RING_SIZE + 1; wanted++) {
+            uint32_t kept = pushed < READING_RING_SIZE ? pushed : READING_RING_SIZE;
+            uint32_t expected = wanted < kept ? wanted : kept;
+            uint32_t count = ring.readLast(out, wanted);
+            if (count != expected && errors++ < 10)
+                fprintf(stderr, "%u pushed, %u wanted: %u samples, expected %u\n", pushed, wanted, count, expected);
+            if (count && consecutive(out, count, &errors) && out[count - 1].time != pushed - 1 && errors++ < 10)
+                fprintf(stderr, "%u pushed: last sample %u\n", pushed, out[count - 1].time);
+        }
+    }
+    printf("quiet ring: %u errors\n", errors);
+
+    // One sampler, as in the kernel, and a reader copying the whole ring as fast as it can
+    ring.reset();
+    std::atomic<bool> done(false);
+    std::thread sampler([&] {
+        for (uint32_t seq = 0; seq < pushes; seq++)
+            ring.push(seq, temperatureOf(seq));
+        done.store(true);
+    });
+    uint64_t reads = 0, samples = 0;
+    while (!done.load()) {
+        uint32_t count = ring.readLast(out, READING_RING_SIZE);
+        consecutive(out, count, &errors);
+        reads++;
+        samples += count;
+    }
+    sampler.join();
+    printf("concurrent: %llu reads, %.2f samples per read, %u errors\n", (unsigned long long)reads,
+           reads ? (double)samples / reads : 0.0, errors);
+    return errors ? 1 : 0;
+}
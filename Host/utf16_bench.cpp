@@ -0,0 +1,237 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  utf16_bench.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Check the UTF-16LE decoder against a unit-by-unit reference on participant
+//  names, random mixes around the block size and truncated outputs, then time
+//  both on the names and on large synthetic inputs.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "UTF16.hpp"
+#include "bench.h"
+
+static uint32_t seed = 1;
+
+static uint32_t next() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+typedef std::vector<uint16_t> Units;
+
+// The loop _STR used to go through, with lone surrogates replaced
+static std::string reference(const Units &in) {
+    std::string out;
+    for (size_t i = 0; i < in.size() && in[i]; i++) {
+        uint32_t c = in[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < in.size() && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF)
+            c = 0x10000 + ((c - 0xD800) << 10) + (in[++i] - 0xDC00);
+        else if (c >= 0xD800 && c <= 0xDFFF)
+            c = 0xFFFD;
+        if (c < 0x80) {
+            out += (char)c;
+        } else if (c < 0x800) {
+            out += (char)(0xC0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += (char)(0xE0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        } else {
+            out += (char)(0xF0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3F));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+static Units fromUTF8(const char *s) {
+    Units out;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(s);
+    while (*p) {
+        uint32_t c = *p++;
+        int more = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        c &= more == 3 ? 0x07 : more == 2 ? 0x0F : more == 1 ? 0x1F : 0x7F;
+        while (more-- && *p)
+            c = (c << 6) | (*p++ & 0x3F);
+        if (c >= 0x10000) {
+            out.push_back(0xD800 + ((c - 0x10000) >> 10));
+            out.push_back(0xDC00 + ((c - 0x10000) & 0x3FF));
+        } else {
+            out.push_back(c);
+        }
+    }
+    // _STR carries its terminator
+    out.push_back(0);
+    return out;
+}
+
+// Mostly ASCII with some of everything else
+static uint16_t randomUnit(uint32_t ascii) {
+    uint32_t pick = next() % 100;
+    if (pick < ascii)
+        return 0x20 + next() % 0x5F;
+    switch (pick % 5) {
+        case 0:
+            return 0x80 + next() % 0x780;
+        case 1:
+            return 0x800 + next() % 0xD000;
+        case 2:
+            return 0xD800 + next() % 0x400;
+        case 3:
+            return 0xDC00 + next() % 0x400;
+        default:
+            return next() % 8 ? 0x4E00 + next() % 0x5000 : 0;
+    }
+}
+
+static uint32_t check(const Units &in, uint32_t *errors) {
+    std::string expected = reference(in);
+    uint32_t length = utf16leLength(in.data(), (uint32_t)in.size());
+    std::vector<char> out(UTF16_UTF8_MAX(in.size()) + 1);
+    uint32_t written = utf16leToUTF8(in.data(), (uint32_t)in.size(), out.data(), (uint32_t)out.size());
+    if ((length != expected.size() || written != expected.size() || expected != out.data()) && (*errors)++ < 10)
+        fprintf(stderr, "%zu units: %u/%u bytes, expected %zu\n", in.size(), length, written, expected.size());
+
+    // Cut short, the output must be a whole-character prefix
+    for (uint32_t capacity = 1; capacity <= expected.size() + 1; capacity += 1 + capacity / 8) {
+        std::vector<char> cut(capacity);
+        written = utf16leToUTF8(in.data(), (uint32_t)in.size(), cut.data(), capacity);
+        bool whole = written == expected.size() || (uint8_t)expected[written] < 0x80 || (uint8_t)expected[written] >= 0xC0;
+        if ((written >= capacity || cut[written] || expected.compare(0, written, cut.data()) || !whole ||
+             (written < expected.size() && capacity - 1 - written >= 4)) && (*errors)++ < 10)
+            fprintf(stderr, "%zu units cut to %u: %u bytes\n", in.size(), capacity, written);
+    }
+    return length;
+}
+
+static void timeInputs(const char *label, const std::vector<Units> &inputs, uint32_t rounds) {
+    size_t units = 0, room = 0;
+    for (const Units &in : inputs) {
+        units += in.size();
+        room = room > in.size() ? room : in.size();
+    }
+    std::vector<char> out(UTF16_UTF8_MAX(room) + 1);
+
+    // One pass into room for the worst case, as short names are decoded on the stack
+    uint64_t start = now_ns();
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < rounds; r++)
+        for (const Units &in : inputs)
+            sum += utf16leToUTF8(in.data(), (uint32_t)in.size(), out.data(), (uint32_t)out.size());
+    uint64_t single = now_ns() - start;
+
+    // Measured first, then decoded into a buffer of the exact size
+    start = now_ns();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (const Units &in : inputs) {
+            uint32_t length = utf16leLength(in.data(), (uint32_t)in.size());
+            sum += utf16leToUTF8(in.data(), (uint32_t)in.size(), out.data(), length + 1);
+        }
+    uint64_t exact = now_ns() - start;
+
+    start = now_ns();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (const Units &in : inputs)
+            sum += (uint32_t)reference(in).size();
+    uint64_t slow = now_ns() - start;
+
+    double bytes = (double)units * 2 * rounds;
+    printf("%-12s %8.1f MB/s, measured %8.1f MB/s, reference %8.1f MB/s (%u)\n", label, bytes * 1e3 / single,
+           bytes * 1e3 / exact, bytes * 1e3 / slow, sum & 1);
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = 100000;
+    uint32_t size = 1 << 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 's':
+                size = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n name_rounds] [-s synthetic_units]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // _STR of DPTF participants as shipped, plus a few translated ones
+    static const char *names[] = {
+        "DPTF Manager",
+        "CPU Participant",
+        "Thermal Sensor 1",
+        "Skin Temperature Sensor near SSD",
+        "Memory Thermal Sensor",
+        "Ambient Sensor",
+        "Charger Participant",
+        "Battery Participant",
+        "WWAN Participant",
+        "Fan Participant",
+        "Display Panel",
+        "Power Participant",
+        "Température du boîtier",
+        "温度传感器",
+        "Sensor \xF0\x9F\x94\xA5 hot",
+    };
+    std::vector<Units> participants;
+    for (const char *name : names)
+        participants.push_back(fromUTF8(name));
+
+    uint32_t errors = 0, checked = 0;
+    for (const Units &in : participants) {
+        check(in, &errors);
+        checked++;
+    }
+    // Every length around a few blocks, ASCII runs broken up at random
+    for (uint32_t length = 0; length < 5 * UTF16_BLOCK; length++) {
+        for (uint32_t ascii = 0; ascii <= 100; ascii += 10) {
+            for (uint32_t round = 0; round < 50; round++) {
+                Units in(length);
+                for (uint16_t &unit : in)
+                    unit = randomUnit(ascii);
+                check(in, &errors);
+                checked++;
+            }
+        }
+    }
+    printf("%u inputs checked, %u errors\n", checked, errors);
+
+    timeInputs("names", participants, rounds);
+    static const struct {
+        const char *label;
+        uint32_t ascii;
+    } mixes[] = {
+        { "ascii", 100 },
+        { "ascii 99%", 99 },
+        { "ascii 90%", 90 },
+        { "ascii 50%", 50 },
+        { "non-ascii", 0 },
+    };
+    for (const auto &mix : mixes) {
+        Units in(size);
+        for (uint16_t &unit : in) {
+            unit = randomUnit(mix.ascii);
+            // No early stop, the whole input is decoded
+            if (!unit)
+                unit = 0x4E00;
+        }
+        timeInputs(mix.label, std::vector<Units>(1, in), 10);
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  virtual_bench.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Fuse random virtual sensors over random readings, check every value
+//  against a per-slot reference and time the vector path against it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "VirtualSensor.hpp"
+#include "bench.h"
+
+static uint32_t seed = 1;
+
+static uint32_t next() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// One slot at a time, as the policies read sensors today
+static uint32_t reference(uint32_t mode, const uint32_t *weights, const uint32_t *readings) {
+    uint64_t sum = 0, total = 0;
+    uint32_t best = mode == kVirtualSensorMin ? UINT32_MAX : 0;
+    for (uint32_t slot = 0; slot < VIRTUAL_SENSOR_SLOTS; slot++) {
+        if (!weights[slot] || !readings[slot])
+            continue;
+        uint32_t weight = weights[slot] < VIRTUAL_SENSOR_WEIGHT_MAX ? weights[slot] : VIRTUAL_SENSOR_WEIGHT_MAX;
+        sum += (uint64_t)readings[slot] * weight;
+        total += weight;
+        if (mode == kVirtualSensorMax ? readings[slot] > best : readings[slot] < best)
+            best = readings[slot];
+    }
+    if (mode == kVirtualSensorWeighted)
+        return total ? (uint32_t)((sum + total / 2) / total) : 0;
+    return best == UINT32_MAX ? 0 : best;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = 100000;
+    uint32_t ticks = 1000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 't':
+                ticks = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n check_rounds] [-t timed_ticks]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    VirtualSensors sensors;
+    uint32_t weights[VIRTUAL_SENSOR_MAX][VIRTUAL_SENSOR_SLOTS];
+    uint32_t readings[VIRTUAL_SENSOR_SLOTS];
+    uint32_t errors = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t slot = 0; slot < VIRTUAL_SENSOR_SLOTS; slot++) {
+            // A few missing readings, a few out of range ones that get clamped
+            uint32_t pick = next() % 32;
+            readings[slot] = !pick ? 0 : pick == 1 ? 0x20000 : 2732 + next() % 1000;
+            sensors.setReading(slot, readings[slot]);
+            if (readings[slot] > VIRTUAL_SENSOR_READING_MAX)
+                readings[slot] = VIRTUAL_SENSOR_READING_MAX;
+        }
+        for (uint32_t i = 0; i < VIRTUAL_SENSOR_MAX; i++) {
+            uint32_t mode = next() % 3;
+            for (uint32_t slot = 0; slot < VIRTUAL_SENSOR_SLOTS; slot++)
+                weights[i][slot] = next() % 4 ? 0 : next() % 1200;
+            sensors.define(i, mode, weights[i]);
+            uint32_t expected = reference(mode, weights[i], readings);
+            uint32_t value = sensors.fuse(i);
+            if (value != expected && errors++ < 10)
+                fprintf(stderr, "round %u sensor %u mode %u: %u, expected %u\n", round, i, mode, value, expected);
+        }
+    }
+    printf("%u rounds of %u sensors checked, %u errors\n", rounds, VIRTUAL_SENSOR_MAX, errors);
+
+    // Sensors stay defined, only readings move between ticks
+    uint64_t start = now_ns();
+    uint32_t changed = 0;
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        sensors.setReading(tick % VIRTUAL_SENSOR_SLOTS, 2732 + tick % 997);
+        changed += __builtin_popcount(sensors.update());
+    }
+    uint64_t vector = now_ns() - start;
+
+    start = now_ns();
+    uint32_t sink = 0;
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        readings[tick % VIRTUAL_SENSOR_SLOTS] = 2732 + tick % 997;
+        for (uint32_t i = 0; i < VIRTUAL_SENSOR_MAX; i++)
+            sink += reference(sensors.getMode(i), weights[i], readings);
+    }
+    uint64_t scalar = now_ns() - start;
+
+    double fused = (double)ticks * VIRTUAL_SENSOR_MAX;
+    printf("vector: %.1f ns per fused value, %u changes\n", vector / fused, changed);
+    printf("scalar: %.1f ns per fused value (%u)\n", scalar / fused, sink & 1);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,174 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  wheel_sim.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Drive the timer wheel with a simulated clock and check every expiry
+//  against a reference schedule. Periods mimic a platform with many sensors
+//  (_TSP of a few seconds), PSVT entries and some long or one-shot timers.
+//  The clock is driven the way the kext does (sleep until nextExpiry), tick
+//  by tick, and in random jumps while actions add and remove timers.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "TimerWheel.hpp"
+#include "bench.h"
+
+struct Expected {
+    bool active;
+    uint32_t generation;
+    uint32_t period;
+    uint64_t expires;
+};
+
+struct Simulation {
+    TimerWheel wheel;
+    std::vector<Expected> expected;
+    std::vector<uint32_t> ids;  // timer id by generation
+    uint32_t generation {0};
+    uint64_t fired {0};
+    uint64_t errors {0};
+    uint32_t churn {0};         // replace a timer every churn expiries, 0 to disable
+    uint32_t seed {1};
+
+    uint32_t random() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    }
+
+    uint32_t randomPeriod() {
+        uint32_t pick = random() % 100;
+        if (pick < 60)
+            return 10 + random() % 40;              // sensors, 1-5 s
+        if (pick < 85)
+            return 1 + random() % 100;              // PSVT entries
+        if (pick < 95)
+            return 600 + random() % 6000;           // slow participants
+        if (pick < 98)
+            return 100000 + random() % 2000000;     // later levels
+        return 0;                                   // one-shot
+    }
+
+    void schedule(uint32_t period);
+    static void action(void *owner, void *context, uint32_t cookie);
+};
+
+void Simulation::schedule(uint32_t period) {
+    uint32_t delay = period ? 1 + random() % period : 1 + random() % 5000;
+    uint32_t id = wheel.add(delay, period, &Simulation::action, this, nullptr, ++generation);
+    if (id == TIMER_WHEEL_INVALID) {
+        fprintf(stderr, "add failed\n");
+        errors++;
+        return;
+    }
+    if (id >= expected.size())
+        expected.resize(id + 1);
+    expected[id] = { true, generation, period, wheel.getNow() + delay };
+    ids.resize(generation + 1);
+    ids[generation] = id;
+}
+
+void Simulation::action(void *owner, void *context, uint32_t cookie) {
+    Simulation *sim = static_cast<Simulation *>(owner);
+    uint64_t now = sim->wheel.getNow();
+    sim->fired++;
+
+    Expected *match = &sim->expected[sim->ids[cookie]];
+    if (!match->active || match->generation != cookie) {
+        if (sim->errors++ < 10)
+            fprintf(stderr, "tick %llu: stale timer %u fired\n", (unsigned long long)now, cookie);
+        return;
+    }
+    if (match->expires != now && sim->errors++ < 10)
+        fprintf(stderr, "tick %llu: timer %u due at %llu\n", (unsigned long long)now, cookie, (unsigned long long)match->expires);
+
+    if (match->period)
+        match->expires = now + match->period;
+    else
+        match->active = false;
+
+    if (sim->churn && sim->fired % sim->churn == 0) {
+        uint32_t victim = sim->random() % sim->expected.size();
+        if (sim->expected[victim].active && sim->wheel.remove(victim))
+            sim->expected[victim].active = false;
+        sim->schedule(sim->randomPeriod());
+    }
+}
+
+static bool verify(Simulation &sim, const char *mode) {
+    // Nothing due up to now may be left behind
+    for (const Expected &e : sim.expected) {
+        if (e.active && e.expires <= sim.wheel.getNow() && sim.errors++ < 10)
+            fprintf(stderr, "%s: timer %u due at %llu not fired by %llu\n", mode, e.generation,
+                    (unsigned long long)e.expires, (unsigned long long)sim.wheel.getNow());
+    }
+    if (sim.errors) {
+        fprintf(stderr, "%s: %llu errors\n", mode, (unsigned long long)sim.errors);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t timers = 64;
+    uint64_t span = 3 * 24 * 36000;     // three days of 100 ms ticks
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        if (opt == 'n')
+            timers = (uint32_t)strtoul(optarg, nullptr, 0);
+        else if (opt == 't')
+            span = strtoull(optarg, nullptr, 0);
+        else {
+            fprintf(stderr, "usage: %s [-n timers] [-t ticks]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    bool ok = true;
+    const char *modes[] = { "sleep", "step", "jump" };
+    for (int mode = 0; mode < 3; mode++) {
+        Simulation sim;
+        sim.churn = mode == 2 ? 7 : 0;
+        if (!sim.wheel.init(1000, 8)) {
+            fprintf(stderr, "init failed\n");
+            return 1;
+        }
+        for (uint32_t i = 0; i < timers; i++)
+            sim.schedule(sim.randomPeriod());
+
+        uint64_t end = sim.wheel.getNow() + span;
+        uint64_t wakeups = 0;
+        uint64_t start = now_ns();
+        while (sim.wheel.getNow() < end) {
+            uint64_t tick;
+            if (mode == 0) {
+                // Sleep until the wheel has work, as the kext programs its timer
+                tick = sim.wheel.nextExpiry();
+                if (tick > end)
+                    tick = end;
+            } else if (mode == 1) {
+                tick = sim.wheel.getNow() + 1;
+            } else {
+                tick = sim.wheel.getNow() + 1 + sim.random() % 1000;
+            }
+            sim.wheel.advance(tick);
+            wakeups++;
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        if (!verify(sim, modes[mode]))
+            ok = false;
+        printf("%-5s %u timers over %llu ticks: %llu expiries, %llu wakeups, %.1f ns/expiry, %u capacity\n",
+               modes[mode], sim.wheel.getCount(), (unsigned long long)span,
+               (unsigned long long)sim.fired, (unsigned long long)wakeups,
+               sim.fired ? (double)elapsed / sim.fired : 0.0, sim.wheel.getCapacity());
+    }
+    return ok ? 0 : 1;
+}
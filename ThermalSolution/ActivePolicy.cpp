@@ -0,0 +1,96 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ActivePolicy.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include "ActivePolicy.hpp"
+
+uint32_t ActivePolicy::configure(const uint32_t *trips, uint32_t count, uint32_t hysteresis) {
+    tripCount = 0;
+    for (uint32_t i = 0; i < count && tripCount < ACTIVE_TRIP_COUNT; i++) {
+        if (!trips[i])
+            continue;
+        uint32_t j = tripCount++;
+        for (; j > 0 && this->trips[j - 1] > trips[i]; j--)
+            this->trips[j] = this->trips[j - 1];
+        this->trips[j] = trips[i];
+    }
+    this->hysteresis = hysteresis;
+
+    // Smallest bucket width that still covers every trip
+    base = tripCount ? this->trips[0] : 0;
+    uint32_t span = tripCount ? this->trips[tripCount - 1] - base : 0;
+    shift = 0;
+    while ((span >> shift) >= ACTIVE_BUCKETS)
+        shift++;
+
+    uint32_t level = 0;
+    for (uint32_t b = 0; b < ACTIVE_BUCKETS; b++) {
+        uint64_t start = base + ((uint64_t)b << shift);
+        while (level < tripCount && this->trips[level] <= start)
+            level++;
+        buckets[b] = level;
+    }
+
+    state = {};
+    return tripCount;
+}
+
+uint32_t ActivePolicy::levelOf(uint32_t temperature) const {
+    if (!tripCount || temperature < base)
+        return 0;
+    uint32_t b = (temperature - base) >> shift;
+    if (b >= ACTIVE_BUCKETS)
+        return tripCount;
+
+    // Only trips inside the bucket are left to compare
+    uint32_t level = buckets[b];
+    while (level < tripCount && temperature >= trips[level])
+        level++;
+    return level;
+}
+
+bool ActivePolicy::update(uint32_t temperature, uint32_t now) {
+    if (!tripCount || !temperature)
+        return false;
+    state.decisions++;
+
+    uint32_t target = levelOf(temperature);
+    if (target < state.level) {
+        // Leaving a level needs the temperature below its trip by the hysteresis
+        uint32_t held = levelOf(temperature + hysteresis);
+        if (held < state.level)
+            target = held;
+        else
+            target = state.level;
+    }
+    state.target = target;
+
+    uint32_t next = state.level;
+    if (target > state.level) {
+        state.falling = 0;
+        if (!state.switches || now - state.changed >= rampUp)
+            next = target;
+    } else if (target < state.level) {
+        if (!state.falling) {
+            // Odd so a start at 0 ms is not mistaken for not falling
+            state.falling = now | 1;
+        } else if (now - state.falling >= rampDown) {
+            next = state.level - 1;
+            state.falling = now | 1;
+        }
+    } else {
+        state.falling = 0;
+    }
+
+    if (next == state.level)
+        return false;
+    state.level = next;
+    state.changed = now;
+    state.switches++;
+    return true;
+}
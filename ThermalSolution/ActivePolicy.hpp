@@ -0,0 +1,97 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ActivePolicy.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Active cooling engine driven by the _ACx trips of a zone. Kernel-agnostic
+//  and allocation free like PowerController, the caller feeds one temperature
+//  per sample and programs the fan only when the level changes.
+//
+
+#ifndef ActivePolicy_hpp
+#define ActivePolicy_hpp
+
+#include <stdint.h>
+
+// _AC0 to _AC9
+#define ACTIVE_TRIP_COUNT       10
+// Lookup buckets over the trip span, each one narrower than most trip gaps
+#define ACTIVE_BUCKETS          64
+
+// Raising the level waits this long after the previous change
+#define ACTIVE_RAMP_UP_MS       1000
+// Lowering the level waits for the temperature to stay below it this long, one level at a time
+#define ACTIVE_RAMP_DOWN_MS     10000
+
+struct ActivePolicyState {
+    uint32_t level;             // trips at or below the zone, 0 is off
+    uint32_t target;            // level the last temperature asked for
+    uint32_t changed;           // ms of the last level change
+    uint32_t falling;           // ms the target first dropped below the level, 0 if it has not
+    uint32_t decisions;         // samples evaluated
+    uint32_t switches;          // samples that moved the level
+};
+
+class ActivePolicy {
+    uint32_t trips[ACTIVE_TRIP_COUNT] {};   // deci-Kelvin, ascending
+    uint32_t tripCount {0};
+    uint32_t hysteresis {0};
+
+    // Level at the start of each bucket, bucket b starts at base + (b << shift)
+    uint32_t base {0};
+    uint32_t shift {0};
+    uint8_t buckets[ACTIVE_BUCKETS] {};
+
+    uint32_t rampUp {ACTIVE_RAMP_UP_MS};
+    uint32_t rampDown {ACTIVE_RAMP_DOWN_MS};
+    ActivePolicyState state {};
+
+public:
+    /**
+     * Set the trips of the zone and restart with the fan off
+     * @param trips _ACx in deci-Kelvin, any order, 0 for a missing trip
+     * @param count Number of trips, at most ACTIVE_TRIP_COUNT are used
+     * @param hysteresis Deci-Kelvin below a trip before its level is left
+     *
+     * @return Number of levels above off
+     */
+    uint32_t configure(const uint32_t *trips, uint32_t count, uint32_t hysteresis);
+
+    /**
+     * @param up Minimum ms between two raises
+     * @param down Ms the temperature has to stay below a level before each drop
+     */
+    void setRamp(uint32_t up, uint32_t down) { rampUp = up; rampDown = down; };
+
+    /**
+     * Level of a temperature, ignoring hysteresis. One bucket load and usually no more than
+     * one compare.
+     * @param temperature Deci-Kelvin
+     *
+     * @return Number of trips at or below the temperature
+     */
+    uint32_t levelOf(uint32_t temperature) const;
+
+    /**
+     * Evaluate a sample. Going up jumps straight to the target once ACTIVE_RAMP_UP_MS has
+     * passed since the last change, going down steps one level per ACTIVE_RAMP_DOWN_MS spent
+     * below the hysteresis.
+     * @param temperature Deci-Kelvin, 0 if unavailable
+     * @param now Ms, only differences are used
+     *
+     * @return true if the level changed and the fan has to be programmed
+     */
+    bool update(uint32_t temperature, uint32_t now);
+
+    uint32_t getLevelCount() const { return tripCount; };
+    uint32_t getLevel() const { return state.level; };
+    uint32_t getTrip(uint32_t i) const { return i < tripCount ? trips[i] : 0; };
+    // Linear fan speed for the current level
+    uint32_t getPercent() const { return tripCount ? state.level * 100 / tripCount : 0; };
+    const ActivePolicyState *getState() const { return &state; };
+};
+
+#endif /* ActivePolicy_hpp */
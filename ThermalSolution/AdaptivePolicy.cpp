@@ -0,0 +1,275 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  AdaptivePolicy.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include <string.h>
+#include "AdaptivePolicy.hpp"
+#include "portable.h"
+
+static inline bool readsDevice(uint64_t condition) {
+    return condition == Temperature || condition == Temperature_without_hysteresis;
+}
+
+uint32_t AdaptivePolicy::internDevice(const char *name) {
+    for (uint32_t i = 0; i < deviceCount; i++)
+        if (!strcmp(devices[i], name))
+            return i;
+    if (deviceCount >= ADAPTIVE_DEVICE_MAX)
+        return ADAPTIVE_DEVICE_MAX;
+    devices[deviceCount] = name;
+    return deviceCount++;
+}
+
+int AdaptivePolicy::compile(const void *data, uint32_t length) {
+    release();
+
+    DataVaultCursor cursor(data, length);
+    if (!readTableVersion(cursor, &version) || (version != 1 && version != 2))
+        return kDataVaultUnsupported;
+
+    // Count first so everything is allocated once at its final size
+    uint32_t sets = 0, total = 0;
+    uint64_t target;
+    uint32_t count;
+    APCTCondition item;
+    while (nextAPCTTarget(cursor, version, &target, &count)) {
+        uint32_t index = 0;
+        while (nextAPCTCondition(cursor, version, index, count, &item))
+            total++;
+        sets++;
+    }
+    if (cursor.failed())
+        return kDataVaultTruncated;
+    if (!sets)
+        return kDataVaultOK;
+
+    uint32_t bitmap = (sets + 63) / 64;
+    blockSize = sets * sizeof(AdaptiveTarget) + total * sizeof(AdaptiveCondition) +
+                total * sizeof(uint64_t) + bitmap * sizeof(uint64_t) +
+                3 * total * sizeof(uint32_t) + sets * sizeof(uint32_t) + total;
+    block = IOMalloc(blockSize);
+    if (!block) {
+        blockSize = 0;
+        return kDataVaultNoMemory;
+    }
+    memset(block, 0, blockSize);
+    targets = reinterpret_cast<AdaptiveTarget *>(block);
+    conditions = reinterpret_cast<AdaptiveCondition *>(targets + sets);
+    since = reinterpret_cast<uint64_t *>(conditions + total);
+    matched = since + total;
+    dependents = reinterpret_cast<uint32_t *>(matched + bitmap);
+    owner = dependents + total;
+    timed = owner + total;
+    failing = timed + total;
+    truth = reinterpret_cast<uint8_t *>(failing + sets);
+    words = bitmap;
+
+    DataVaultCursor second(data, length);
+    readTableVersion(second, &version);
+    while (targetCount < sets && nextAPCTTarget(second, version, &target, &count)) {
+        AdaptiveTarget *set = &targets[targetCount++];
+        set->target = target;
+        set->first = conditionCount;
+        set->count = 0;
+
+        uint32_t index = 0;
+        while (conditionCount < total && nextAPCTCondition(second, version, index, count, &item)) {
+            // v1 pads every set to ten slots with empty conditions
+            if (item.condition == 0)
+                continue;
+            AdaptiveCondition *condition = &conditions[conditionCount];
+            condition->condition = item.condition < ADAPTIVE_CONDITION_MAX ? (uint8_t)item.condition : 0;
+            condition->comparison = item.comparison <= ADAPTIVE_GREATER_OR_EQUAL ? (uint8_t)item.comparison : 0;
+            condition->operation = item.has_operation ? (uint8_t)item.operation : 0;
+            condition->time = item.has_time ? (uint32_t)item.time : 0;
+            condition->argument = (int64_t)item.argument;
+            condition->device = ADAPTIVE_NO_DEVICE;
+            if (version == 2 && readsDevice(item.condition) && item.device && item.device[0])
+                condition->device = (uint8_t)internDevice(item.device);
+            owner[conditionCount] = targetCount - 1;
+            if (condition->time)
+                timed[timedCount++] = conditionCount;
+            conditionCount++;
+            set->count++;
+        }
+    }
+
+    // Dependency index: conditions grouped by the input they read
+    uint32_t fill[ADAPTIVE_CONDITION_MAX];
+    memset(dependentStart, 0, sizeof(dependentStart));
+    for (uint32_t i = 0; i < conditionCount; i++)
+        if (conditions[i].condition > Default)
+            dependentStart[conditions[i].condition + 1]++;
+    for (uint32_t c = 0; c < ADAPTIVE_CONDITION_MAX; c++) {
+        if (dependentStart[c + 1])
+            referenced |= 1ULL << c;
+        dependentStart[c + 1] += dependentStart[c];
+        fill[c] = dependentStart[c];
+    }
+    for (uint32_t i = 0; i < conditionCount; i++)
+        if (conditions[i].condition > Default)
+            dependents[fill[conditions[i].condition]++] = i;
+    return kDataVaultOK;
+}
+
+void AdaptivePolicy::release() {
+    if (block)
+        IOFree(block, blockSize);
+    block = nullptr;
+    blockSize = 0;
+    targets = nullptr;
+    conditions = nullptr;
+    since = nullptr;
+    dependents = nullptr;
+    owner = nullptr;
+    truth = nullptr;
+    failing = nullptr;
+    timed = nullptr;
+    matched = nullptr;
+    targetCount = 0;
+    conditionCount = 0;
+    timedCount = 0;
+    deviceCount = 0;
+    due = UINT64_MAX;
+    referenced = 0;
+    words = 0;
+    version = 0;
+    primed = false;
+}
+
+bool AdaptivePolicy::test(uint32_t i, const AdaptiveInputs &inputs) {
+    const AdaptiveCondition *condition = &conditions[i];
+    bool match;
+
+    bool valid;
+    int64_t value = 0;
+    if (condition->device == ADAPTIVE_NO_DEVICE) {
+        valid = inputs.valid & (1ULL << condition->condition);
+        if (valid)
+            value = inputs.value[condition->condition];
+    } else {
+        valid = condition->device < ADAPTIVE_DEVICE_MAX && (inputs.deviceValid & (1U << condition->device));
+        if (valid)
+            value = inputs.device[condition->device];
+    }
+
+    if (condition->condition == Default) {
+        match = true;
+    } else if (!valid) {
+        match = false;
+    } else {
+        switch (condition->comparison) {
+            case ADAPTIVE_EQUAL:
+                match = value == condition->argument;
+                break;
+
+            case ADAPTIVE_LESSER_OR_EQUAL:
+                match = value <= condition->argument;
+                break;
+
+            case ADAPTIVE_GREATER_OR_EQUAL:
+                match = value >= condition->argument;
+                break;
+
+            default:
+                match = false;
+                break;
+        }
+    }
+
+    if (!condition->time)
+        return match;
+
+    // FOR: the condition has to hold for the given time before it counts
+    if (!match) {
+        since[i] = 0;
+        return false;
+    }
+    if (!since[i])
+        since[i] = inputs.now ? inputs.now : 1;
+    uint64_t deadline = since[i] + condition->time * 1000ULL;
+    if (inputs.now >= deadline)
+        return true;
+    if (deadline < due)
+        due = deadline;
+    return false;
+}
+
+bool AdaptivePolicy::testSet(uint32_t t, const AdaptiveInputs &inputs, bool needed) {
+    const AdaptiveTarget *set = &targets[t];
+    uint32_t end = set->first + set->count;
+    bool match = needed;
+
+    // Timed conditions are always tested so their start time stays current
+    for (uint32_t i = set->first; i < end; i++)
+        if ((match || conditions[i].time) && !test(i, inputs))
+            match = false;
+    return match;
+}
+
+uint64_t AdaptivePolicy::evaluate(const AdaptiveInputs &inputs) {
+    uint64_t result = ADAPTIVE_NO_TARGET;
+
+    for (uint32_t t = 0; t < targetCount; t++)
+        if (testSet(t, inputs, result == ADAPTIVE_NO_TARGET))
+            result = targets[t].target;
+
+    // Sets after the first match were not fully checked
+    primed = false;
+    return result;
+}
+
+void AdaptivePolicy::retest(uint32_t i, const AdaptiveInputs &inputs) {
+    bool match = test(i, inputs);
+    if (match == (bool)truth[i])
+        return;
+
+    uint32_t t = owner[i];
+    truth[i] = match;
+    failing[t] += match ? -1 : 1;
+    if (failing[t])
+        matched[t / 64] &= ~(1ULL << (t % 64));
+    else
+        matched[t / 64] |= 1ULL << (t % 64);
+}
+
+uint64_t AdaptivePolicy::update(AdaptiveInputs &inputs) {
+    if (!primed) {
+        due = UINT64_MAX;
+        for (uint32_t w = 0; w < words; w++)
+            matched[w] = 0;
+        for (uint32_t t = 0; t < targetCount; t++) {
+            failing[t] = 0;
+            for (uint32_t i = targets[t].first; i < targets[t].first + targets[t].count; i++) {
+                truth[i] = test(i, inputs);
+                failing[t] += !truth[i];
+            }
+            if (!failing[t])
+                matched[t / 64] |= 1ULL << (t % 64);
+        }
+        primed = true;
+    } else {
+        for (uint64_t changed = inputs.changed & referenced; changed; changed &= changed - 1) {
+            uint32_t c = __builtin_ctzll(changed);
+            for (uint32_t k = dependentStart[c]; k < dependentStart[c + 1]; k++)
+                retest(dependents[k], inputs);
+        }
+        // A FOR condition whose input did not change can only flip once its time is up
+        if (inputs.now >= due) {
+            due = UINT64_MAX;
+            for (uint32_t k = 0; k < timedCount; k++)
+                retest(timed[k], inputs);
+        }
+    }
+    inputs.changed = 0;
+
+    for (uint32_t w = 0; w < words; w++)
+        if (matched[w])
+            return targets[w * 64 + __builtin_ctzll(matched[w])].target;
+    return ADAPTIVE_NO_TARGET;
+}
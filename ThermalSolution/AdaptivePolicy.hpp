@@ -0,0 +1,227 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  AdaptivePolicy.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Compiled form of the APCT adaptive condition table. Kernel-agnostic like
+//  DataVault, so the evaluator can be profiled in the host build.
+//
+
+#ifndef AdaptivePolicy_hpp
+#define AdaptivePolicy_hpp
+
+#include "DataVault.hpp"
+
+// from intel/thermal_daemon/src/thd_engine_adaptive.h
+
+enum adaptive_condition {
+    Default = 0x01,
+    Orientation,
+    Proximity,
+    Motion,
+    Dock,
+    Workload,
+    Cooling_mode,
+    Power_source,
+    Aggregate_power_percentage,
+    Lid_state,
+    Platform_type,
+    Platform_SKU,
+    Utilisation,
+    TDP,
+    Duty_cycle,
+    Power,
+    Temperature,
+    Display_orientation,
+    Oem0,
+    Oem1,
+    Oem2,
+    Oem3,
+    Oem4,
+    Oem5,
+    PMAX,
+    PSRC,
+    ARTG,
+    CTYP,
+    PROP,
+    Unk1,
+    Unk2,
+    Battery_state,
+    Battery_rate,
+    Battery_remaining,
+    Battery_voltage,
+    PBSS,
+    Battery_cycles,
+    Battery_last_full,
+    Power_personality,
+    Battery_design_capacity,
+    Screen_state,
+    AVOL,
+    ACUR,
+    AP01,
+    AP02,
+    AP10,
+    Time,
+    Temperature_without_hysteresis,
+    Mixed_reality,
+    User_presence,
+    RBHF,
+    VBNL,
+    CMPP,
+    Battery_percentage,
+    Battery_count,
+    Power_slider
+};
+
+#define ADAPTIVE_CONDITION_MAX 64
+
+// Distinct v2 devices read by Temperature conditions, later ones never match
+#define ADAPTIVE_DEVICE_MAX 16
+#define ADAPTIVE_NO_DEVICE 0xFF
+
+struct AdaptiveCondition {
+    uint8_t condition;      // adaptive_condition
+    uint8_t comparison;     // adaptive_comparison
+    uint8_t operation;      // adaptive_operation joining the next condition, 0 for the last
+    uint8_t device;         // interned v2 device of a Temperature condition, ADAPTIVE_NO_DEVICE for the shared input
+    uint32_t time;          // seconds the condition has to hold, 0 if untimed
+    int64_t argument;
+};
+
+struct AdaptiveTarget {
+    uint64_t target;        // APAT target_id
+    uint32_t first;         // first condition
+    uint32_t count;
+};
+
+/**
+ * Snapshot of condition inputs, in the units used by APCT arguments
+ * (e.g. deci-Kelvin for Temperature, percent for Battery_percentage).
+ * Conditions without a value never match.
+ */
+struct AdaptiveInputs {
+    uint64_t valid {0};                     // bit per adaptive_condition
+    uint64_t changed {0};                   // inputs set since the last AdaptivePolicy::update
+    int64_t value[ADAPTIVE_CONDITION_MAX];
+    uint32_t deviceValid {0};               // bit per interned device
+    int64_t device[ADAPTIVE_DEVICE_MAX];    // deci-Kelvin of each device
+    uint64_t now {0};                       // milliseconds, for FOR conditions
+
+    void set(uint32_t condition, int64_t input) {
+        if (condition < ADAPTIVE_CONDITION_MAX) {
+            uint64_t bit = 1ULL << condition;
+            if (!(valid & bit) || value[condition] != input)
+                changed |= bit;
+            value[condition] = input;
+            valid |= bit;
+        }
+    };
+    void clear(uint32_t condition) {
+        if (condition < ADAPTIVE_CONDITION_MAX) {
+            uint64_t bit = 1ULL << condition;
+            changed |= valid & bit;
+            valid &= ~bit;
+        }
+    };
+    // Device readings feed both temperature conditions
+    void setDevice(uint32_t i, int64_t input) {
+        if (i < ADAPTIVE_DEVICE_MAX) {
+            uint32_t bit = 1U << i;
+            if (!(deviceValid & bit) || device[i] != input)
+                changed |= (1ULL << Temperature) | (1ULL << Temperature_without_hysteresis);
+            device[i] = input;
+            deviceValid |= bit;
+        }
+    };
+    void clearDevice(uint32_t i) {
+        if (i < ADAPTIVE_DEVICE_MAX && (deviceValid & (1U << i))) {
+            changed |= (1ULL << Temperature) | (1ULL << Temperature_without_hysteresis);
+            deviceValid &= ~(1U << i);
+        }
+    };
+};
+
+#define ADAPTIVE_NO_TARGET ((uint64_t)-1)
+
+class AdaptivePolicy {
+    // All arrays live in one block sized at compile time
+    void *block {nullptr};
+    size_t blockSize {0};
+
+    AdaptiveTarget *targets {nullptr};
+    uint32_t targetCount {0};
+    AdaptiveCondition *conditions {nullptr};
+    uint64_t *since {nullptr};              // when each timed condition started to hold
+    uint32_t conditionCount {0};
+    uint64_t version {0};
+    const char *devices[ADAPTIVE_DEVICE_MAX];
+    uint32_t deviceCount {0};
+
+    // Incremental state for update(): conditions reading each input, the set owning each
+    // condition, its last result, and how many conditions of each set currently fail
+    uint32_t dependentStart[ADAPTIVE_CONDITION_MAX + 1];
+    uint32_t *dependents {nullptr};
+    uint32_t *owner {nullptr};
+    uint8_t *truth {nullptr};
+    uint32_t *failing {nullptr};
+    uint32_t *timed {nullptr};              // FOR conditions, rechecked once one of them is due
+    uint32_t timedCount {0};
+    uint64_t due {UINT64_MAX};              // earliest time a waiting FOR condition may pass
+    uint64_t referenced {0};                // bit per adaptive_condition used by any set
+    uint64_t *matched {nullptr};            // bit per set
+    uint32_t words {0};
+    bool primed {false};
+
+    uint32_t internDevice(const char *name);
+    void retest(uint32_t i, const AdaptiveInputs &inputs);
+    bool test(uint32_t i, const AdaptiveInputs &inputs);
+    bool testSet(uint32_t t, const AdaptiveInputs &inputs, bool needed);
+
+public:
+    ~AdaptivePolicy() { release(); };
+
+    /**
+     * Flatten an APCT table, replacing any previous one. Device names point into data,
+     * which has to outlive the policy.
+     * @param data APCT value from the DataVault
+     * @param length Length of the value
+     *
+     * @return *kDataVaultOK* upon success
+     */
+    int compile(const void *data, uint32_t length);
+    void release();
+
+    /**
+     * Find the first condition set satisfied by the inputs, checking every set. Does not allocate.
+     * @param inputs Current condition inputs
+     *
+     * @return APAT target_id, or *ADAPTIVE_NO_TARGET* if no set matches
+     */
+    uint64_t evaluate(const AdaptiveInputs &inputs);
+
+    /**
+     * Same result as evaluate(), but only conditions reading a changed input, and FOR
+     * conditions once their time is up, are checked again. The first call checks
+     * everything. Does not allocate.
+     * @param inputs Current condition inputs, changed bits are consumed
+     *
+     * @return APAT target_id, or *ADAPTIVE_NO_TARGET* if no set matches
+     */
+    uint64_t update(AdaptiveInputs &inputs);
+
+    bool dependsOn(uint32_t condition) const { return condition < ADAPTIVE_CONDITION_MAX && (referenced & (1ULL << condition)); };
+    uint64_t getVersion() const { return version; };
+    uint32_t getTargetCount() const { return targetCount; };
+    uint32_t getConditionCount() const { return conditionCount; };
+    uint32_t getDeviceCount() const { return deviceCount; };
+    const char *getDeviceName(uint32_t i) const { return i < deviceCount ? devices[i] : nullptr; };
+    // Milliseconds at which a waiting FOR condition may pass, UINT64_MAX if none waits
+    uint64_t getDue() const { return due; };
+    const AdaptiveTarget *getTarget(uint32_t i) const { return i < targetCount ? &targets[i] : nullptr; };
+    const AdaptiveCondition *getCondition(uint32_t i) const { return i < conditionCount ? &conditions[i] : nullptr; };
+};
+
+#endif /* AdaptivePolicy_hpp */
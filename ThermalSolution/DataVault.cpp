@@ -0,0 +1,700 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  DataVault.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include <string.h>
+#include "DataVault.hpp"
+#include "LzmaDec.h"
+#include "portable.h"
+
+static const char *errors[] = {
+    "OK",
+    "Unsupported signature",
+    "Header size mismatch",
+    "Payload size mismatch",
+    "Invalid key",
+    "Truncated",
+    "Unsupported version",
+    "Decompress failed",
+    "Out of memory",
+    "Aborted",
+};
+
+const char *dataVaultError(int err) {
+    if (err < 0 || err >= (int)(sizeof(errors)/sizeof(errors[0])))
+        return "Unknown";
+    return errors[err];
+}
+
+// Minimum header size up to v1 flags
+#define GDDV_V1_HEADER_SIZE (offsetof(GDDVHeader, v1) + sizeof(uint32_t))
+
+int checkDataVaultHeader(const void *buf, size_t length) {
+    const GDDVHeader *hdr = reinterpret_cast<const GDDVHeader *>(buf);
+    if (length < GDDV_V1_HEADER_SIZE)
+        return kDataVaultTruncated;
+
+    if (hdr->signature != ESIFDV_HEADER_SIGNATURE)
+        return kDataVaultBadSignature;
+
+    if (hdr->headersize < GDDV_V1_HEADER_SIZE || hdr->headersize > length)
+        return kDataVaultBadHeader;
+
+    if (hdr->version.major == 2) {
+        if (hdr->headersize != sizeof(GDDVHeader))
+            return kDataVaultBadHeader;
+        if (hdr->v2.payload_size != length - hdr->headersize)
+            return kDataVaultBadPayload;
+    }
+    return kDataVaultOK;
+}
+
+static void *allocProbs(ISzAllocPtr p, size_t size) { return size ? IOMalloc(size) : NULL; }
+static void freeProbs(ISzAllocPtr p, void *address, size_t size) { if (address) IOFree(address, size); }
+static const ISzAlloc probsAlloc = { allocProbs, freeProbs };
+
+// Kept out of the header so 7zTypes.h does not leak into kext sources
+struct DataVaultLzma {
+    CLzmaDec state;
+};
+
+// LZMA-alone header in front of the compressed stream
+#pragma pack(push, 1)
+struct DataVaultLzmaHeader {
+    uint8_t properties[LZMA_PROPS_SIZE];
+    uint64_t original_size;
+};
+#pragma pack(pop)
+
+int DataVaultDecoder::begin(const GDDVHeader *hdr) {
+    release();
+    if (!isDataVaultCompressed(hdr))
+        return kDataVaultUnsupported;
+
+    const DataVaultLzmaHeader *props = reinterpret_cast<const DataVaultLzmaHeader *>(reinterpret_cast<const uint8_t *>(hdr) + hdr->headersize);
+    if (hdr->v2.payload_size <= sizeof(DataVaultLzmaHeader))
+        return kDataVaultBadPayload;
+    // ESIF always compresses with -lc3 -lp0 -pb2, i.e. [5D 00 XX XX XX]
+    if (props->properties[0] != 0x5D || props->properties[1] != 0x00)
+        return kDataVaultDecompressFailed;
+    if (props->original_size < GDDV_V1_HEADER_SIZE || props->original_size > UINT32_MAX)
+        return kDataVaultBadPayload;
+
+    lzma = reinterpret_cast<DataVaultLzma *>(IOMalloc(sizeof(DataVaultLzma)));
+    if (!lzma)
+        return kDataVaultNoMemory;
+    LzmaDec_Construct(&lzma->state);
+
+    // Only the probability tables are allocated, the image itself is the dictionary
+    length = (uint32_t)props->original_size;
+    image = reinterpret_cast<uint8_t *>(IOMalloc(length));
+    if (!image || LzmaDec_AllocateProbs(&lzma->state, props->properties, LZMA_PROPS_SIZE, &probsAlloc) != SZ_OK) {
+        release();
+        return kDataVaultNoMemory;
+    }
+
+    src = reinterpret_cast<const uint8_t *>(props + 1);
+    srcLength = hdr->v2.payload_size - sizeof(DataVaultLzmaHeader);
+    lzma->state.dic = image;
+    lzma->state.dicBufSize = length;
+    LzmaDec_Init(&lzma->state);
+    return kDataVaultOK;
+}
+
+int DataVaultDecoder::decode(DataVaultVisitor *visitor, uint32_t chunk) {
+    if (!image || !lzma)
+        return kDataVaultDecompressFailed;
+
+    CLzmaDec *state = &lzma->state;
+    DataVaultWalker walker(image, length);
+    int err = kDataVaultTruncated;
+
+    while (state->dicPos < length) {
+        SizeT limit = length - state->dicPos > chunk ? state->dicPos + chunk : length;
+        SizeT consumed = srcLength;
+        SizeT before = state->dicPos;
+        ELzmaStatus status;
+
+        SRes res = LzmaDec_DecodeToDic(state, limit, src, &consumed, LZMA_FINISH_ANY, &status);
+        src += consumed;
+        srcLength -= consumed;
+        decoded = (uint32_t)state->dicPos;
+
+        // Corrupted, ended early or starved of input
+        if (res != SZ_OK || decoded == before ||
+            (decoded < length && status == LZMA_STATUS_FINISHED_WITH_MARK))
+            return kDataVaultDecompressFailed;
+
+        if (visitor) {
+            err = walker.resume(decoded, *visitor);
+            if (err != kDataVaultOK && err != kDataVaultTruncated)
+                return err;
+        }
+    }
+    return visitor ? err : kDataVaultOK;
+}
+
+void DataVaultDecoder::finish() {
+    if (lzma) {
+        LzmaDec_FreeProbs(&lzma->state, &probsAlloc);
+        IOFree(lzma, sizeof(DataVaultLzma));
+    }
+    lzma = nullptr;
+    src = nullptr;
+    srcLength = 0;
+}
+
+void DataVaultDecoder::release() {
+    finish();
+    if (image)
+        IOFree(image, length);
+    image = nullptr;
+    length = 0;
+    decoded = 0;
+}
+
+bool DataVaultCache::lookup(const GDDVHeader *hdr) {
+    if (!valid || memcmp(hash, hdr->v2.payload_hash, SHA256_HASH_BYTES)) {
+        misses++;
+        return false;
+    }
+    hits++;
+    return true;
+}
+
+int DataVaultCache::load(const GDDVHeader *hdr, DataVaultVisitor *segments) {
+    release();
+    int err = decoder.begin(hdr);
+    if (err != kDataVaultOK)
+        return err;
+
+    DataVaultIndexBuilder builder(index, segments);
+    index.reset(decoder.getImage(), decoder.getLength());
+    err = decoder.decode(&builder);
+    decoder.finish();
+    index.finish();
+    if (builder.nomem)
+        return kDataVaultNoMemory;
+
+    // An all-zero hash means the firmware did not fill it in
+    for (int i = 0; i < SHA256_HASH_BYTES; i++) {
+        if (hdr->v2.payload_hash[i]) {
+            valid = err == kDataVaultOK;
+            break;
+        }
+    }
+    memcpy(hash, hdr->v2.payload_hash, SHA256_HASH_BYTES);
+    return err;
+}
+
+void DataVaultCache::release() {
+    index.release();
+    decoder.release();
+    valid = false;
+}
+
+static bool contains(const char *stack, const char *needle) {
+    size_t len = strlen(needle);
+    if (len == 0)
+        return true;
+
+    for (; *stack; stack++)
+        if (!strncmp(stack, needle, len))
+            return true;
+
+    return false;
+}
+
+const char *dataVaultLeafName(const char *path) {
+    const char *leaf = path;
+    for (const char *i = path; *i; i++)
+        if (*i == '/')
+            leaf = i;
+    return leaf;
+}
+
+int classifyDataVaultKey(const char *path) {
+    const char *leaf = dataVaultLeafName(path);
+
+    if (!strncmp(leaf, "/apat", strlen("/apat")))
+        return kDataVaultTableAPAT;
+    else if (!strncmp(leaf, "/apct", strlen("/apct")))
+        return kDataVaultTableAPCT;
+    else if (!strncmp(leaf, "/appc", strlen("/appc")))
+        return kDataVaultTableAPPC;
+    else if (!strncmp(leaf, "/ppcc", strlen("/ppcc")))
+        return kDataVaultTablePPCC;
+    else if (!strncmp(leaf, "/psvt", strlen("/psvt")) || contains(path, "/psvt"))
+        return kDataVaultTablePSVT;
+    else if (!strncmp(leaf, "/idsp", strlen("/idsp")))
+        return kDataVaultTableIDSP;
+
+    return kDataVaultTableNone;
+}
+
+// Records are only visited once complete, so a partial image reports kDataVaultTruncated
+// and resume() picks up at the same record once more bytes are available
+int DataVaultWalker::resume(uint32_t available, DataVaultVisitor &visitor) {
+    if (available > length)
+        available = length;
+
+    if (offset == 0) {
+        const GDDVHeader *hdr = reinterpret_cast<const GDDVHeader *>(image);
+        if (available < GDDV_V1_HEADER_SIZE)
+            return kDataVaultTruncated;
+        if (hdr->signature != ESIFDV_HEADER_SIGNATURE)
+            return kDataVaultBadSignature;
+        if (hdr->headersize < GDDV_V1_HEADER_SIZE || hdr->headersize > length)
+            return kDataVaultBadHeader;
+        keyed = hdr->version.major == 2;
+        offset = hdr->headersize;
+    }
+
+    while (offset < available) {
+        uint32_t pos = offset;
+        if (keyed) {
+            uint16_t signature;
+            if (available - pos < sizeof(uint16_t))
+                return kDataVaultTruncated;
+            memcpy(&signature, image + pos, sizeof(uint16_t));
+
+            if (signature == ESIFDV_ITEM_KEYS_REV0_SIGNATURE) {
+                pos += sizeof(uint16_t);
+            } else if (signature == ESIFDV_HEADER_SIGNATURE) {
+                if (available - pos < GDDV_V1_HEADER_SIZE)
+                    return kDataVaultTruncated;
+
+                DataVaultSegment segment;
+                segment.header = reinterpret_cast<const GDDVHeader *>(image + pos);
+                segment.offset = pos;
+                segment.length = length - pos;
+                segment.keyed = false;
+
+                if (segment.header->version.major != 2) {
+                    visitor.visitSegment(segment);
+                    return kDataVaultUnsupported;
+                }
+                if (segment.header->headersize != sizeof(GDDVHeader) ||
+                    length - pos < sizeof(GDDVHeader))
+                    return kDataVaultBadHeader;
+                if (available - pos < sizeof(GDDVHeader))
+                    return kDataVaultTruncated;
+
+                if (segment.header->v2.payload_size < segment.length - sizeof(GDDVHeader))
+                    segment.length = sizeof(GDDVHeader) + segment.header->v2.payload_size;
+
+                pos += sizeof(GDDVHeader);
+                if (length - pos >= sizeof(uint16_t)) {
+                    if (available - pos < sizeof(uint16_t))
+                        return kDataVaultTruncated;
+                    memcpy(&signature, image + pos, sizeof(uint16_t));
+                    segment.keyed = signature == ESIFDV_ITEM_KEYS_REV0_SIGNATURE;
+                }
+
+                if (!visitor.visitSegment(segment))
+                    return kDataVaultAborted;
+
+                if (segment.keyed) {
+                    offset = pos + sizeof(uint16_t);
+                } else {
+                    if (segment.header->v2.payload_size > length - pos)
+                        return kDataVaultTruncated;
+                    offset = pos + segment.header->v2.payload_size;
+                }
+                continue;
+            } else {
+                return kDataVaultBadSignature;
+            }
+        }
+
+        GDDVKeyHeader key, val;
+        if (available - pos < sizeof(GDDVKeyHeader))
+            return kDataVaultTruncated;
+        memcpy(&key, image + pos, sizeof(GDDVKeyHeader));
+        pos += sizeof(GDDVKeyHeader);
+
+        if (key.length > available - pos)
+            return kDataVaultTruncated;
+        const char *name = reinterpret_cast<const char *>(image + pos);
+        pos += key.length;
+
+        if (available - pos < sizeof(GDDVKeyHeader))
+            return kDataVaultTruncated;
+        memcpy(&val, image + pos, sizeof(GDDVKeyHeader));
+        pos += sizeof(GDDVKeyHeader);
+
+        if (val.length > available - pos)
+            return kDataVaultTruncated;
+        if (key.length == 0 || name[key.length - 1] != '\0')
+            return kDataVaultBadKey;
+
+        DataVaultKey item;
+        item.name = name;
+        item.name_length = key.length;
+        item.flags = key.flag;
+        item.type = val.flag;
+        item.value = image + pos;
+        item.length = val.length;
+        item.offset = pos;
+        offset = pos + val.length;
+
+        if (!visitor.visitKey(item))
+            return kDataVaultAborted;
+    }
+    return offset < length ? kDataVaultTruncated : kDataVaultOK;
+}
+
+int walkDataVault(const uint8_t *image, uint32_t length, DataVaultVisitor &visitor) {
+    DataVaultWalker walker(image, length);
+    return walker.resume(length, visitor);
+}
+
+bool DataVaultIndexBuilder::visitSegment(const DataVaultSegment &segment) {
+    return !segments || segments->visitSegment(segment);
+}
+
+bool DataVaultIndexBuilder::visitKey(const DataVaultKey &key) {
+    if (index.append(key))
+        return true;
+    nomem = true;
+    return false;
+}
+
+int DataVaultIndex::build(const uint8_t *image, uint32_t length, DataVaultVisitor *segments) {
+    DataVaultIndexBuilder builder(*this, segments);
+    reset(image, length);
+    int err = walkDataVault(image, length, builder);
+    finish();
+    return builder.nomem ? kDataVaultNoMemory : err;
+}
+
+void DataVaultIndex::reset(const uint8_t *image, uint32_t length) {
+    release();
+    this->image = image;
+    this->length = length;
+}
+
+bool DataVaultIndex::append(const DataVaultKey &key) {
+    if (count == capacity) {
+        uint32_t grow = capacity ? capacity * 2 : 16;
+        DataVaultIndexEntry *larger = reinterpret_cast<DataVaultIndexEntry *>(IOMalloc(grow * sizeof(DataVaultIndexEntry)));
+        if (!larger)
+            return false;
+        if (entries) {
+            memcpy(larger, entries, count * sizeof(DataVaultIndexEntry));
+            IOFree(entries, capacity * sizeof(DataVaultIndexEntry));
+        }
+        entries = larger;
+        capacity = grow;
+    }
+
+    DataVaultIndexEntry *entry = &entries[count++];
+    entry->name = (uint32_t)(reinterpret_cast<const uint8_t *>(key.name) - image);
+    entry->value = key.offset;
+    entry->length = key.length;
+    entry->type = (uint16_t)key.type;
+    entry->flags = (uint16_t)key.flags;
+    return true;
+}
+
+void DataVaultIndex::finish() {
+    // Keys are normally stored in order, so this stays linear in practice
+    for (uint32_t i = 1; i < count; i++) {
+        DataVaultIndexEntry entry = entries[i];
+        const char *name = getName(i);
+        uint32_t j = i;
+        while (j > 0 && strcmp(getName(j - 1), name) > 0) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+void DataVaultIndex::release() {
+    if (entries)
+        IOFree(entries, capacity * sizeof(DataVaultIndexEntry));
+    entries = nullptr;
+    image = nullptr;
+    length = 0;
+    count = 0;
+    capacity = 0;
+}
+
+bool DataVaultIndex::getKey(uint32_t i, DataVaultKey *key) const {
+    if (i >= count)
+        return false;
+
+    const DataVaultIndexEntry *entry = &entries[i];
+    key->name = getName(i);
+    key->name_length = (uint32_t)strlen(key->name) + 1;
+    key->flags = entry->flags;
+    key->type = entry->type;
+    key->value = image + entry->value;
+    key->length = entry->length;
+    key->offset = entry->value;
+    return true;
+}
+
+uint32_t DataVaultIndex::lowerBound(const char *path) const {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(getName(mid), path) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool DataVaultIndex::find(const char *path, DataVaultKey *key) const {
+    uint32_t i = lowerBound(path);
+    if (i >= count || strcmp(getName(i), path))
+        return false;
+    while (i + 1 < count && !strcmp(getName(i + 1), path))
+        i++;
+    return getKey(i, key);
+}
+
+bool DataVaultCursor::skip(uint64_t size) {
+    if (error || size > remaining()) {
+        error = true;
+        return false;
+    }
+    pos += size;
+    return true;
+}
+
+bool DataVaultCursor::readRaw(void *out, size_t size) {
+    if (error || size > remaining()) {
+        error = true;
+        return false;
+    }
+    memcpy(out, pos, size);
+    pos += size;
+    return true;
+}
+
+bool DataVaultCursor::readContainer(const uint64Container **container) {
+    *container = reinterpret_cast<const uint64Container *>(pos);
+    return skip(sizeof(uint64Container));
+}
+
+bool DataVaultCursor::readNumber(uint64_t *value) {
+    const uint64Container *container;
+    if (!readContainer(&container))
+        return false;
+    *value = container->value;
+    return true;
+}
+
+bool DataVaultCursor::readStringBody(uint64_t length, const char **str) {
+    const char *start = reinterpret_cast<const char *>(pos);
+    if (!skip(length))
+        return false;
+    if (length == 0) {
+        *str = "";
+        return true;
+    }
+    if (start[length - 1] != '\0') {
+        error = true;
+        return false;
+    }
+    *str = start;
+    return true;
+}
+
+bool DataVaultCursor::readString(const char **str, uint32_t *length) {
+    const uint64Container *container;
+    if (!readContainer(&container) || !readStringBody(container->value, str))
+        return false;
+    if (length)
+        *length = (uint32_t)container->value;
+    return true;
+}
+
+bool readTableVersion(DataVaultCursor &cursor, uint64_t *version) {
+    const uint64Container *container;
+    if (!cursor.readContainer(&container))
+        return false;
+    *version = container->value;
+    return container->type == ESIF_DATA_UINT64;
+}
+
+bool nextAPATEntry(DataVaultCursor &cursor, APATEntry *entry) {
+    if (cursor.done())
+        return false;
+
+    cursor.readNumber(&entry->target_id);
+    cursor.readString(&entry->name);
+    cursor.readString(&entry->participant);
+    cursor.readNumber(&entry->domain);
+    cursor.readString(&entry->code);
+    cursor.readString(&entry->argument);
+    return !cursor.failed();
+}
+
+bool nextAPCTTarget(DataVaultCursor &cursor, uint64_t version, uint64_t *target, uint32_t *count) {
+    if (cursor.done())
+        return false;
+
+    uint64_t slots = 0;
+    switch (version) {
+        case 1:
+            cursor.readNumber(target);
+            *count = APCT_V1_CONDITION_SLOTS;
+            break;
+
+        case 2:
+            cursor.readNumber(target);
+            if (cursor.readNumber(&slots) && slots > UINT32_MAX)
+                return false;
+            *count = (uint32_t)slots;
+            break;
+
+        default:
+            return false;
+    }
+    return !cursor.failed();
+}
+
+bool nextAPCTCondition(DataVaultCursor &cursor, uint64_t version, uint32_t &index, uint32_t count, APCTCondition *condition) {
+    if (index >= count || cursor.failed())
+        return false;
+
+    memset(condition, 0, sizeof(APCTCondition));
+    cursor.readNumber(&condition->condition);
+    if (version == 2) {
+        cursor.readString(&condition->device);
+        cursor.readNumber(&condition->unknown0);
+    }
+    cursor.readNumber(&condition->comparison);
+    cursor.readNumber(&condition->argument);
+    index++;
+
+    // The last condition of a set carries no operation
+    if (index < count) {
+        condition->has_operation = cursor.readNumber(&condition->operation);
+        if (condition->has_operation && condition->operation == FOR) {
+            condition->has_time = true;
+            if (version == 2) {
+                cursor.readNumber(&condition->unknown1);
+                cursor.readString(&condition->time_device);
+            }
+            cursor.readNumber(&condition->unknown2);
+            cursor.readNumber(&condition->time_comparison);
+            cursor.readNumber(&condition->time);
+            cursor.readNumber(&condition->unknown3);
+            index++;
+        }
+    }
+    return !cursor.failed();
+}
+
+bool nextAPPCEntry(DataVaultCursor &cursor, APPCEntry *entry) {
+    if (cursor.done())
+        return false;
+
+    cursor.readNumber(&entry->condition);
+    cursor.readString(&entry->name);
+    cursor.readString(&entry->participant);
+    cursor.readNumber(&entry->domain);
+    cursor.readNumber(&entry->type);
+    return !cursor.failed();
+}
+
+bool readPPCC(const void *data, uint32_t length, PPCCTable *table) {
+    const uint64Container *content = reinterpret_cast<const uint64Container *>(data);
+    uint32_t count = length / sizeof(uint64Container);
+    if (count < PPCC_FIXED_FIELDS)
+        return false;
+
+    table->version = content[0].value;
+    table->unknown1 = content[1].value;
+    table->power_limit_min = content[2].value;
+    table->power_limit_max = content[3].value;
+    table->time_wind_min = content[4].value;
+    table->time_wind_max = content[5].value;
+    table->step_size = content[6].value;
+    table->extra = content + PPCC_FIXED_FIELDS;
+    table->extra_count = count - PPCC_FIXED_FIELDS;
+    return true;
+}
+
+bool nextPSVTEntry(DataVaultCursor &cursor, PSVTEntry *entry) {
+    if (cursor.done())
+        return false;
+
+    cursor.readString(&entry->source);
+    cursor.readString(&entry->target);
+    cursor.readNumber(&entry->priority);
+    cursor.readNumber(&entry->sample_period);
+    cursor.readNumber(&entry->temp);
+    cursor.readNumber(&entry->domain);
+    cursor.readNumber(&entry->control_knob);
+
+    const uint64Container *limit;
+    entry->limit_string = nullptr;
+    entry->limit = 0;
+    if (cursor.readContainer(&limit)) {
+        if (limit->type == ESIF_DATA_STRING)
+            cursor.readStringBody(limit->value, &entry->limit_string);
+        else
+            entry->limit = limit->value;
+    }
+
+    cursor.readNumber(&entry->step_size);
+    cursor.readNumber(&entry->limit_coeff);
+    cursor.readNumber(&entry->unlimit_coeff);
+    cursor.readNumber(&entry->unknown);
+    return !cursor.failed();
+}
+
+bool nextIDSPEntry(DataVaultCursor &cursor, const uint8_t **guid) {
+    if (cursor.done() || cursor.remaining() < sizeof(guidContainer))
+        return false;
+
+    const guidContainer *item = reinterpret_cast<const guidContainer *>(cursor.position());
+    // Should be 5 - ESIF_DATA_GUID instead?
+    if (item->type != ESIF_DATA_BINARY || item->length < sizeof(item->guid))
+        return false;
+
+    *guid = item->guid;
+    return cursor.skip(sizeof(guidContainer) + item->length - sizeof(item->guid));
+}
+
+bool nextBinaryItem(DataVaultCursor &cursor, BinaryItem *item) {
+    if (cursor.done() || !cursor.readRaw(&item->type, sizeof(uint32_t)))
+        return false;
+
+    uint32_t number;
+    item->data = nullptr;
+    item->length = 0;
+    switch (item->type) {
+        case ESIF_DATA_UINT32:
+            if (!cursor.readRaw(&number, sizeof(uint32_t)))
+                return false;
+            item->number = number;
+            return true;
+
+        case ESIF_DATA_UINT64:
+            return cursor.readRaw(&item->number, sizeof(uint64_t));
+
+        case ESIF_DATA_BINARY:
+        case ESIF_DATA_STRING:
+        case ESIF_DATA_UNICODE:
+            if (!cursor.readRaw(&item->length, sizeof(uint64_t)))
+                return false;
+            item->data = cursor.position();
+            return cursor.skip(item->length);
+
+        default:
+            return false;
+    }
+}
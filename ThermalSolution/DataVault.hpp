@@ -0,0 +1,537 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  DataVault.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Kernel-agnostic GDDV DataVault walker and table readers, shared by the
+//  kext and the host build in Host/. Only depends on the C library, plus
+//  IOMalloc when built with KERNEL.
+//
+
+#ifndef DataVault_hpp
+#define DataVault_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+// From Common/esif_sdk_iface_esif.h:
+#define ESIF_SERVICE_CONFIG_COMPRESSED  0x40000000/* Payload is Compressed */
+//From ESIF/Products/ESIF_LIB/Sources/esif_lib_datavault.c
+#define ESIFDV_HEADER_SIGNATURE            0x1FE5
+#define ESIFDV_ITEM_KEYS_REV0_SIGNATURE    0xA0D8
+
+/* From esif_lilb_datavault.h */
+#define ESIFDV_NAME_LEN                32    // Max DataVault Name (Cache Name) Length (not including NULL)
+#define ESIFDV_DESC_LEN                64    // Max DataVault Description Length (not including NULL)
+
+#define SHA256_HASH_BYTES            32
+
+typedef struct __attribute__ ((packed)) {
+    uint16_t signature;
+    uint16_t headersize;
+    union {
+        uint32_t raw;
+        struct {
+            uint16_t revision;
+            uint8_t  minor;
+            uint8_t  major;
+        };
+    } version;
+    union {
+        /* Added in V1 */
+        struct {
+            uint32_t flags;
+        } v1;
+
+        /* Added in V2 */
+        struct {
+            uint32_t flags;
+            char     segmentid[ESIFDV_NAME_LEN];
+            char     comment[ESIFDV_DESC_LEN];
+            uint8_t  payload_hash[SHA256_HASH_BYTES];
+            uint32_t payload_size;
+            uint32_t payload_class;
+        } v2;
+    };
+} GDDVHeader;
+
+typedef struct __attribute__ ((packed)) {
+    uint32_t flag;
+    uint32_t length;
+} GDDVKeyHeader;
+
+/* From esif_sdk_data_type.h */
+typedef enum esif_data_type {
+    ESIF_DATA_ANGLE = 41,
+    ESIF_DATA_AUTO = 36,
+    ESIF_DATA_BINARY = 7,
+    ESIF_DATA_BLOB = 34,
+    ESIF_DATA_DECIBEL = 39,
+    ESIF_DATA_DSP = 33,
+    ESIF_DATA_ENUM = 19,
+    ESIF_DATA_FREQUENCY = 40,
+    ESIF_DATA_GUID = 5,
+    ESIF_DATA_HANDLE = 20,
+    ESIF_DATA_INSTANCE = 30,
+    ESIF_DATA_INT16 = 12,
+    ESIF_DATA_INT32 = 13,
+    ESIF_DATA_INT64 = 14,
+    ESIF_DATA_INT8 = 11,
+    ESIF_DATA_IPV4 = 16,
+    ESIF_DATA_IPV6 = 17,
+    ESIF_DATA_JSON = 42,
+    ESIF_DATA_PERCENT = 29,
+    ESIF_DATA_POINTER = 18,
+    ESIF_DATA_POWER = 26,
+    ESIF_DATA_QUALIFIER = 28,
+    ESIF_DATA_REGISTER = 15,
+    ESIF_DATA_STRING = 8,
+    ESIF_DATA_STRUCTURE = 32,
+    ESIF_DATA_TABLE = 35,
+    ESIF_DATA_TEMPERATURE = 6,
+    ESIF_DATA_TIME = 31,
+    ESIF_DATA_UINT16 = 2,
+    ESIF_DATA_UINT32 = 3,
+    ESIF_DATA_UINT64 = 4,
+    ESIF_DATA_UINT8 = 1,
+    ESIF_DATA_UNICODE = 9,
+    ESIF_DATA_VOID = 24,
+    ESIF_DATA_XML = 38,
+} esif_data_type_t;
+
+typedef struct __attribute__ ((packed)) {
+    uint32_t type;
+    uint64_t value;
+} uint64Container;
+
+typedef struct __attribute__ ((packed)) {
+    uint32_t type;
+    uint64_t length;
+    uint8_t guid[16];
+} guidContainer;
+
+enum adaptive_operation {
+    AND = 0x01,
+    FOR
+};
+
+enum adaptive_comparison {
+    ADAPTIVE_EQUAL = 0x01,
+    ADAPTIVE_LESSER_OR_EQUAL,
+    ADAPTIVE_GREATER_OR_EQUAL,
+};
+
+enum {
+    kDataVaultOK = 0,
+    kDataVaultBadSignature,
+    kDataVaultBadHeader,
+    kDataVaultBadPayload,
+    kDataVaultBadKey,
+    kDataVaultTruncated,
+    kDataVaultUnsupported,
+    kDataVaultDecompressFailed,
+    kDataVaultNoMemory,
+    kDataVaultAborted,
+};
+
+const char *dataVaultError(int err);
+
+// Output granularity of the streaming decoder
+#define DATAVAULT_DECODE_CHUNK 0x4000
+
+/**
+ * Validate the outer GDDV header against the buffer returned by firmware.
+ * @param buf GDDV buffer, starting with GDDVHeader
+ * @param length Length of the buffer
+ *
+ * @return *kDataVaultOK* if the header and the declared payload fit in the buffer
+ */
+int checkDataVaultHeader(const void *buf, size_t length);
+
+static inline bool isDataVaultCompressed(const GDDVHeader *hdr) {
+    return hdr->version.major == 2 && (hdr->v2.flags & ESIF_SERVICE_CONFIG_COMPRESSED);
+}
+
+enum {
+    kDataVaultTableNone = 0,
+    kDataVaultTableAPAT,
+    kDataVaultTableAPCT,
+    kDataVaultTableAPPC,
+    kDataVaultTablePPCC,
+    kDataVaultTablePSVT,
+    kDataVaultTableIDSP,
+};
+
+/**
+ * Last component of a key path including its leading '/', e.g. "/apat" for "/shared/tables/apat"
+ */
+const char *dataVaultLeafName(const char *path);
+
+/**
+ * Which table decoder applies to a binary key
+ */
+int classifyDataVaultKey(const char *path);
+
+struct DataVaultSegment {
+    const GDDVHeader *header;
+    uint32_t offset;        // offset of the header in the image
+    uint32_t length;        // header and payload bytes available in the image
+    bool keyed;             // followed by key/value records
+};
+
+struct DataVaultKey {
+    const char *name;       // NUL-terminated full path
+    uint32_t name_length;   // stored length including NUL
+    uint32_t flags;
+    uint32_t type;          // esif_data_type_t
+    const uint8_t *value;
+    uint32_t length;
+    uint32_t offset;        // offset of the value in the image
+};
+
+class DataVaultVisitor {
+public:
+    virtual ~DataVaultVisitor() {}
+
+    /**
+     * Called for each nested GDDV header found inside a v2 image.
+     * @return false to stop walking
+     */
+    virtual bool visitSegment(const DataVaultSegment &segment) { return true; }
+
+    /**
+     * Called for each key/value record in image order.
+     * @return false to stop walking
+     */
+    virtual bool visitKey(const DataVaultKey &key) { return true; }
+};
+
+/**
+ * Resumable walker over an image that may still be filling up, e.g. while it is decompressed.
+ */
+class DataVaultWalker {
+    const uint8_t *image;
+    uint32_t length;
+    uint32_t offset {0};
+    bool keyed {false};
+
+public:
+    DataVaultWalker(const uint8_t *image, uint32_t length) : image(image), length(length) {};
+
+    /**
+     * Visit every record that lies completely within the first bytes of the image.
+     * @param available Number of leading bytes already valid
+     * @param visitor Receives segments and keys in image order, each exactly once
+     *
+     * @return *kDataVaultTruncated* while the image ends before the last record, which is only
+     *  an error once available reaches the full length
+     */
+    int resume(uint32_t available, DataVaultVisitor &visitor);
+    uint32_t getOffset() const { return offset; };
+};
+
+/**
+ * Walk all key/value records of a (decompressed) DataVault image.
+ * @param image Image starting with GDDVHeader
+ * @param length Length of the image
+ * @param visitor Receives segments and keys in image order
+ *
+ * @return *kDataVaultOK* if the whole image was walked, *kDataVaultAborted* if the visitor stopped
+ */
+int walkDataVault(const uint8_t *image, uint32_t length, DataVaultVisitor &visitor);
+
+struct DataVaultIndexEntry {
+    uint32_t name;          // offset of the NUL-terminated key path
+    uint32_t value;         // offset of the value
+    uint32_t length;        // value length
+    uint16_t type;          // esif_data_type_t
+    uint16_t flags;
+};
+
+/**
+ * Read-only index over a DataVault image, sorted by key path.
+ * The image is not copied and must outlive the index.
+ */
+class DataVaultIndex {
+    const uint8_t *image {nullptr};
+    uint32_t length {0};
+    DataVaultIndexEntry *entries {nullptr};
+    uint32_t count {0};
+    uint32_t capacity {0};
+
+public:
+    ~DataVaultIndex() { release(); };
+
+    /**
+     * Index all keys of an image, replacing any previous index.
+     * @param image Decompressed image starting with GDDVHeader
+     * @param length Length of the image
+     * @param segments Optional visitor notified of nested segments
+     *
+     * @return Result of the walk, keys found before an error stay indexed
+     */
+    int build(const uint8_t *image, uint32_t length, DataVaultVisitor *segments=nullptr);
+    void release();
+
+    /**
+     * Incremental build: reset() to an empty index over image, append() keys in any order,
+     * then finish() to sort. Only bytes already visited need to be valid.
+     */
+    void reset(const uint8_t *image, uint32_t length);
+    bool append(const DataVaultKey &key);
+    void finish();
+
+    uint32_t getCount() const { return count; };
+    uint32_t getLength() const { return length; };
+    size_t getIndexSize() const { return capacity * sizeof(DataVaultIndexEntry); };
+    const char *getName(uint32_t i) const { return reinterpret_cast<const char *>(image + entries[i].name); };
+    bool getKey(uint32_t i, DataVaultKey *key) const;
+
+    /**
+     * Position of the first key not ordered before path
+     */
+    uint32_t lowerBound(const char *path) const;
+
+    /**
+     * Exact lookup, the last key wins if a path is stored twice
+     */
+    bool find(const char *path, DataVaultKey *key) const;
+};
+
+/**
+ * Feeds keys into a DataVaultIndex, forwarding segments to another visitor.
+ */
+class DataVaultIndexBuilder : public DataVaultVisitor {
+    DataVaultIndex &index;
+    DataVaultVisitor *segments;
+
+public:
+    bool nomem {false};
+
+    DataVaultIndexBuilder(DataVaultIndex &index, DataVaultVisitor *segments=nullptr) :
+        index(index), segments(segments) {};
+
+    bool visitSegment(const DataVaultSegment &segment) override;
+    bool visitKey(const DataVaultKey &key) override;
+};
+
+/**
+ * Streaming decoder for compressed v2 payloads. The LZMA stream is decoded in chunks
+ * straight into a single image buffer, and records are handed to a visitor as soon as
+ * they are complete. Peak memory is the image plus the LZMA probability tables.
+ */
+struct DataVaultLzma;
+
+class DataVaultDecoder {
+    DataVaultLzma *lzma {nullptr};
+    const uint8_t *src {nullptr};
+    size_t srcLength {0};
+    uint8_t *image {nullptr};
+    uint32_t length {0};
+    uint32_t decoded {0};
+
+public:
+    ~DataVaultDecoder() { release(); };
+
+    /**
+     * Check the LZMA header and allocate the image, replacing any previous one.
+     * @param hdr Validated outer header of a compressed v2 DataVault
+     *
+     * @return *kDataVaultOK* upon success
+     */
+    int begin(const GDDVHeader *hdr);
+
+    /**
+     * Decompress the whole payload.
+     * @param visitor Receives records while decoding, or NULL to only decompress
+     * @param chunk Bytes decoded between two walks
+     *
+     * @return *kDataVaultOK* once the image is complete and was walked to its end
+     */
+    int decode(DataVaultVisitor *visitor, uint32_t chunk=DATAVAULT_DECODE_CHUNK);
+
+    /**
+     * Free the LZMA state but keep the image
+     */
+    void finish();
+    void release();
+
+    const uint8_t *getImage() const { return image; };
+    uint32_t getLength() const { return length; };
+    uint32_t getDecoded() const { return decoded; };
+};
+
+/**
+ * Decoded image and key index of the last compressed payload, keyed by its payload_hash.
+ * Reloading an unchanged DataVault costs one hash comparison and reuses both in place.
+ * Nothing is persisted, only re-reads within one load of the driver can hit.
+ */
+class DataVaultCache {
+    uint8_t hash[SHA256_HASH_BYTES];
+    bool valid {false};
+
+public:
+    DataVaultDecoder decoder;
+    DataVaultIndex index;
+    uint32_t hits {0};
+    uint32_t misses {0};
+
+    /**
+     * @param hdr Validated outer header of a compressed v2 DataVault
+     *
+     * @return true if the cached image and index belong to this payload
+     */
+    bool lookup(const GDDVHeader *hdr);
+
+    /**
+     * Decode and index a payload, replacing the cached one. Only a complete walk is kept
+     * for later lookups, a partial index stays usable until the next load.
+     * @param hdr Validated outer header of a compressed v2 DataVault
+     * @param segments Optional visitor notified of nested segments
+     *
+     * @return Result of the decoder or the walk
+     */
+    int load(const GDDVHeader *hdr, DataVaultVisitor *segments=nullptr);
+    void release();
+};
+
+/**
+ * Bounds-checked reader for binary table values (APAT, APCT, PSVT...).
+ * Every read fails once the cursor runs past the end, and the failure is sticky.
+ */
+class DataVaultCursor {
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool error {false};
+
+public:
+    DataVaultCursor(const void *data, uint32_t length) :
+        pos(reinterpret_cast<const uint8_t *>(data)),
+        end(reinterpret_cast<const uint8_t *>(data) + length) {};
+
+    bool done() const { return error || pos >= end; };
+    bool failed() const { return error; };
+    const uint8_t *position() const { return pos; };
+    size_t remaining() const { return pos < end ? end - pos : 0; };
+
+    bool skip(uint64_t size);
+    bool readRaw(void *out, size_t size);
+    bool readContainer(const uint64Container **container);
+    bool readNumber(uint64_t *value);
+    bool readStringBody(uint64_t length, const char **str);
+    bool readString(const char **str, uint32_t *length=nullptr);
+};
+
+/**
+ * Read the leading version container shared by all adaptive tables
+ */
+bool readTableVersion(DataVaultCursor &cursor, uint64_t *version);
+
+struct APATEntry {
+    uint64_t target_id;
+    const char *name;
+    const char *participant;
+    uint64_t domain;
+    const char *code;
+    const char *argument;
+};
+
+bool nextAPATEntry(DataVaultCursor &cursor, APATEntry *entry);
+
+struct APCTCondition {
+    uint64_t condition;
+    const char *device;         // v2 only
+    uint64_t unknown0;          // v2 only
+    uint64_t comparison;
+    uint64_t argument;
+    bool has_operation;
+    uint64_t operation;
+    bool has_time;              // operation is FOR
+    uint64_t unknown1;          // v2 only
+    const char *time_device;    // v2 only
+    uint64_t unknown2;
+    uint64_t time_comparison;
+    uint64_t time;
+    uint64_t unknown3;
+};
+
+#define APCT_V1_CONDITION_SLOTS 10
+
+/**
+ * Read the target id and condition slot count of the next APCT condition set
+ */
+bool nextAPCTTarget(DataVaultCursor &cursor, uint64_t version, uint64_t *target, uint32_t *count);
+
+/**
+ * Read the next condition of the current set, FOR clauses consume an extra slot.
+ * @param index Current slot, advanced past the condition
+ * @param count Slot count returned by nextAPCTTarget
+ */
+bool nextAPCTCondition(DataVaultCursor &cursor, uint64_t version, uint32_t &index, uint32_t count, APCTCondition *condition);
+
+struct APPCEntry {
+    uint64_t condition;
+    const char *name;
+    const char *participant;
+    uint64_t domain;
+    uint64_t type;
+};
+
+bool nextAPPCEntry(DataVaultCursor &cursor, APPCEntry *entry);
+
+#define PPCC_FIXED_FIELDS 7
+
+struct PPCCTable {
+    uint64_t version;
+    uint64_t unknown1;
+    uint64_t power_limit_min;
+    uint64_t power_limit_max;
+    uint64_t time_wind_min;
+    uint64_t time_wind_max;
+    uint64_t step_size;
+    const uint64Container *extra;
+    uint32_t extra_count;
+};
+
+bool readPPCC(const void *data, uint32_t length, PPCCTable *table);
+
+struct PSVTEntry {
+    const char *source;
+    const char *target;
+    uint64_t priority;
+    uint64_t sample_period;
+    uint64_t temp;
+    uint64_t domain;
+    uint64_t control_knob;
+    const char *limit_string;   // non-null if limit is a string
+    uint64_t limit;
+    uint64_t step_size;
+    uint64_t limit_coeff;
+    uint64_t unlimit_coeff;
+    uint64_t unknown;
+};
+
+bool nextPSVTEntry(DataVaultCursor &cursor, PSVTEntry *entry);
+
+/**
+ * Read the next IDSP GUID (raw 16 bytes as stored in the table)
+ */
+bool nextIDSPEntry(DataVaultCursor &cursor, const uint8_t **guid);
+
+struct BinaryItem {
+    uint32_t type;
+    uint64_t number;
+    const uint8_t *data;
+    uint64_t length;
+};
+
+/**
+ * Read the next typed item of an unknown binary key.
+ * Fails on unknown data types, leaving item->type set to the offending type.
+ */
+bool nextBinaryItem(DataVaultCursor &cursor, BinaryItem *item);
+
+#endif /* DataVault_hpp */
@@ -0,0 +1,78 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  EventQueue.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Coalescing queue deferring ACPI notification work to the work loop, so
+//  a burst of identical notifications costs one evaluation.
+//
+
+#ifndef EventQueue_hpp
+#define EventQueue_hpp
+
+#include <IOKit/IOTimerEventSource.h>
+#include "common.h"
+
+// Window for a burst of notifications to collapse into one evaluation
+#define EVENT_QUEUE_DELAY_MS 20
+
+class EventQueue {
+    IOTimerEventSource *timer {nullptr};
+    volatile UInt32 pending {0};
+    volatile UInt32 posted {0};
+    volatile UInt32 runs {0};
+
+public:
+    /**
+     * @param action Called on the work loop, takes the pending events with take()
+     *
+     * @return true upon success
+     */
+    bool init(OSObject *owner, IOWorkLoop *workLoop, IOTimerEventSource::Action action) {
+        timer = IOTimerEventSource::timerEventSource(owner, action);
+        if (timer && workLoop->addEventSource(timer) == kIOReturnSuccess)
+            return true;
+        OSSafeReleaseNULL(timer);
+        return false;
+    };
+
+    void free(IOWorkLoop *workLoop) {
+        if (!timer)
+            return;
+        timer->cancelTimeout();
+        workLoop->removeEventSource(timer);
+        OSSafeReleaseNULL(timer);
+    };
+
+    /**
+     * Mark events pending, callable from any thread. Only the first event of a burst arms
+     * the timer, the rest are picked up by the same run.
+     * @param events Bitmask defined by the owner
+     */
+    void post(UInt32 events) {
+        __atomic_fetch_add(&posted, 1, __ATOMIC_RELAXED);
+        if (!__atomic_fetch_or(&pending, events, __ATOMIC_SEQ_CST) && timer)
+            timer->setTimeoutMS(EVENT_QUEUE_DELAY_MS);
+    };
+
+    /**
+     * Claim the pending events, events posted afterwards arm the timer again
+     */
+    UInt32 take() {
+        __atomic_fetch_add(&runs, 1, __ATOMIC_RELAXED);
+        return __atomic_exchange_n(&pending, 0, __ATOMIC_SEQ_CST);
+    };
+
+    OSDictionary *getStats() {
+        OSDictionary *ret = OSDictionary::withCapacity(2);
+        OSObject *value;
+        setPropertyNumber(ret, "Posted", __atomic_load_n(&posted, __ATOMIC_RELAXED), 32);
+        setPropertyNumber(ret, "Runs", __atomic_load_n(&runs, __ATOMIC_RELAXED), 32);
+        return ret;
+    };
+};
+
+#endif /* EventQueue_hpp */
@@ -0,0 +1,80 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  LPAT.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include "LPAT.hpp"
+
+bool LPATTable::build(const int32_t *values, uint32_t length) {
+    count = 0;
+    if (length % 2 || length < 4 || length / 2 > LPAT_MAX_POINTS)
+        return false;
+
+    // Insert by raw value, thermistor tables usually run backwards
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < length; i += 2) {
+        int32_t temp = values[i];
+        int32_t raw = values[i + 1];
+        uint32_t j = n++;
+        for (; j > 0 && raws[j - 1] > raw; j--) {
+            raws[j] = raws[j - 1];
+            temps[j] = temps[j - 1];
+        }
+        raws[j] = raw;
+        temps[j] = temp;
+    }
+
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        int64_t span = (int64_t)raws[i + 1] - raws[i];
+        if (span <= 0)
+            return false;
+        slopes[i] = ((int64_t)(temps[i + 1] - temps[i]) * 65536) / span;
+    }
+    slopes[n - 1] = 0;
+
+    for (uint32_t i = n; i < LPAT_MAX_POINTS; i++) {
+        raws[i] = INT32_MAX;
+        temps[i] = 0;
+        slopes[i] = 0;
+    }
+    count = n;
+    return true;
+}
+
+bool LPATTable::convertLinear(int32_t raw, int32_t *temp) const {
+    if (!count || raw < raws[0] || raw > raws[count - 1])
+        return false;
+
+    // Count the points at or below the reading, padding never matches
+    uint32_t below = 0;
+    for (uint32_t i = 0; i < LPAT_LINEAR_POINTS; i++)
+        below += raws[i] <= raw;
+
+    uint32_t i = below - 1;
+    i -= i == count - 1;
+    *temp = interpolate(i, raw);
+    return true;
+}
+
+bool LPATTable::convertSearch(int32_t raw, int32_t *temp) const {
+    if (!count || raw < raws[0] || raw > raws[count - 1])
+        return false;
+
+    // Last point at or below the reading, the loop compiles to conditional moves
+    const int32_t *base = raws;
+    uint32_t n = count;
+    while (n > 1) {
+        uint32_t half = n / 2;
+        base = base[half] <= raw ? base + half : base;
+        n -= half;
+    }
+
+    uint32_t i = (uint32_t)(base - raws);
+    i -= i == count - 1;
+    *temp = interpolate(i, raw);
+    return true;
+}
@@ -0,0 +1,62 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  LPAT.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Conversion of raw sensor readings through the LPAT look-up table, based on
+//  linux/drivers/acpi/acpi_lpat.c. Kernel-agnostic, so the host build can
+//  time it.
+//
+
+#ifndef LPAT_hpp
+#define LPAT_hpp
+
+#include <stdint.h>
+
+#define LPAT_MAX_POINTS     64
+// Tables up to this size are scanned without branches instead of searched
+#define LPAT_LINEAR_POINTS  16
+
+class LPATTable {
+    // Sorted by raw value, padded with INT32_MAX for the linear scan
+    int32_t raws[LPAT_MAX_POINTS];
+    int32_t temps[LPAT_MAX_POINTS];
+    // Slope of the segment starting at each point, 16.16 fixed point
+    int64_t slopes[LPAT_MAX_POINTS];
+    uint32_t count {0};
+
+    inline int32_t interpolate(uint32_t i, int32_t raw) const {
+        return temps[i] + (int32_t)(((int64_t)(raw - raws[i]) * slopes[i]) >> 16);
+    };
+
+public:
+    /**
+     * Build from the LPAT package, pairs of temperature and raw value. The raw values may
+     * run in either direction but have to be strictly monotonic.
+     * @param values Temperature and raw value of each point, temperatures in deci-Celsius
+     * @param length Number of values, twice the number of points
+     *
+     * @return true upon success
+     */
+    bool build(const int32_t *values, uint32_t length);
+
+    uint32_t getCount() const { return count; };
+
+    /**
+     * Convert a raw reading, picking the branch-free scan for small tables
+     * @param temp Deci-Celsius
+     *
+     * @return false if the raw value is outside the table
+     */
+    bool convert(int32_t raw, int32_t *temp) const {
+        return count <= LPAT_LINEAR_POINTS ? convertLinear(raw, temp) : convertSearch(raw, temp);
+    };
+
+    bool convertLinear(int32_t raw, int32_t *temp) const;
+    bool convertSearch(int32_t raw, int32_t *temp) const;
+};
+
+#endif /* LPAT_hpp */
@@ -0,0 +1,139 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  PassivePolicy.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include <string.h>
+#include "PassivePolicy.hpp"
+#include "portable.h"
+
+// PSVT sample_period is in tenths of a second like _TSP
+#define PASSIVE_PERIOD_UNIT_MS  100
+
+static uint32_t intern(const char **names, uint32_t *count, const char *name) {
+    for (uint32_t i = 0; i < *count; i++)
+        if (!strcmp(names[i], name))
+            return i;
+    names[*count] = name;
+    return (*count)++;
+}
+
+int PassivePolicy::compile(const void *data, uint32_t length) {
+    release();
+
+    DataVaultCursor cursor(data, length);
+    uint64_t version;
+    if (!readTableVersion(cursor, &version) || version != 2)
+        return kDataVaultUnsupported;
+
+    uint32_t total = 0;
+    PSVTEntry item;
+    while (nextPSVTEntry(cursor, &item))
+        total++;
+    if (cursor.failed())
+        return kDataVaultTruncated;
+    if (!total)
+        return kDataVaultOK;
+
+    blockSize = total * (sizeof(PassiveEntry) + sizeof(PassiveState) + 2 * sizeof(const char *));
+    block = IOMalloc(blockSize);
+    if (!block) {
+        blockSize = 0;
+        return kDataVaultNoMemory;
+    }
+    memset(block, 0, blockSize);
+    entries = reinterpret_cast<PassiveEntry *>(block);
+    states = reinterpret_cast<PassiveState *>(entries + total);
+    sensors = reinterpret_cast<const char **>(states + total);
+    devices = sensors + total;
+
+    DataVaultCursor second(data, length);
+    readTableVersion(second, &version);
+    while (entryCount < total && nextPSVTEntry(second, &item)) {
+        PassiveEntry *entry = &entries[entryCount++];
+        entry->sensor = intern(sensors, &sensorCount, item.target);
+        entry->device = intern(devices, &deviceCount, item.source);
+        entry->period = (uint32_t)(item.sample_period ? item.sample_period : 1) * PASSIVE_PERIOD_UNIT_MS;
+        entry->trip = (uint32_t)item.temp;
+        entry->knob = (uint32_t)item.control_knob;
+        entry->priority = (uint32_t)item.priority;
+        entry->step = (int64_t)item.step_size;
+        entry->limit_coeff = item.limit_coeff ? (int64_t)item.limit_coeff : 1;
+        entry->unlimit_coeff = item.unlimit_coeff ? (int64_t)item.unlimit_coeff : 1;
+        entry->limit = (int64_t)item.limit;
+        if (!item.limit_string)
+            entry->limit_kind = kPassiveLimitNumber;
+        else if (!strcmp(item.limit_string, "MIN"))
+            entry->limit_kind = kPassiveLimitMin;
+        else
+            entry->limit_kind = kPassiveLimitMax;
+    }
+    return kDataVaultOK;
+}
+
+void PassivePolicy::release() {
+    if (block)
+        IOFree(block, blockSize);
+    block = nullptr;
+    blockSize = 0;
+    entries = nullptr;
+    states = nullptr;
+    sensors = nullptr;
+    devices = nullptr;
+    entryCount = 0;
+    sensorCount = 0;
+    deviceCount = 0;
+}
+
+void PassivePolicy::setRange(uint32_t i, int64_t min, int64_t max) {
+    if (i >= entryCount)
+        return;
+
+    PassiveEntry *entry = &entries[i];
+    PassiveState *state = &states[i];
+    if (entry->limit_kind == kPassiveLimitMax)
+        entry->limit = max;
+    else if (entry->limit_kind == kPassiveLimitMin)
+        entry->limit = min;
+    state->value = max;
+    state->max = max;
+    state->active = true;
+    state->throttling = false;
+    state->changed = false;
+}
+
+static inline int64_t approach(int64_t value, int64_t goal, int64_t delta) {
+    if (delta <= 0)
+        return value;
+    if (value > goal)
+        return value - goal > delta ? value - delta : goal;
+    return goal - value > delta ? value + delta : goal;
+}
+
+bool PassivePolicy::step(uint32_t i, uint32_t temperature) {
+    if (i >= entryCount)
+        return false;
+
+    const PassiveEntry *entry = &entries[i];
+    PassiveState *state = &states[i];
+    state->changed = false;
+    if (!state->active || !temperature)
+        return false;
+
+    int64_t value;
+    state->throttling = temperature >= entry->trip;
+    if (state->throttling)
+        value = approach(state->value, entry->limit, entry->step * entry->limit_coeff);
+    else
+        value = approach(state->value, state->max, entry->step * entry->unlimit_coeff);
+    if (value == state->value)
+        return false;
+
+    state->value = value;
+    state->changed = true;
+    return true;
+}
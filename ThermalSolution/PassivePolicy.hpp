@@ -0,0 +1,114 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  PassivePolicy.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Passive control engine driven by the PSVT table. Kernel-agnostic like
+//  DataVault, the caller supplies temperatures and applies knob values.
+//
+
+#ifndef PassivePolicy_hpp
+#define PassivePolicy_hpp
+
+#include "DataVault.hpp"
+
+enum {
+    kPassiveLimitNumber = 0,
+    kPassiveLimitMax,
+    kPassiveLimitMin,
+};
+
+// DPTF control knob types of PSVT entries
+enum {
+    kPassiveKnobPL1 = 0x10000,
+    kPassiveKnobPL2,
+    kPassiveKnobPL3,
+    kPassiveKnobPL4,
+};
+
+static inline bool isPowerLimitKnob(uint32_t knob) {
+    return knob >= kPassiveKnobPL1 && knob <= kPassiveKnobPL4;
+}
+
+struct PassiveEntry {
+    uint32_t sensor;            // index of the PSVT target
+    uint32_t device;            // index of the PSVT source
+    uint32_t period;            // milliseconds
+    uint32_t trip;              // deci-Kelvin
+    uint32_t knob;              // control_knob
+    uint32_t priority;
+    int64_t limit;              // numeric limit, resolved by setRange() for MAX/MIN
+    int64_t step;
+    int64_t limit_coeff;
+    int64_t unlimit_coeff;
+    uint8_t limit_kind;
+};
+
+struct PassiveState {
+    int64_t value;              // current knob value
+    int64_t max;                // unthrottled value
+    bool active;                // has a range
+    bool throttling;
+    bool changed;               // value moved in the last step
+};
+
+class PassivePolicy {
+    // All arrays live in one block sized at compile time
+    void *block {nullptr};
+    size_t blockSize {0};
+
+    PassiveEntry *entries {nullptr};
+    PassiveState *states {nullptr};
+    uint32_t entryCount {0};
+    const char **sensors {nullptr};
+    uint32_t sensorCount {0};
+    const char **devices {nullptr};
+    uint32_t deviceCount {0};
+
+public:
+    ~PassivePolicy() { release(); };
+
+    /**
+     * Flatten a PSVT table, replacing any previous one. Participant names point into data,
+     * which has to outlive the policy.
+     * @param data PSVT value from the DataVault
+     * @param length Length of the value
+     *
+     * @return *kDataVaultOK* upon success
+     */
+    int compile(const void *data, uint32_t length);
+    void release();
+
+    /**
+     * Set the range of the knob controlled by an entry and start it unthrottled.
+     * Entries without a range are skipped by step().
+     * @param i Entry index
+     * @param min Most throttled value, used for a MIN limit
+     * @param max Unthrottled value, used for a MAX limit
+     */
+    void setRange(uint32_t i, int64_t min, int64_t max);
+
+    /**
+     * Step the knob of an entry once its period is up: toward the limit by step_size *
+     * limit_coeff at or above the trip temperature, back toward the unthrottled value by
+     * step_size * unlimit_coeff below it. The caller schedules entries by their period.
+     * @param i Entry index
+     * @param temperature Deci-Kelvin of the entry's sensor, 0 if unavailable
+     *
+     * @return true if the value changed
+     */
+    bool step(uint32_t i, uint32_t temperature);
+
+    uint32_t getEntryCount() const { return entryCount; };
+    const PassiveEntry *getEntry(uint32_t i) const { return i < entryCount ? &entries[i] : nullptr; };
+    const PassiveState *getState(uint32_t i) const { return i < entryCount ? &states[i] : nullptr; };
+    uint32_t getSensorCount() const { return sensorCount; };
+    const char *getSensorName(uint32_t i) const { return i < sensorCount ? sensors[i] : nullptr; };
+    uint32_t getDeviceCount() const { return deviceCount; };
+    const char *getDeviceName(uint32_t i) const { return i < deviceCount ? devices[i] : nullptr; };
+};
+
+#endif /* PassivePolicy_hpp */
@@ -0,0 +1,115 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  PowerController.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include "PowerController.hpp"
+
+uint32_t PowerController::stepSize(uint32_t i) const {
+    const PowerLimitRange *range = &ranges[i];
+    if (range->step_uw)
+        return range->step_uw;
+    uint32_t step = (range->max_uw - range->min_uw) / 16;
+    return step ? step : 1;
+}
+
+uint32_t PowerController::quantize(uint32_t i, int64_t value) const {
+    const PowerLimitRange *range = &ranges[i];
+    if (value <= range->min_uw)
+        return range->min_uw;
+    if (value >= range->max_uw)
+        return range->max_uw;
+    // Whole steps above the minimum, like the firmware would program them
+    uint32_t step = stepSize(i);
+    return range->min_uw + (uint32_t)((value - range->min_uw) / step) * step;
+}
+
+bool PowerController::configure(const PowerLimitRange *ranges, uint32_t count) {
+    if (count > POWER_LIMIT_COUNT)
+        count = POWER_LIMIT_COUNT;
+
+    uint32_t previous = rangeCount;
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++) {
+        this->ranges[i] = ranges[i];
+        if (this->ranges[i].max_uw < this->ranges[i].min_uw)
+            this->ranges[i].max_uw = this->ranges[i].min_uw;
+    }
+    rangeCount = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t limit = i >= previous ? this->ranges[i].max_uw : quantize(i, state.limits[i]);
+        changed |= limit != state.limits[i];
+        state.limits[i] = limit;
+    }
+    for (uint32_t i = count; i < POWER_LIMIT_COUNT; i++)
+        state.limits[i] = 0;
+    if (!previous) {
+        state.integral = 0;
+        state.previous = 0;
+    }
+    return changed;
+}
+
+bool PowerController::step(const PowerControllerInputs &inputs) {
+    if (!rangeCount)
+        return false;
+    state.ticks++;
+
+    const PowerLimitRange *pl1 = &ranges[0];
+    int64_t step = stepSize(0);
+    int64_t next = state.limits[0];
+
+    if (!inputs.target) {
+        // Nothing to hold, sit at the firmware maximum
+        state.integral = 0;
+        next = pl1->max_uw;
+    } else if (inputs.temperature) {
+        int32_t error = (int32_t)inputs.temperature - (int32_t)inputs.target;
+        int32_t rise = state.previous ? (int32_t)inputs.temperature - (int32_t)state.previous : 0;
+        if (error >= 0) {
+            int64_t steps = 1 + error / POWER_CONTROL_BAND;
+            if (steps > POWER_CONTROL_MAX_STEPS)
+                steps = POWER_CONTROL_MAX_STEPS;
+            state.integral += error;
+            if (state.integral >= POWER_CONTROL_INTEGRAL) {
+                steps++;
+                state.integral = 0;
+            }
+            next -= steps * step;
+        } else if (error > -POWER_CONTROL_HYSTERESIS) {
+            state.integral /= 2;
+            if (rise >= POWER_CONTROL_RISE)
+                next -= step;
+        } else {
+            state.integral = 0;
+            next += step;
+        }
+        state.previous = inputs.temperature;
+    }
+
+    if (inputs.ceiling_uw && next > inputs.ceiling_uw)
+        next = inputs.ceiling_uw;
+
+    uint32_t limits[POWER_LIMIT_COUNT];
+    limits[0] = quantize(0, next);
+    if (rangeCount > 1) {
+        // PL2 rides above PL1 by the headroom of the two maximums
+        const PowerLimitRange *pl2 = &ranges[1];
+        int64_t headroom = (int64_t)pl2->max_uw - pl1->max_uw;
+        limits[1] = quantize(1, (int64_t)limits[0] + (headroom > 0 ? headroom : 0));
+    }
+
+    bool changed = false;
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        changed |= limits[i] != state.limits[i];
+        state.limits[i] = limits[i];
+    }
+    if (changed)
+        state.changes++;
+    return changed;
+}
@@ -0,0 +1,86 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  PowerController.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Closed-loop PL1/PL2 controller inside the PPCC range. Kernel-agnostic and
+//  allocation free, the caller feeds one temperature per tick and applies
+//  the limits it settles on.
+//
+
+#ifndef PowerController_hpp
+#define PowerController_hpp
+
+#include <stdint.h>
+
+// PL1 and PL2
+#define POWER_LIMIT_COUNT       2
+
+// Deci-Kelvin below the target before limits are raised again
+#define POWER_CONTROL_HYSTERESIS    20
+// Every this many deci-Kelvin over the target costs one more step per tick
+#define POWER_CONTROL_BAND          10
+#define POWER_CONTROL_MAX_STEPS     4
+// Rising this fast within the hysteresis already takes a step down
+#define POWER_CONTROL_RISE          5
+// Accumulated deci-Kelvin ticks over the target worth one extra step
+#define POWER_CONTROL_INTEGRAL      100
+
+struct PowerLimitRange {
+    uint32_t min_uw;
+    uint32_t max_uw;
+    uint32_t step_uw;           // 0 moves in sixteenths of the range
+};
+
+struct PowerControllerInputs {
+    uint32_t temperature;       // deci-Kelvin, 0 if unavailable
+    uint32_t target;            // deci-Kelvin, 0 to run unthrottled
+    uint32_t ceiling_uw;        // PL1 cap from the passive policy, 0 for none
+};
+
+struct PowerControllerState {
+    uint32_t limits[POWER_LIMIT_COUNT];     // uW
+    uint32_t previous;          // temperature of the last step
+    int32_t integral;           // deci-Kelvin ticks over the target
+    uint32_t ticks;
+    uint32_t changes;           // ticks that moved a limit
+};
+
+class PowerController {
+    PowerLimitRange ranges[POWER_LIMIT_COUNT] {};
+    uint32_t rangeCount {0};
+    PowerControllerState state {};
+
+    uint32_t stepSize(uint32_t i) const;
+    uint32_t quantize(uint32_t i, int64_t value) const;
+
+public:
+    /**
+     * Set the PPCC ranges. Limits start at the maximum, later calls keep them and only clamp
+     * them into the new ranges.
+     * @param ranges PL1, then PL2 if present
+     * @param count Number of ranges, 0 stops the controller
+     *
+     * @return true if a limit moved
+     */
+    bool configure(const PowerLimitRange *ranges, uint32_t count);
+
+    /**
+     * Run one control tick. Over the target PL1 drops by one step per POWER_CONTROL_BAND
+     * of error plus an integral step, below the hysteresis it recovers one step per tick.
+     * PL2 keeps the headroom PPCC gives it over PL1.
+     *
+     * @return true if a limit moved
+     */
+    bool step(const PowerControllerInputs &inputs);
+
+    uint32_t getRangeCount() const { return rangeCount; };
+    const PowerLimitRange *getRange(uint32_t i) const { return i < rangeCount ? &ranges[i] : nullptr; };
+    uint32_t getLimit(uint32_t i) const { return i < rangeCount ? state.limits[i] : 0; };
+    const PowerControllerState *getState() const { return &state; };
+};
+
+#endif /* PowerController_hpp */
@@ -25,6 +25,13 @@ bool ProcessorSolution::start(IOService *provider) {
 
     setProperty("Type", "Processor");
 
+    workLoop = IOWorkLoop::workLoop();
+    if (!workLoop || !events.init(this, workLoop, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ProcessorSolution::handleEvents))) {
+        AlwaysLog("Failed to add event queue");
+        OSSafeReleaseNULL(workLoop);
+        return false;
+    }
+
     evaluateCEUC();
     evaluateCLPO();
     evaluateTDPL();
@@ -39,6 +46,7 @@ bool ProcessorSolution::start(IOService *provider) {
             setProperty("TZ", value);
             value->release();
         }
+        publishCacheStats();
     }
 
     setProperty(kDeliverNotifications, kOSBooleanTrue);
@@ -46,6 +54,15 @@ bool ProcessorSolution::start(IOService *provider) {
     return true;
 }
 
+void ProcessorSolution::stop(IOService *provider) {
+    DebugLog("Stoping");
+
+    events.free(workLoop);
+    OSSafeReleaseNULL(workLoop);
+
+    super::stop(provider);
+}
+
 bool ProcessorSolution::evaluateCEUC() {
     OSObject *result;
     OSArray *package;
@@ -88,25 +105,35 @@ bool ProcessorSolution::evaluatePCCC() {
 
 bool ProcessorSolution::evaluatePPCC() {
     OSObject *result;
+    OSObject *value;
     OSArray *package;
+    ThermalPowerLimit limits[kThermalPowerLimitMax] {};
+    UInt32 count = 0;
     if ((adev->evaluateObject("PPCC", &result) == kIOReturnSuccess) &&
         (package = OSDynamicCast(OSArray, result))) {
         OSDictionary *power_limits = OSDictionary::withCapacity(3);
         power_limits->setObject("count", package->getObject(0));
-        for (int i=0; i < min(package->getCount(), 2); i++) {
+        for (int i=0; i < min(package->getCount() - 1, kThermalPowerLimitMax); i++) {
             OSArray *arr;
             OSNumber *index;
             if (!(arr = OSDynamicCast(OSArray, package->getObject(i+1))) ||
                 nullptr == (index = OSDynamicCast(OSNumber, arr->getObject(0))) ||
                 i != index->unsigned8BitValue())
                 continue;
+            UInt32 *fields = &limits[i].min_uw;
+            for (int j = 0; j < 5; j++) {
+                OSNumber *field = OSDynamicCast(OSNumber, arr->getObject(j+1));
+                fields[j] = field ? field->unsigned32BitValue() * PPCC_UNIT_SCALE : 0;
+            }
+            count = i + 1;
+
             OSDictionary *power_limit = OSDictionary::withCapacity(6);
             power_limit->setObject("index", arr->getObject(0));
-            power_limit->setObject("min_uw", arr->getObject(1));
-            power_limit->setObject("max_uw", arr->getObject(2));
-            power_limit->setObject("tmin_us", arr->getObject(3));
-            power_limit->setObject("tmax_us", arr->getObject(4));
-            power_limit->setObject("step_uw", arr->getObject(5));
+            setPropertyNumber(power_limit, "min_uw", limits[i].min_uw, 32);
+            setPropertyNumber(power_limit, "max_uw", limits[i].max_uw, 32);
+            setPropertyNumber(power_limit, "tmin_us", limits[i].tmin_us, 32);
+            setPropertyNumber(power_limit, "tmax_us", limits[i].tmax_us, 32);
+            setPropertyNumber(power_limit, "step_uw", limits[i].step_uw, 32);
             char name[11];
             snprintf(name, 11, "processor%1d", i);
             power_limits->setObject(name, power_limit);
@@ -116,7 +143,39 @@ bool ProcessorSolution::evaluatePPCC() {
         OSSafeReleaseNULL(power_limits);
     }
     OSSafeReleaseNULL(result);
-    return true;
+
+    seqWriteBegin(&capability.sequence);
+    capability.count = count;
+    memcpy(capability.limits, limits, sizeof(limits));
+    seqWriteEnd(&capability.sequence);
+    return count != 0;
+}
+
+void ProcessorSolution::handleEvents(IOTimerEventSource *sender) {
+    UInt32 pending = events.take();
+    if (pending & PROC_EVENT_CAPABILITY)
+        evaluatePPCC();
+    if ((pending & PROC_EVENT_CACHE) && tz)
+        publishCacheStats();
+
+    OSDictionary *stats = events.getStats();
+    setProperty("Events", stats);
+    stats->release();
+}
+
+IOReturn ProcessorSolution::setProperties(OSObject *props) {
+    OSDictionary* dict = OSDynamicCast(OSDictionary, props);
+    // The counters are only copied on request, the work loop publishes them
+    if (dict && dict->getObject("TemperatureCache") != nullptr)
+        events.post(PROC_EVENT_CACHE);
+    return kIOReturnSuccess;
+}
+
+void ProcessorSolution::publishCacheStats() {
+    OSDictionary *stats = tz->getCacheStats();
+    if (stats)
+        setProperty("TemperatureCache", stats);
+    OSSafeReleaseNULL(stats);
 }
 
 IOReturn ProcessorSolution::message(UInt32 type, IOService *provider, void *argument) {
@@ -125,20 +184,52 @@ IOReturn ProcessorSolution::message(UInt32 type, IOService *provider, void *argu
             *(reinterpret_cast<UInt32 *>(argument)) = this->type;
             break;
 
-        case kThermal_getTemperature:
-            if (this->type != INT3403_TYPE_SENSOR)
+        case kThermal_getTemperature: {
+            if (!tz)
                 break;
             UInt32 tmp;
-            if (adev->evaluateInteger("_TMP", &tmp) != kIOReturnSuccess)
+            if (tz->readTemperature(&tmp) != kIOReturnSuccess)
                 tmp = DEFAULT_TEMPERATURE;
             *(reinterpret_cast<UInt32 *>(argument)) = tmp;
             break;
+        }
+
+        case kThermal_getSubscriptions:
+            *(reinterpret_cast<UInt32 *>(argument)) = kThermalClassNotification | kThermalClassPower | kThermalClassPolicy;
+            break;
+
+        case kThermal_getSamplingPeriod:
+            if (tz)
+                *(reinterpret_cast<UInt32 *>(argument)) = tz->getSamplingPeriod();
+            break;
+
+        case kThermal_getPowerCapability:
+            *(reinterpret_cast<const ThermalPowerCapability **>(argument)) = &capability;
+            break;
+
+        case kThermal_setPowerLimits: {
+            const ThermalPowerLimits *limits = reinterpret_cast<const ThermalPowerLimits *>(argument);
+            if (!limits || limits->count > kThermalPowerLimitMax)
+                return kIOReturnBadArgument;
+            requested = *limits;
+            OSArray *arr = OSArray::withCapacity(limits->count);
+            for (UInt32 i = 0; i < limits->count; i++) {
+                OSNumber *limit = OSNumber::withNumber(limits->limit_uw[i], 32);
+                arr->setObject(limit);
+                OSSafeReleaseNULL(limit);
+            }
+            setProperty("PowerLimits", arr);
+            arr->release();
+            DebugLog("Power limits %d %d uW", limits->limit_uw[0], limits->limit_uw[1]);
+            break;
+        }
 
         case kIOACPIMessageDeviceNotification:
             if (argument) {
                 switch (*(UInt32 *) argument) {
                     case PROC_POWER_CAPABILITY_CHANGED:
                         AlwaysLog("ACPI notification: processor power capability changed");
+                        events.post(PROC_EVENT_CAPABILITY);
                         break;
 
                     default:
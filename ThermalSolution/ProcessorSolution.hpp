@@ -14,6 +14,7 @@
 #include <IOKit/pci/IOPCIDevice.h>
 #include <IOKit/IOService.h>
 #include "common.h"
+#include "EventQueue.hpp"
 #include "ThermalZone.hpp"
 
 // from linux/drivers/thermal/intel/int340x_thermal/processor_thermal_device.c
@@ -21,10 +22,15 @@
 #define DEFAULT_TEMPERATURE         0x0BB8
 #define PROC_POWER_CAPABILITY_CHANGED    0x83
 
+#define PROC_EVENT_CAPABILITY       BIT(0)
+#define PROC_EVENT_CACHE            BIT(1)
+
 class ProcessorSolution : public IOService {
     typedef IOService super;
     OSDeclareDefaultStructors(ProcessorSolution)
 
+    IOWorkLoop *workLoop {nullptr};
+
     const char *name;
     IOPCIDevice *dev {nullptr};
     IOACPIPlatformDevice *adev {nullptr};
@@ -37,11 +43,23 @@ class ProcessorSolution : public IOService {
     bool evaluatePCCC();
     bool evaluatePPCC();
 
+    // Read by power consumers without a call, rewritten on the work loop only
+    ThermalPowerCapability capability {};
+    // Last PL1/PL2 asked for by the power controller
+    ThermalPowerLimits requested {};
+
     ThermalZone *tz {nullptr};
 
+    // Deferred work for ACPI notifications
+    EventQueue events;
+    void handleEvents(IOTimerEventSource *sender);
+    void publishCacheStats();
+
 public:
     bool start(IOService *provider) APPLE_KEXT_OVERRIDE;
+    void stop(IOService *provider) APPLE_KEXT_OVERRIDE;
 
     IOReturn message(UInt32 type, IOService *provider, void *argument) APPLE_KEXT_OVERRIDE;
+    IOReturn setProperties(OSObject *props) APPLE_KEXT_OVERRIDE;
 };
 #endif /* ProcessorSolution_hpp */
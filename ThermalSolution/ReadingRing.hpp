@@ -0,0 +1,100 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ReadingRing.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Recent samples of one participant. The sampler appends without locks and
+//  any thread can copy the last samples out, dropping the ones overwritten
+//  while it was copying. Kernel-agnostic, so the host build can check it.
+//
+
+#ifndef ReadingRing_hpp
+#define ReadingRing_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef KERNEL
+#include "common.h"
+#else
+// As in common.h, which needs IOKit
+struct ThermalSample {
+    uint32_t time;
+    uint32_t temperature;
+};
+#endif
+
+#define READING_RING_CACHE_LINE 64
+// Power of two, 6.4 s of history at the 100 ms sampling tick
+#define READING_RING_SIZE       64
+
+class ReadingRing {
+    // Only the sampler writes the cursors, keep them off the lines readers copy. Zero filled
+    // memory is an empty ring.
+    volatile uint32_t head;
+    // head + 1 while a slot is being overwritten, head otherwise
+    volatile uint32_t claimed;
+    uint8_t pad[READING_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+    // Uptime in ms in the high half, deci-Kelvin in the low half, stored as one word
+    uint64_t samples[READING_RING_SIZE];
+
+public:
+    void reset() {
+        __atomic_store_n(&claimed, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&head, 0, __ATOMIC_RELEASE);
+    };
+
+    /**
+     * Append a sample, only ever called from one thread
+     * @param time Uptime in ms, truncated
+     * @param temperature Deci-Kelvin
+     */
+    void push(uint32_t time, uint32_t temperature) {
+        uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        // A reader that sees the new sample also sees the claim
+        __atomic_store_n(&claimed, h + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&samples[h & (READING_RING_SIZE - 1)], ((uint64_t)time << 32) | temperature, __ATOMIC_RELAXED);
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+    };
+
+    /**
+     * Copy the most recent samples, oldest first
+     * @param out Room for n samples
+     * @param n Samples wanted
+     *
+     * @return Number of samples copied
+     */
+    uint32_t readLast(ThermalSample *out, uint32_t n) const {
+        uint32_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        uint32_t avail = end < READING_RING_SIZE ? end : READING_RING_SIZE;
+        if (n > avail)
+            n = avail;
+        uint32_t start = end - n;
+
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t entry = __atomic_load_n(&samples[(start + i) & (READING_RING_SIZE - 1)], __ATOMIC_RELAXED);
+            out[i].time = (uint32_t)(entry >> 32);
+            out[i].temperature = (uint32_t)entry;
+        }
+
+        // Only slots claimed since the copy started may hold a newer sample
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t lost = __atomic_load_n(&claimed, __ATOMIC_RELAXED) - end;
+        uint32_t oldest = end - READING_RING_SIZE + lost;
+        if ((int32_t)(start - oldest) >= 0)
+            return n;
+        uint32_t drop = oldest - start;
+        if (drop >= n)
+            return 0;
+        memmove(out, out + drop, (n - drop) * sizeof(ThermalSample));
+        return n - drop;
+    };
+};
+
+static_assert(sizeof(ReadingRing) % READING_RING_CACHE_LINE == 0, "rings in an array must stay aligned");
+
+#endif /* ReadingRing_hpp */
@@ -13,50 +13,15 @@ OSDefineMetaClassAndStructors(SensorSolution, IOService)
 
 OSString *parse_string(OSData *data) {
   uint32_t size = data->getLength();
-  const uint16_t *buf2 = reinterpret_cast<const uint16_t *>(data->getBytesNoCopy());
   if (size % 2 != 0) {
 //    errors("invalid size");
     return OSString::withCString("invalid size");
   }
-  char *out = reinterpret_cast<char *>(IOMalloc(size+1));
-  if (!out) {
+  OSString *ret = utf16leString(data->getBytesNoCopy(), size);
+  if (!ret) {
 //    errors("malloc failed");
     return OSString::withCString("malloc failed");
   }
-  bzero(out, size+1);
-
-  uint32_t i, j;
-  for (i=0, j=0; i<size/2; ++i) {
-    if (buf2[i] == 0) {
-      break;
-    } else if (buf2[i] < 0x80) {
-      out[j++] = buf2[i];
-    } else if (buf2[i] < 0x800) {
-      out[j++] = 0xC0 | (buf2[i] >> 6);
-      out[j++] = 0x80 | (buf2[i] & 0x3F);
-    } else if (buf2[i] >= 0xD800 && buf2[i] <= 0xDBFF && i+1 < size/2 && buf2[i+1] >= 0xDC00 && buf2[i+1] <= 0xDFFF) {
-      uint32_t c = 0x10000 + ((buf2[i] - 0xD800) << 10) + (buf2[i+1] - 0xDC00);
-      ++i;
-      out[j++] = 0xF0 | (c >> 18);
-      out[j++] = 0x80 | ((c >> 12) & 0x3F);
-      out[j++] = 0x80 | ((c >> 6) & 0x3F);
-      out[j++] = 0x80 | (c & 0x3F);
-    } else if (buf2[i] >= 0xD800 && buf2[i] <= 0xDBFF && i+1 < size/2 && buf2[i+1] >= 0xDC00 && buf2[i+1] <= 0xDFFF) {
-      uint32_t c = 0x10000 + ((buf2[i] - 0xD800) << 10) + (buf2[i+1] - 0xDC00);
-      ++i;
-      out[j++] = 0xF0 | (c >> 18);
-      out[j++] = 0x80 | ((c >> 12) & 0x3F);
-      out[j++] = 0x80 | ((c >> 6) & 0x3F);
-      out[j++] = 0x80 | (c & 0x3F);
-    } else {
-      out[j++] = 0xE0 | (buf2[i] >> 12);
-      out[j++] = 0x80 | ((buf2[i] >> 6) & 0x3F);
-      out[j++] = 0x80 | (buf2[i] & 0x3F);
-    }
-  }
-  out[j] = 0;
-  OSString *ret = OSString::withCString(out);
-  IOFree(out, size+1);
   return ret;
 }
 
@@ -74,6 +39,11 @@ bool SensorSolution::start(IOService *provider) {
         return false;
     }
 
+    if (!events.init(this, workLoop, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SensorSolution::handleEvents))) {
+        AlwaysLog("Failed to add event queue");
+        return false;
+    }
+
     OSObject *raw;
     OSData *data;
     if (dev->evaluateObject("_STR", &raw) == kIOReturnSuccess) {
@@ -89,6 +59,7 @@ bool SensorSolution::start(IOService *provider) {
         OSSafeReleaseNULL(raw);
     }
 
+    UInt32 tmp;
     if (dev->evaluateInteger("_TMP", &tmp) == kIOReturnSuccess) {
         type = INT3403_TYPE_SENSOR;
     } else if (dev->evaluateInteger("PTYP", &type) != kIOReturnSuccess) {
@@ -122,6 +93,7 @@ bool SensorSolution::start(IOService *provider) {
             setProperty("TZ", value);
             value->release();
         }
+        publishCacheStats();
     }
     setProperty(kDeliverNotifications, kOSBooleanTrue);
     registerService();
@@ -131,6 +103,7 @@ bool SensorSolution::start(IOService *provider) {
 void SensorSolution::stop(IOService *provider) {
     DebugLog("Stoping");
 
+    events.free(workLoop);
     workLoop->removeEventSource(commandGate);
     OSSafeReleaseNULL(commandGate);
     OSSafeReleaseNULL(workLoop);
@@ -145,13 +118,38 @@ IOReturn SensorSolution::message(UInt32 type, IOService *provider, void *argumen
             *(reinterpret_cast<UInt32 *>(argument)) = this->type;
             break;
 
-        case kThermal_getTemperature:
-            if (this->type != INT3403_TYPE_SENSOR)
+        case kThermal_getTemperature: {
+            if (this->type != INT3403_TYPE_SENSOR || !tz)
                 break;
-            if (dev->evaluateInteger("_TMP", &tmp) != kIOReturnSuccess)
+            // Readers are not serialized, only the crossing they detect goes through the gate
+            UInt32 tmp;
+            struct trip_crossing crossing;
+            if (tz->readTemperature(&tmp) != kIOReturnSuccess)
                 tmp = DEFAULT_TEMPERATURE;
+            else if (tz->updateTrips(tmp, &crossing))
+                commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SensorSolution::postCrossingGated), &crossing);
             *(reinterpret_cast<UInt32 *>(argument)) = tmp;
             break;
+        }
+
+        case kThermal_getSubscriptions:
+            *(reinterpret_cast<UInt32 *>(argument)) = kThermalClassNotification | kThermalClassTemperature;
+            break;
+
+        case kThermal_getSamplingPeriod:
+            if (tz)
+                *(reinterpret_cast<UInt32 *>(argument)) = tz->getSamplingPeriod();
+            break;
+
+        case kThermal_setAuxTrips:
+            if (tz && argument)
+                commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SensorSolution::setAuxTripsGated), argument);
+            break;
+
+        case kThermal_getActiveTrips:
+            if (tz && argument)
+                commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SensorSolution::getActiveTripsGated), argument);
+            break;
 
         case kIOACPIMessageDeviceNotification:
             if (argument) {
@@ -162,10 +160,12 @@ IOReturn SensorSolution::message(UInt32 type, IOService *provider, void *argumen
 
                     case INT3403_PERF_TRIP_POINT_CHANGED:
                         AlwaysLog("ACPI notification: performance trip point changed");
+                        events.post(SENSOR_EVENT_TRIP_POINTS);
                         break;
 
                     case INT3403_THERMAL_EVENT:
                         DebugLog("ACPI notification: thermal event");
+                        events.post(SENSOR_EVENT_THERMAL);
                         break;
 
                     default:
@@ -186,6 +186,99 @@ IOReturn SensorSolution::message(UInt32 type, IOService *provider, void *argumen
     return kIOReturnSuccess;
 }
 
+void SensorSolution::handleEvents(IOTimerEventSource *sender) {
+    UInt32 pending = events.take();
+    if (!tz)
+        return;
+
+    if (pending & SENSOR_EVENT_TRIP_POINTS) {
+        OSDictionary *value = tz->readTrips();
+        if (value) {
+            setProperty("TZ", value);
+            value->release();
+        }
+    }
+
+    // A trip was crossed, later reads must not be served from before the event
+    if (pending & SENSOR_EVENT_THERMAL) {
+        UInt32 tmp;
+        tz->invalidate();
+        if (tz->readTemperature(&tmp) == kIOReturnSuccess) {
+            DebugLog("Thermal event, _TMP %d", tmp);
+            // The reading left the window, move it so the next event comes from firmware too
+            if (auxWindow)
+                programWindow(tmp);
+        }
+    } else if ((pending & SENSOR_EVENT_TRIP_POINTS) && auxWindow) {
+        UInt32 tmp;
+        if (tz->readTemperature(&tmp) == kIOReturnSuccess)
+            programWindow(tmp);
+    }
+
+    if (pending & SENSOR_EVENT_CROSSING) {
+        OSDictionary *desc = OSDictionary::withCapacity(4);
+        OSObject *value;
+        setPropertyNumber(desc, "Band", crossing.to, 32);
+        setPropertyNumber(desc, "Trip", crossing.trip.id, 32);
+        setPropertyNumber(desc, "Type", crossing.trip.type, 32);
+        setPropertyTemp(desc, "Temperature", acpi_deci_kelvin_to_deci_celsius(crossing.temp));
+        setProperty("TripBand", desc);
+        desc->release();
+        DebugLog("Trip band %d -> %d at %d", crossing.from, crossing.to, crossing.temp);
+    }
+
+    OSDictionary *stats = events.getStats();
+    setProperty("Events", stats);
+    stats->release();
+}
+
+void SensorSolution::postCrossingGated(struct trip_crossing *crossing) {
+    this->crossing = *crossing;
+    events.post(SENSOR_EVENT_CROSSING);
+}
+
+void SensorSolution::getActiveTripsGated(ThermalActiveTrips *trips) {
+    trips->count = tz->getActiveTrips(trips->temps);
+    trips->hysteresis = tz->getTripHyst(0);
+}
+
+void SensorSolution::setAuxTripsGated(ThermalAuxTrips *trips) {
+    UInt32 mask = trips->mask;
+    while (mask) {
+        UInt32 trip = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (!tz->setTripTemp(trip, trips->temps[trip]))
+            DebugLog("Aux trip %d is not programmable", trip);
+    }
+    trips->written = tz->commitTrips();
+    auxWrites += trips->written;
+    publishAuxTrips();
+}
+
+void SensorSolution::programWindow(UInt32 temp) {
+    if (tz->getAuxTripCount() < 2) {
+        AlwaysLog("Aux trip window needs PAT0 and PAT1");
+        auxWindow = 0;
+        return;
+    }
+
+    ThermalAuxTrips trips {};
+    trips.mask = BIT(0) | BIT(1);
+    trips.temps[0] = temp > auxWindow ? temp - auxWindow : 1;
+    trips.temps[1] = temp + auxWindow;
+    setAuxTripsGated(&trips);
+    DebugLog("Aux trip window %d - %d, %d written", trips.temps[0], trips.temps[1], trips.written);
+}
+
+void SensorSolution::publishAuxTrips() {
+    OSDictionary *desc = OSDictionary::withCapacity(2);
+    OSObject *value;
+    setPropertyNumber(desc, "Window", auxWindow, 32);
+    setPropertyNumber(desc, "Writes", auxWrites, 32);
+    setProperty("AuxTripState", desc);
+    desc->release();
+}
+
 IOReturn SensorSolution::setProperties(OSObject *props) {
     commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SensorSolution::setPropertiesGated), props);
     return kIOReturnSuccess;
@@ -196,7 +289,35 @@ void SensorSolution::setPropertiesGated(OSObject* props) {
     if (!dict)
         return;
 
+    // Max age of cached _TMP readings in ms, 0 to always evaluate
+    OSNumber *maxAge = OSDynamicCast(OSNumber, dict->getObject("TemperatureMaxAge"));
+    if (maxAge && tz)
+        tz->setMaxAge(maxAge->unsigned32BitValue());
+
+    // Aux trips in deci-Kelvin from PAT0 on, all written in one pass
+    OSArray *auxTrips = OSDynamicCast(OSArray, dict->getObject("AuxTrips"));
+    if (auxTrips && tz) {
+        ThermalAuxTrips trips {};
+        for (UInt32 i = 0; i < auxTrips->getCount() && i < kThermalAuxTripMax; i++) {
+            OSNumber *temp = OSDynamicCast(OSNumber, auxTrips->getObject(i));
+            if (!temp)
+                continue;
+            trips.mask |= BIT(i);
+            trips.temps[i] = temp->unsigned32BitValue();
+        }
+        setAuxTripsGated(&trips);
+    }
+
+    OSNumber *window = OSDynamicCast(OSNumber, dict->getObject("AuxTripWindow"));
+    if (window && tz) {
+        UInt32 tmp;
+        auxWindow = window->unsigned32BitValue();
+        if (auxWindow && tz->readTemperature(&tmp) == kIOReturnSuccess)
+            programWindow(tmp);
+    }
+
     if (dict->getObject("update") != nullptr) {
+        UInt32 tmp;
         if (dev->evaluateInteger("_TMP", &tmp) == kIOReturnSuccess) {
             setProperty("_TMP", tmp, 32);
             DebugLog("Evaluated _TMP %d %d", tmp, (tmp - 2732) / 10);
@@ -204,4 +325,14 @@ void SensorSolution::setPropertiesGated(OSObject* props) {
             AlwaysLog("Failed to evaluate tmp");
         }
     }
+
+    if (tz)
+        publishCacheStats();
+}
+
+void SensorSolution::publishCacheStats() {
+    OSDictionary *stats = tz->getCacheStats();
+    if (stats)
+        setProperty("TemperatureCache", stats);
+    OSSafeReleaseNULL(stats);
 }
@@ -14,7 +14,9 @@
 #include <IOKit/IOCommandGate.h>
 #include <IOKit/IOService.h>
 #include "common.h"
+#include "EventQueue.hpp"
 #include "ThermalZone.hpp"
+#include "UTF16.hpp"
 
 // from linux/drivers/thermal/intel/int340x_thermal/int3403_thermal.c
 
@@ -23,6 +25,10 @@
 #define INT3403_THERMAL_EVENT             0x90
 #define INT3403_TEMPERATURE_INDICATION    0x91
 
+#define SENSOR_EVENT_THERMAL        BIT(0)
+#define SENSOR_EVENT_TRIP_POINTS    BIT(1)
+#define SENSOR_EVENT_CROSSING       BIT(2)
+
 #define DEFAULT_TEMPERATURE         0x0BB8
 
 class SensorSolution : public IOService {
@@ -35,11 +41,26 @@ class SensorSolution : public IOService {
     const char *name;
     IOACPIPlatformDevice *dev {nullptr};
 
-    UInt32 tmp {DEFAULT_TEMPERATURE};
     UInt32 type {0};
 
     ThermalZone *tz {nullptr};
 
+    // Deferred work for ACPI notifications
+    EventQueue events;
+    void handleEvents(IOTimerEventSource *sender);
+    void publishCacheStats();
+    // Last crossing, only touched under the gate
+    struct trip_crossing crossing {};
+    void postCrossingGated(struct trip_crossing *crossing);
+
+    // Half width of the PAT0/PAT1 window around the last reading in deci-Kelvin, 0 leaves aux trips alone
+    UInt32 auxWindow {0};
+    UInt32 auxWrites {0};
+    void setAuxTripsGated(ThermalAuxTrips *trips);
+    void getActiveTripsGated(ThermalActiveTrips *trips);
+    void programWindow(UInt32 temp);
+    void publishAuxTrips();
+
     void setPropertiesGated(OSObject* props);
 
 public:
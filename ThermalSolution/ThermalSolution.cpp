@@ -8,9 +8,9 @@
 //
 
 #include "ThermalSolution.hpp"
-#include "thd_lzma_dec.h"
 
 OSDefineMetaClassAndStructors(ThermalSolution, IOService)
+OSDefineMetaClassAndStructors(ThermalConsumers, OSObject)
 
 OSString *parseDeciKelvin(uint32_t raw) {
     char temp_str[10];
@@ -36,6 +36,66 @@ bool ThermalSolution::start(IOService *provider) {
         return false;
     }
 
+    if (!events.init(this, workLoop, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ThermalSolution::handleEvents))) {
+        AlwaysLog("Failed to add event queue");
+        return false;
+    }
+
+    wheelTimer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ThermalSolution::tickWheel));
+    if (!wheelTimer || (workLoop->addEventSource(wheelTimer) != kIOReturnSuccess) ||
+        !wheel.init(uptimeMS() / THERMAL_WHEEL_TICK_MS, THERMAL_PARTICIPANT_MAX)) {
+        AlwaysLog("Failed to add wheelTimer");
+        return false;
+    }
+
+    rings = static_cast<ReadingRing *>(IOMallocAligned(sizeof(ReadingRing) * THERMAL_PARTICIPANT_MAX, READING_RING_CACHE_LINE));
+    if (!rings) {
+        AlwaysLog("Failed to allocate history");
+        return false;
+    }
+    bzero(rings, sizeof(ReadingRing) * THERMAL_PARTICIPANT_MAX);
+
+    coolers = new ActivePolicy[THERMAL_PARTICIPANT_MAX];
+    if (!coolers) {
+        AlwaysLog("Failed to allocate active cooling");
+        return false;
+    }
+
+    telemetryBuffer = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(thermal_telemetry), PAGE_SIZE);
+    if (!telemetryBuffer) {
+        AlwaysLog("Failed to allocate telemetry");
+        return false;
+    }
+    telemetry = static_cast<thermal_telemetry *>(telemetryBuffer->getBytesNoCopy());
+    bzero(telemetry, sizeof(thermal_telemetry));
+    telemetry->version = THERMAL_TELEMETRY_VERSION;
+    telemetry->size = sizeof(thermal_telemetry);
+
+    if (!initOSC()) {
+        AlwaysLog("Failed to allocate _OSC arguments");
+        return false;
+    }
+
+    /* Missing IDSP isn't fatal */
+    evaluateAvailableMode();
+    // The wheel timer is already live on the work loop
+    commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ThermalSolution::evaluateTablesGated));
+
+    UInt32 tmp;
+    if (dev->evaluateInteger("_TMP", &tmp) == kIOReturnSuccess) {
+        tz = new ThermalZone(dev);
+        OSDictionary *value = tz->readTrips();
+        if (value) {
+            setProperty("TZ", value);
+            value->release();
+        }
+        // Nothing reads this zone through the cache yet, the stats only show its max age
+        value = tz->getCacheStats();
+        if (value)
+            setProperty("TemperatureCache", value);
+        OSSafeReleaseNULL(value);
+    }
+
     _deliverNotification = OSSymbol::withCString(kDeliverNotifications);
     _notificationServices = OSSet::withCapacity(1);
     OSDictionary * propertyMatch = propertyMatching(_deliverNotification, kOSBooleanTrue);
@@ -43,7 +103,8 @@ bool ThermalSolution::start(IOService *provider) {
       IOServiceMatchingNotificationHandler notificationHandler = OSMemberFunctionCast(IOServiceMatchingNotificationHandler, this, &ThermalSolution::notificationHandler);
 
       //
-      // Register notifications for availability of any IOService objects wanting to consume our message events
+      // Register notifications for availability of any IOService objects wanting to consume our message events.
+      // Consumers already published are delivered right away, so everything they touch has to be set up.
       //
       _publishNotify = addMatchingNotification(gIOFirstPublishNotification,
                                              propertyMatch,
@@ -60,21 +121,6 @@ bool ThermalSolution::start(IOService *provider) {
       propertyMatch->release();
     }
 
-    /* Missing IDSP isn't fatal */
-    evaluateAvailableMode();
-    evaluateGDDV();
-    evaluateODVP();
-
-    UInt32 tmp;
-    if (dev->evaluateInteger("_TMP", &tmp) == kIOReturnSuccess) {
-        tz = new ThermalZone(dev);
-        OSDictionary *value = tz->readTrips();
-        if (value) {
-            setProperty("TZ", value);
-            value->release();
-        }
-    }
-
     registerService();
     return true;
 }
@@ -86,8 +132,30 @@ void ThermalSolution::stop(IOService *provider) {
     _terminateNotify->remove();
     _notificationServices->flushCollection();
     OSSafeReleaseNULL(_notificationServices);
+    publishConsumers();
     OSSafeReleaseNULL(_deliverNotification);
 
+    events.free(workLoop);
+    wheelTimer->cancelTimeout();
+    workLoop->removeEventSource(wheelTimer);
+    OSSafeReleaseNULL(wheelTimer);
+    wheel.release();
+    releasePassive();
+    releaseVirtual();
+    releaseOSC();
+    if (rings)
+        IOFreeAligned(rings, sizeof(ReadingRing) * THERMAL_PARTICIPANT_MAX);
+    rings = nullptr;
+    if (coolers)
+        delete [] coolers;
+    coolers = nullptr;
+    telemetry = nullptr;
+    OSSafeReleaseNULL(telemetryBuffer);
+
+    adaptive.release();
+    gddvCache.release();
+    OSSafeReleaseNULL(gddv);
+
     workLoop->removeEventSource(commandGate);
     OSSafeReleaseNULL(commandGate);
     OSSafeReleaseNULL(workLoop);
@@ -96,6 +164,22 @@ void ThermalSolution::stop(IOService *provider) {
     super::stop(provider);
 }
 
+static int findMode(const int3400_guid *guid) {
+    for (int i = 0; i < INT3400_THERMAL_MAXIMUM_UUID; i++)
+        if (guid->lo == int3400_thermal_guids[i].lo && guid->hi == int3400_thermal_guids[i].hi)
+            return i;
+    return -1;
+}
+
+static void guidToUUID(const int3400_guid *guid, uuid_t uuid) {
+    memcpy(uuid, guid, sizeof(uuid_t));
+
+    // convert from mixed-endian
+    *(reinterpret_cast<uint32_t *>(uuid)) = OSSwapInt32(*(reinterpret_cast<uint32_t *>(uuid)));
+    *(reinterpret_cast<uint16_t *>(uuid) + 2) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(uuid) + 2));
+    *(reinterpret_cast<uint16_t *>(uuid) + 3) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(uuid) + 3));
+}
+
 bool ThermalSolution::evaluateAvailableMode() {
     OSObject *result = nullptr;
     if (dev->evaluateObject("IDSP", &result) != kIOReturnSuccess) {
@@ -104,78 +188,42 @@ bool ThermalSolution::evaluateAvailableMode() {
     }
 
     OSArray *uuid = OSDynamicCast(OSArray, result);
-    OSDictionary *mode = OSDictionary::withCapacity(1);
-    OSString *value;
     OSData *entry;
+    int3400_guid unknown[INT3400_UNKNOWN_UUID_MAX];
+    uint32_t unknownCount = 0;
 
-    for (int i = 0; i < uuid->getCount(); i++) {
-        if (!(entry = OSDynamicCast(OSData, uuid->getObject(i))) || !(entry->getBytesNoCopy()))
+    uuid_bitmap = 0;
+    for (int i = 0; uuid && i < uuid->getCount(); i++) {
+        if (!(entry = OSDynamicCast(OSData, uuid->getObject(i))) || entry->getLength() < sizeof(int3400_guid) ||
+            !(entry->getBytesNoCopy()))
             break;
-        uuid_t guid;
-        memcpy(guid, entry->getBytesNoCopy(), sizeof(uuid_t));
-        if (!uuid_is_null(guid)) {
-            *(reinterpret_cast<uint32_t *>(guid)) = OSSwapInt32(*(reinterpret_cast<uint32_t *>(guid)));
-            *(reinterpret_cast<uint16_t *>(guid) + 2) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(guid) + 2));
-            *(reinterpret_cast<uint16_t *>(guid) + 3) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(guid) + 3));
-            char guid_string[37];
-            uuid_unparse_upper(guid, guid_string);
-            setPropertyString(mode, guid_string, "Unknown");
-        }
+        int3400_guid guid;
+        memcpy(&guid, entry->getBytesNoCopy(), sizeof(int3400_guid));
+        if (!guid.lo && !guid.hi)
+            continue;
+        int mode = findMode(&guid);
+        if (mode >= 0)
+            uuid_bitmap |= BIT(mode);
+        else if (unknownCount < INT3400_UNKNOWN_UUID_MAX)
+            unknown[unknownCount++] = guid;
     }
+    OSSafeReleaseNULL(result);
 
-    for (int i = 0; i < INT3400_THERMAL_MAXIMUM_UUID; i++) {
-        if ((mode->getObject(int3400_thermal_uuids[i]))) {
-            uuid_bitmap |= BIT(i);
-            switch (i) {
-                case INT3400_THERMAL_PASSIVE_1:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_PASSIVE_1");
-                    break;
-
-                case INT3400_THERMAL_ACTIVE:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_ACTIVE");
-                    break;
-
-                case INT3400_THERMAL_CRITICAL:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_CRITICAL");
-                    break;
-
-                case INT3400_THERMAL_ADAPTIVE_PERFORMANCE:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_ADAPTIVE_PERFORMANCE");
-                    break;
-
-                case INT3400_THERMAL_EMERGENCY_CALL_MODE:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_EMERGENCY_CALL_MODE");
-                    break;
-
-                case INT3400_THERMAL_PASSIVE_2:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_PASSIVE_2");
-                    break;
-
-                case INT3400_THERMAL_POWER_BOSS:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_POWER_BOSS");
-                    break;
-
-                case INT3400_THERMAL_VIRTUAL_SENSOR:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_VIRTUAL_SENSOR");
-                    break;
-
-                case INT3400_THERMAL_COOLING_MODE:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_COOLING_MODE");
-                    break;
-
-                case INT3400_THERMAL_HARDWARE_DUTY_CYCLING:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_HARDWARE_DUTY_CYCLING");
-                    break;
-
-                case INT3400_THERMAL_ACTIVE_2:
-                    setPropertyString(mode, int3400_thermal_uuids[i], "INT3400_THERMAL_ACTIVE_2");
-                    break;
-            }
-        }
+    // Strings only from here on, for the registry
+    OSDictionary *mode = OSDictionary::withCapacity(1);
+    OSString *value;
+    for (int i = 0; i < INT3400_THERMAL_MAXIMUM_UUID; i++)
+        if (uuid_bitmap & BIT(i))
+            setPropertyString(mode, int3400_thermal_uuids[i], int3400_thermal_names[i]);
+    for (uint32_t i = 0; i < unknownCount; i++) {
+        uuid_t guid;
+        char guid_string[37];
+        guidToUUID(&unknown[i], guid);
+        uuid_unparse_upper(guid, guid_string);
+        setPropertyString(mode, guid_string, "Unknown");
     }
     setProperty("Available Mode", mode);
     mode->release();
-    OSSafeReleaseNULL(result);
     return true;
 }
 
@@ -188,7 +236,7 @@ OSDictionary *ThermalSolution::parsePath(OSDictionary *entry, const char *&path)
         }
         x++;
     }
-    char *dictname = new char[x];
+    char *dictname = new char[x + 1];
     strncpy(dictname, path, x);
     dictname[x] = '\0';
     OSDictionary *subentry = OSDynamicCast(OSDictionary, entry->getObject(dictname));
@@ -206,47 +254,28 @@ OSDictionary *ThermalSolution::parseAPAT(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    const uint64Container *version = reinterpret_cast<const uint64Container *>(data);
-    setPropertyNumber(ret, "version", version->value, 64);
-    if (version->type != ESIF_DATA_UINT64 || version->value != 2)
+    DataVaultCursor cursor(data, length);
+    uint64_t version = 0;
+    bool valid = readTableVersion(cursor, &version);
+    setPropertyNumber(ret, "version", version, 64);
+    if (!valid || version != 2)
         return ret;
 
-    const char* offset = reinterpret_cast<const char *>(data);
-    offset += sizeof(uint64Container);
     OSArray *arr = OSArray::withCapacity(1);
-    while (offset < reinterpret_cast<const char *>(data) + length) {
-        OSDictionary *entry = OSDictionary::withCapacity(1);
-        const uint64Container *content = reinterpret_cast<const uint64Container *>(offset);
-        setPropertyNumber(entry, "target_id", content->value, 64);
-        offset += sizeof(uint64Container);
-
-        const uint64Container *str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "name", offset);
-        offset += str->value;
-
-        str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "participant", offset);
-        offset += str->value;
-
-        content = reinterpret_cast<const uint64Container *>(offset);
-        setPropertyNumber(entry, "domain", content->value, 64);
-        offset += sizeof(uint64Container);
-
-        str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "code", offset);
-        offset += str->value;
-
-        str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "argument", offset);
-        offset += str->value;
-
+    APATEntry item;
+    while (nextAPATEntry(cursor, &item)) {
+        OSDictionary *entry = OSDictionary::withCapacity(6);
+        setPropertyNumber(entry, "target_id", item.target_id, 64);
+        setPropertyString(entry, "name", item.name);
+        setPropertyString(entry, "participant", item.participant);
+        setPropertyNumber(entry, "domain", item.domain, 64);
+        setPropertyString(entry, "code", item.code);
+        setPropertyString(entry, "argument", item.argument);
         arr->setObject(entry);
         entry->release();
     }
+    if (cursor.failed())
+        AlwaysLog("APAT truncated");
     ret->setObject("targets", arr);
     arr->release();
     return ret;
@@ -256,150 +285,72 @@ OSDictionary *ThermalSolution::parseAPCT(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    const uint64Container *version = reinterpret_cast<const uint64Container *>(data);
-    setPropertyNumber(ret, "version", version->value, 64);
-    if (version->type != ESIF_DATA_UINT64)
+    DataVaultCursor cursor(data, length);
+    uint64_t version = 0;
+    bool valid = readTableVersion(cursor, &version);
+    setPropertyNumber(ret, "version", version, 64);
+    if (!valid)
         return ret;
 
-    const char* offset = reinterpret_cast<const char *>(data);
-    offset += sizeof(uint64Container);
     OSDictionary *arr = OSDictionary::withCapacity(1);
-    switch (version->value) {
-        case 1:
-        {
-            while (offset < reinterpret_cast<const char *>(data) + length) {
-                OSArray *condition_set = OSArray::withCapacity(1);
-                const uint64Container *target = reinterpret_cast<const uint64Container *>(offset);
-                offset += sizeof(uint64Container);
-                for (int i = 0; i < 10; i++) {
-                    OSDictionary *condition = OSDictionary::withCapacity(1);
-
-                    const uint64Container *content = reinterpret_cast<const uint64Container *>(offset);
-                    if (content[0].value < ARRAY_SIZE(condition_names))
-                        setPropertyString(condition, "condition", condition_names[content[0].value]);
-                    else
-                        setPropertyNumber(condition, "condition", content[0].value, 64);
-                    if (content[1].value < ARRAY_SIZE(comp_strs))
-                        setPropertyString(condition, "condition", comp_strs[content[1].value]);
-                    else
-                        setPropertyNumber(condition, "comparison", content[1].value, 64);
-                    setPropertyNumber(condition, "argument", content[2].value, 64);
-                    offset += 3 * sizeof(uint64Container);
-
-                    if (i < 9) {
-                        switch (content[3].value) {
-                            case 1:
-                                setPropertyString(condition, "operation", "AND");
-                                break;
-
-                            case 2:
-                                setPropertyString(condition, "operation", "FOR");
-                                break;
-
-                            default:
-                                setPropertyNumber(condition, "operation", content[3].value, 64);
-                                break;
-                        }
-                        offset += sizeof(uint64Container);
-                        if (content[3].value == FOR) {
-                            setPropertyNumber(condition, "unknown2", content[4].value, 64);
-                            setPropertyNumber(condition, "time_comparison", content[5].value, 64);
-                            setPropertyNumber(condition, "time", content[6].value, 64);
-                            setPropertyNumber(condition, "unknown3", content[7].value, 64);
-                            offset += 4 * sizeof(uint64Container);
-                            i++;
-                        }
-                    }
-                    condition_set->setObject(condition);
-                    condition->release();
-                }
-                char *name = new char[10];
-                snprintf(name, 10, "target%llX", target->value);
-                arr->setObject(name, condition_set);
-                delete [] name;
-                condition_set->release();
+    uint64_t target;
+    uint32_t count;
+    while (nextAPCTTarget(cursor, version, &target, &count)) {
+        OSArray *condition_set = OSArray::withCapacity(1);
+        APCTCondition item;
+        uint32_t index = 0;
+        while (nextAPCTCondition(cursor, version, index, count, &item)) {
+            OSDictionary *condition = OSDictionary::withCapacity(1);
+
+            if (item.condition < ARRAY_SIZE(condition_names))
+                setPropertyString(condition, "condition", condition_names[item.condition]);
+            else
+                setPropertyNumber(condition, "condition", item.condition, 64);
+            if (version == 2) {
+                setPropertyString(condition, "device", item.device);
+                setPropertyNumber(condition, "unknown0", item.unknown0, 64);
             }
-            break;
-        }
+            if (item.comparison < ARRAY_SIZE(comp_strs))
+                setPropertyString(condition, "comparison", comp_strs[item.comparison]);
+            else
+                setPropertyNumber(condition, "comparison", item.comparison, 64);
+            setPropertyNumber(condition, "argument", item.argument, 64);
+
+            if (item.has_operation) {
+                switch (item.operation) {
+                    case AND:
+                        setPropertyString(condition, "operation", "AND");
+                        break;
+
+                    case FOR:
+                        setPropertyString(condition, "operation", "FOR");
+                        break;
 
-        case 2:
-        {
-            while (offset < reinterpret_cast<const char *>(data) + length) {
-                OSArray *condition_set = OSArray::withCapacity(1);
-                const uint64Container *target = reinterpret_cast<const uint64Container *>(offset);
-                offset += sizeof(uint64Container);
-                const uint64Container *count = reinterpret_cast<const uint64Container *>(offset);
-                offset += sizeof(uint64Container);
-                for (int i = 0; i < count->value; i++) {
-                    OSDictionary *condition = OSDictionary::withCapacity(1);
-
-                    const uint64Container *content = reinterpret_cast<const uint64Container *>(offset);
-                    if (content[0].value < ARRAY_SIZE(condition_names))
-                        setPropertyString(condition, "condition", condition_names[content[0].value]);
-                    else
-                        setPropertyNumber(condition, "condition", content[0].value, 64);
-                    offset += sizeof(uint64Container);
-                    const uint64Container *str = reinterpret_cast<const uint64Container *>(offset);
-                    offset += sizeof(uint64Container);
-                    setPropertyString(condition, "device", offset);
-                    offset += str->value;
-
-                    content = reinterpret_cast<const uint64Container *>(offset);
-                    setPropertyNumber(condition, "unknown0", content[0].value, 64);
-                    if (content[1].value < ARRAY_SIZE(comp_strs))
-                        setPropertyString(condition, "condition", comp_strs[content[1].value]);
-                    else
-                        setPropertyNumber(condition, "comparison", content[1].value, 64);
-                    setPropertyNumber(condition, "argument", content[2].value, 64);
-                    offset += 3 * sizeof(uint64Container);
-
-                    if (i < (count->value - 1)) {
-                        switch (content[3].value) {
-                            case 1:
-                                setPropertyString(condition, "operation", "AND");
-                                break;
-
-                            case 2:
-                                setPropertyString(condition, "operation", "FOR");
-                                break;
-
-                            default:
-                                setPropertyNumber(condition, "operation", content[3].value, 64);
-                                break;
-                        }
-                        offset += sizeof(uint64Container);
-                        if (content[3].value == FOR) {
-                            setPropertyNumber(condition, "unknown1", content[4].value, 64);
-                            offset += sizeof(uint64Container);
-                            str = reinterpret_cast<const uint64Container *>(offset);
-                            offset += sizeof(uint64Container);
-                            setPropertyString(condition, "device", offset);
-                            offset += str->value;
-
-                            content = reinterpret_cast<const uint64Container *>(offset);
-                            setPropertyNumber(condition, "unknown2", content[0].value, 64);
-                            setPropertyNumber(condition, "time_comparison", content[1].value, 64);
-                            setPropertyNumber(condition, "time", content[2].value, 64);
-                            setPropertyNumber(condition, "unknown3", content[3].value, 64);
-                            offset += 4 * sizeof(uint64Container);
-                            i++;
-                        }
-                    }
-                    condition_set->setObject(condition);
-                    condition->release();
+                    default:
+                        setPropertyNumber(condition, "operation", item.operation, 64);
+                        break;
                 }
-                char *name = new char[10];
-                snprintf(name, 10, "target%llX", target->value);
-                arr->setObject(name, condition_set);
-                delete [] name;
-                condition_set->release();
             }
-            break;
+            if (item.has_time) {
+                if (version == 2) {
+                    setPropertyNumber(condition, "unknown1", item.unknown1, 64);
+                    setPropertyString(condition, "time_device", item.time_device);
+                }
+                setPropertyNumber(condition, "unknown2", item.unknown2, 64);
+                setPropertyNumber(condition, "time_comparison", item.time_comparison, 64);
+                setPropertyNumber(condition, "time", item.time, 64);
+                setPropertyNumber(condition, "unknown3", item.unknown3, 64);
+            }
+            condition_set->setObject(condition);
+            condition->release();
         }
-
-        default:
-            break;
+        char name[24];
+        snprintf(name, sizeof(name), "target%llX", target);
+        arr->setObject(name, condition_set);
+        condition_set->release();
     }
+    if (cursor.failed())
+        AlwaysLog("APCT truncated");
     ret->setObject("conditions", arr);
     arr->release();
     return ret;
@@ -409,41 +360,30 @@ OSDictionary *ThermalSolution::parseAPPC(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    const uint64Container *version = reinterpret_cast<const uint64Container *>(data);
-    setPropertyNumber(ret, "version", version->value, 64);
-    if (version->type != ESIF_DATA_UINT64 || version->value != 1)
+    DataVaultCursor cursor(data, length);
+    uint64_t version = 0;
+    bool valid = readTableVersion(cursor, &version);
+    setPropertyNumber(ret, "version", version, 64);
+    if (!valid || version != 1)
         return ret;
 
-    const char* offset = reinterpret_cast<const char *>(data);
-    offset += sizeof(uint64Container);
     OSArray *arr = OSArray::withCapacity(1);
-    while (offset < reinterpret_cast<const char *>(data) + length) {
-        OSDictionary *entry = OSDictionary::withCapacity(1);
-        const uint64Container *content = reinterpret_cast<const uint64Container *>(offset);
-        if (content[0].value < ARRAY_SIZE(condition_names))
-            setPropertyString(entry, "condition", condition_names[content[0].value]);
+    APPCEntry item;
+    while (nextAPPCEntry(cursor, &item)) {
+        OSDictionary *entry = OSDictionary::withCapacity(5);
+        if (item.condition < ARRAY_SIZE(condition_names))
+            setPropertyString(entry, "condition", condition_names[item.condition]);
         else
-            setPropertyNumber(entry, "condition", content[0].value, 64);
-        offset += sizeof(uint64Container);
-
-        const uint64Container *str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "name", offset);
-        offset += str->value;
-
-        str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "participant", offset);
-        offset += str->value;
-
-        content = reinterpret_cast<const uint64Container *>(offset);
-        setPropertyNumber(entry, "domain", content[0].value, 64);
-        setPropertyNumber(entry, "type", content[1].value, 64);
-        offset += 2 * sizeof(uint64Container);
-
+            setPropertyNumber(entry, "condition", item.condition, 64);
+        setPropertyString(entry, "name", item.name);
+        setPropertyString(entry, "participant", item.participant);
+        setPropertyNumber(entry, "domain", item.domain, 64);
+        setPropertyNumber(entry, "type", item.type, 64);
         arr->setObject(entry);
         entry->release();
     }
+    if (cursor.failed())
+        AlwaysLog("APPC truncated");
     ret->setObject("custom_conditions", arr);
     arr->release();
     return ret;
@@ -454,17 +394,22 @@ OSDictionary *ThermalSolution::parsePPCC(const void *data, uint32_t length) {
     OSObject *value;
     char iname[10];
 
-    const uint64Container *content = reinterpret_cast<const uint64Container *>(data);
-    setPropertyNumber(ret, "version", content[0].value, 64);
-    setPropertyNumber(ret, "unknown1", content[1].value, 64);
-    setPropertyNumber(ret, "power_limit_min", content[2].value, 64);
-    setPropertyNumber(ret, "power_limit_max", content[3].value, 64);
-    setPropertyNumber(ret, "time_wind_min", content[4].value, 64);
-    setPropertyNumber(ret, "time_wind_max", content[5].value, 64);
-    setPropertyNumber(ret, "step_size", content[6].value, 64);
-    for (int i = 7; i < length / sizeof(uint64Container); i++) {
-        snprintf(iname, 10, "unknown%02X", i);
-        setPropertyNumber(ret, iname, content[i].value, 64);
+    PPCCTable table;
+    if (!readPPCC(data, length, &table)) {
+        AlwaysLog("PPCC truncated");
+        return ret;
+    }
+
+    setPropertyNumber(ret, "version", table.version, 64);
+    setPropertyNumber(ret, "unknown1", table.unknown1, 64);
+    setPropertyNumber(ret, "power_limit_min", table.power_limit_min, 64);
+    setPropertyNumber(ret, "power_limit_max", table.power_limit_max, 64);
+    setPropertyNumber(ret, "time_wind_min", table.time_wind_min, 64);
+    setPropertyNumber(ret, "time_wind_max", table.time_wind_max, 64);
+    setPropertyNumber(ret, "step_size", table.step_size, 64);
+    for (int i = 0; i < table.extra_count; i++) {
+        snprintf(iname, 10, "unknown%02X", i + PPCC_FIXED_FIELDS);
+        setPropertyNumber(ret, iname, table.extra[i].value, 64);
     }
     return ret;
 }
@@ -473,51 +418,37 @@ OSDictionary *ThermalSolution::parsePSVT(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    const char* offset = reinterpret_cast<const char *>(data);
-
-    const uint64Container *version = reinterpret_cast<const uint64Container *>(offset);
-    offset += sizeof(uint64Container);
-    setPropertyNumber(ret, "version", version->value, 64);
-    if (version->type != ESIF_DATA_UINT64 || version->value != 2)
+    DataVaultCursor cursor(data, length);
+    uint64_t version = 0;
+    bool valid = readTableVersion(cursor, &version);
+    setPropertyNumber(ret, "version", version, 64);
+    if (!valid || version != 2)
         return ret;
 
     OSArray *arr = OSArray::withCapacity(1);
-    while (offset < reinterpret_cast<const char *>(data) + length) {
-        OSDictionary *entry = OSDictionary::withCapacity(1);
-        const uint64Container *str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "source", offset);
-        offset += str->value;
-
-        str = reinterpret_cast<const uint64Container *>(offset);
-        offset += sizeof(uint64Container);
-        setPropertyString(entry, "target", offset);
-        offset += str->value;
-
-        const uint64Container *content = reinterpret_cast<const uint64Container *>(offset);
-        setPropertyNumber(entry, "priority", content[0].value, 64);
-        setPropertyNumber(entry, "sample_period", content[1].value, 64);
-        setPropertyTemp(entry, "temp", acpi_deci_kelvin_to_deci_celsius((UInt32)content[2].value));
-        setPropertyNumber(entry, "domain", content[3].value, 64);
-        setPropertyNumber(entry, "control_knob", content[4].value, 64);
-
-        offset += 6 * sizeof(uint64Container);
-        if (content[5].type == ESIF_DATA_STRING) {
-            setPropertyString(entry, "limit", offset);
-            offset += content[5].value;
-        } else {
-            setPropertyNumber(entry, "limit", content[5].value, 64);
-        }
-
-        content = reinterpret_cast<const uint64Container *>(offset);
-        setPropertyNumber(entry, "step_size", content[0].value, 64);
-        setPropertyNumber(entry, "limit_coeff", content[1].value, 64);
-        setPropertyNumber(entry, "unlimit_coeff", content[2].value, 64);
-        setPropertyNumber(entry, "unknown", content[3].value, 64);
-        offset += 4 * sizeof(uint64Container);
+    PSVTEntry item;
+    while (nextPSVTEntry(cursor, &item)) {
+        OSDictionary *entry = OSDictionary::withCapacity(12);
+        setPropertyString(entry, "source", item.source);
+        setPropertyString(entry, "target", item.target);
+        setPropertyNumber(entry, "priority", item.priority, 64);
+        setPropertyNumber(entry, "sample_period", item.sample_period, 64);
+        setPropertyTemp(entry, "temp", acpi_deci_kelvin_to_deci_celsius((UInt32)item.temp));
+        setPropertyNumber(entry, "domain", item.domain, 64);
+        setPropertyNumber(entry, "control_knob", item.control_knob, 64);
+        if (item.limit_string)
+            setPropertyString(entry, "limit", item.limit_string);
+        else
+            setPropertyNumber(entry, "limit", item.limit, 64);
+        setPropertyNumber(entry, "step_size", item.step_size, 64);
+        setPropertyNumber(entry, "limit_coeff", item.limit_coeff, 64);
+        setPropertyNumber(entry, "unlimit_coeff", item.unlimit_coeff, 64);
+        setPropertyNumber(entry, "unknown", item.unknown, 64);
         arr->setObject(entry);
         entry->release();
     }
+    if (cursor.failed())
+        AlwaysLog("PSVT truncated");
     ret->setObject("psvs", arr);
     arr->release();
     return ret;
@@ -527,25 +458,15 @@ OSDictionary *ThermalSolution::parseIDSP(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    const char* offset = reinterpret_cast<const char *>(data);
-
+    DataVaultCursor cursor(data, length);
     OSArray *arr = OSArray::withCapacity(1);
-    while (offset < reinterpret_cast<const char *>(data) + length) {
+    const uint8_t *guid;
+    while (nextIDSPEntry(cursor, &guid)) {
         char guid_string[37];
-        const guidContainer *item = reinterpret_cast<const guidContainer *>(offset);
-
-        if ((reinterpret_cast<const char *>(data) + length - offset) < sizeof(guidContainer))
-            break;
-        // Should be 5 - ESIF_DATA_GUID instead?
-        if (item->type != ESIF_DATA_BINARY)
-            break;
-        uuid_unparse_upper(item->guid, guid_string);
+        uuid_unparse_upper(guid, guid_string);
         value = OSString::withCString(guid_string);
         arr->setObject(value);
         value->release();
-        offset += sizeof(guidContainer);
-        if (item->length != sizeof(uuid_t))
-            offset += item->length - sizeof(uuid_t);
     }
     ret->setObject("idsp", arr);
     arr->release();
@@ -556,67 +477,190 @@ OSDictionary *ThermalSolution::parseBinary(const void *data, uint32_t length) {
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
-    uint64_t size, seq = 0;
+    uint64_t seq = 0;
     char iname[10];
 
-    const char* offset = reinterpret_cast<const char *>(data);
-    while (offset < reinterpret_cast<const char *>(data) + length) {
+    DataVaultCursor cursor(data, length);
+    BinaryItem item;
+    while (nextBinaryItem(cursor, &item)) {
         snprintf(iname, 10, "unknown%02llX", seq++);
 
-        switch (*reinterpret_cast<const uint32_t *>(offset)) {
+        switch (item.type) {
             case ESIF_DATA_UINT32:
-                setPropertyNumber(ret, iname, *reinterpret_cast<const uint32_t *>(offset + sizeof(uint32_t)), 32);
-                offset += sizeof(uint32_t) + sizeof(uint32_t);
+                setPropertyNumber(ret, iname, item.number, 32);
                 break;
 
             case ESIF_DATA_UINT64:
-                setPropertyNumber(ret, iname, *reinterpret_cast<const uint64_t *>(offset + sizeof(uint32_t)), 64);
-                offset += sizeof(uint32_t) + sizeof(uint64_t);
+                setPropertyNumber(ret, iname, item.number, 64);
                 break;
 
+            case ESIF_DATA_STRING:
+                if (item.length && item.data[item.length - 1] == '\0') {
+                    setPropertyString(ret, iname, reinterpret_cast<const char *>(item.data));
+                    break;
+                }
+                // fall through
+
             case ESIF_DATA_BINARY:
-                size = *reinterpret_cast<const uint64_t *>(offset + sizeof(uint32_t));
-                offset += sizeof(uint32_t) + sizeof(uint64_t);
-                setPropertyBytes(ret, iname, offset, (uint32_t) size);
-                offset += size;
+                setPropertyBytes(ret, iname, item.data, (uint32_t) item.length);
                 break;
 
-            case ESIF_DATA_STRING:
-                size = *reinterpret_cast<const uint64_t *>(offset + sizeof(uint32_t));
-                offset += sizeof(uint32_t) + sizeof(uint64_t);
-                setPropertyString(ret, iname, offset);
-                offset += size;
+            case ESIF_DATA_UNICODE:
+                value = utf16leString(item.data, (uint32_t) item.length);
+                if (value) {
+                    ret->setObject(iname, value);
+                    value->release();
+                }
                 break;
-
-            default:
-                AlwaysLog("Unknown data type %d at", *reinterpret_cast<const uint32_t *>(offset));
-                setPropertyBytes(ret, "raw", data, length < 0xff ? length : 0xff);
-                return ret;
         }
     }
+    if (cursor.failed() || !cursor.done()) {
+        AlwaysLog("Unknown data type %d at item %llu", item.type, seq);
+        setPropertyBytes(ret, "raw", data, length < 0xff ? length : 0xff);
+    }
     return ret;
 }
 
-const char *strstr(const char *stack, const char *needle, size_t len) {
-    if (len == 0) {
-        len = strlen(needle);
-        if (len == 0) return stack;
+static void describeVersion(OSDictionary *desc, const GDDVHeader *hdr) {
+    OSObject *value;
+    setPropertyNumber(desc, "Signature", hdr->signature, 16);
+    setPropertyNumber(desc, "Major", hdr->version.major, 8);
+    setPropertyNumber(desc, "Minor", hdr->version.minor, 8);
+    setPropertyNumber(desc, "Revision", hdr->version.revision, 16);
+    setPropertyNumber(desc, "Flags", hdr->v1.flags, 32);
+}
+
+static void describeSegment(OSDictionary *desc, const GDDVHeader *hdr) {
+    OSObject *value;
+    char segmentid[ESIFDV_NAME_LEN+1];
+    char comment[ESIFDV_DESC_LEN+1];
+    char payload_class[5];
+    strncpy(segmentid, hdr->v2.segmentid, ESIFDV_NAME_LEN);
+    strncpy(comment, hdr->v2.comment, ESIFDV_DESC_LEN);
+    strncpy(payload_class, reinterpret_cast<const char *>(&hdr->v2.payload_class), 4);
+    segmentid[ESIFDV_NAME_LEN] = 0;
+    comment[ESIFDV_DESC_LEN] = 0;
+    payload_class[4] = 0;
+    setPropertyString(desc, "SegmentID", segmentid);
+    setPropertyString(desc, "Comment", comment);
+    setPropertyBytes(desc, "Hash", hdr->v2.payload_hash, SHA256_HASH_BYTES);
+    setPropertyNumber(desc, "PayloadSize", hdr->v2.payload_size, 32);
+    setPropertyString(desc, "PayloadClass", payload_class);
+}
+
+class GDDVSegmentDescriber : public DataVaultVisitor {
+    ThermalSolution *owner;
+
+public:
+    GDDVSegmentDescriber(ThermalSolution *owner) : owner(owner) {};
+
+    bool visitSegment(const DataVaultSegment &segment) APPLE_KEXT_OVERRIDE {
+        owner->parseSegment(segment);
+        return true;
     }
+};
 
-    const char *i = needle;
+void ThermalSolution::parseSegment(const DataVaultSegment &segment) {
+    OSObject *value;
+    DebugLog("Found GDDV item at %x", segment.offset);
 
-    while (*stack) {
-        if (*stack == *i) {
-            i++;
-            if (static_cast<size_t>(i - needle) == len)
-                return stack - len + 1;
-        } else {
-            i = needle;
-        }
-        stack++;
+    OSDictionary *headerDesc = OSDictionary::withCapacity(10);
+    describeVersion(headerDesc, segment.header);
+    if (segment.header->version.major != 2) {
+        AlwaysLog("Unsupport GDDV version: %x", segment.header->version.raw);
+    } else {
+        describeSegment(headerDesc, segment.header);
+    }
+    setProperty("GDDV4", headerDesc);
+    OSSafeReleaseNULL(headerDesc);
+}
+
+void ThermalSolution::parseKey(OSDictionary *entries, const DataVaultKey &key) {
+    OSObject *value;
+    const char *iname = key.name;
+
+    if (iname[0] != '/' || key.flags != 1) {
+        entries->setObject(iname, kOSBooleanFalse);
+        return;
     }
 
-    return nullptr;
+    OSDictionary *parent = parsePath(entries, iname);
+    OSObject *content = nullptr;
+
+    switch (key.type) {
+        case ESIF_DATA_UINT32:
+        case ESIF_DATA_POWER:
+            if (key.length == 4)
+                content = OSNumber::withNumber(*(reinterpret_cast<const uint32_t *>(key.value)), 32);
+            else
+                AlwaysLog("Unknown length %d uint32/power data at: %x", key.length, key.offset);
+            break;
+
+        case ESIF_DATA_TEMPERATURE:
+            if (key.length == 4)
+                content = parseDeciKelvin(*(reinterpret_cast<const uint32_t *>(key.value)));
+            break;
+
+        case ESIF_DATA_STRING:
+        case ESIF_DATA_JSON:
+            if (key.length && key.value[key.length - 1] == '\0')
+                content = OSString::withCString(reinterpret_cast<const char *>(key.value));
+            break;
+
+        case ESIF_DATA_UNICODE:
+            content = utf16leString(key.value, key.length);
+            break;
+
+        case ESIF_DATA_BINARY:
+            switch (classifyDataVaultKey(key.name)) {
+                case kDataVaultTableAPAT:
+                    content = parseAPAT(key.value, key.length);
+                    break;
+
+                case kDataVaultTableAPCT:
+                    content = parseAPCT(key.value, key.length);
+                    break;
+
+                case kDataVaultTableAPPC:
+                    content = parseAPPC(key.value, key.length);
+                    break;
+
+                case kDataVaultTablePPCC:
+                    content = parsePPCC(key.value, key.length);
+                    break;
+
+                case kDataVaultTablePSVT:
+                    content = parsePSVT(key.value, key.length);
+                    break;
+
+                case kDataVaultTableIDSP:
+                    content = parseIDSP(key.value, key.length);
+                    break;
+
+                default:
+                    AlwaysLog("Unknown binary %s at %x", iname, key.offset);
+                    content = parseBinary(key.value, key.length);
+                    break;
+            }
+            break;
+    }
+    if (!content) {
+        OSDictionary *keyDesc = OSDictionary::withCapacity(1);
+        setPropertyNumber(keyDesc, "type", key.type, 32);
+        setPropertyNumber(keyDesc, "length", key.length, 32);
+        if (key.length < 0xff)
+            setPropertyBytes(keyDesc, "value", key.value, key.length);
+        content = keyDesc;
+#ifdef DEBUG
+    } else {
+        OSDictionary *keyDesc;
+        if ((keyDesc = OSDynamicCast(OSDictionary, content)))
+            setPropertyNumber(keyDesc, "length", key.length, 32);
+#endif
+    }
+    parent->setObject(iname, content);
+    OSSafeReleaseNULL(content);
+    OSSafeReleaseNULL(parent);
 }
 
 bool ThermalSolution::evaluateGDDV() {
@@ -631,307 +675,496 @@ bool ThermalSolution::evaluateGDDV() {
         return false;
     }
 
+    int err = checkDataVaultHeader(buf->getBytesNoCopy(), buf->getLength());
+    if (err == kDataVaultTruncated) {
+        AlwaysLog("GDDV too short");
+        OSSafeReleaseNULL(result);
+        return false;
+    }
+
     const GDDVHeader *hdr = reinterpret_cast<const GDDVHeader *>(buf->getBytesNoCopy());
     OSDictionary *headerDesc = OSDictionary::withCapacity(6);
     OSObject *value;
-    OSData *decompressed = 0;
-    setPropertyNumber(headerDesc, "Signature", hdr->signature, 16);
-    setPropertyNumber(headerDesc, "Major", hdr->version.major, 8);
-    setPropertyNumber(headerDesc, "Minor", hdr->version.minor, 8);
-    setPropertyNumber(headerDesc, "Revision", hdr->version.revision, 16);
-    setPropertyNumber(headerDesc, "Flags", hdr->v1.flags, 32);
+    describeVersion(headerDesc, hdr);
     setPropertyNumber(headerDesc, "Length", buf->getLength(), 32);
     setProperty("GDDV", headerDesc);
     OSSafeReleaseNULL(headerDesc);
 
-    if (hdr->signature != ESIFDV_HEADER_SIGNATURE) {
-        AlwaysLog("Unsupported signature");
+    if (err != kDataVaultOK) {
+        AlwaysLog("%s", dataVaultError(err));
         OSSafeReleaseNULL(result);
         return false;
     }
 
-    int offset = hdr->headersize;
+    // Values are materialized on request, the index only points into the image
+    GDDVSegmentDescriber segments(this);
+    DataVaultIndex &index = gddvCache.index;
+    uint32_t hits = gddvCache.hits;
 
     if (hdr->version.major == 2) {
-        if (hdr->headersize != sizeof(GDDVHeader)) {
-            AlwaysLog("Header size mismatch");
-            OSSafeReleaseNULL(result);
-            return false;
-        }
-        if (hdr->v2.payload_size != buf->getLength() - hdr->headersize) {
-            AlwaysLog("Payload size mismatch");
-            OSSafeReleaseNULL(result);
-            return false;
-        }
-        char segmentid[ESIFDV_NAME_LEN+1];
-        char comment[ESIFDV_DESC_LEN+1];
-        char payload_class[5];
-        strncpy(segmentid, hdr->v2.segmentid, ESIFDV_NAME_LEN);
-        strncpy(comment, hdr->v2.comment, ESIFDV_DESC_LEN);
-        strncpy(payload_class, reinterpret_cast<const char *>(&hdr->v2.payload_class), 4);
-        segmentid[ESIFDV_NAME_LEN] = 0;
-        comment[ESIFDV_DESC_LEN] = 0;
-        payload_class[4] = 0;
         headerDesc = OSDictionary::withCapacity(5);
-        setPropertyString(headerDesc, "SegmentID", segmentid);
-        setPropertyString(headerDesc, "Comment", comment);
-        setPropertyBytes(headerDesc, "Hash", hdr->v2.payload_hash, SHA256_HASH_BYTES);
-        setPropertyNumber(headerDesc, "PayloadSize", hdr->v2.payload_size, 32);
-        setPropertyString(headerDesc, "PayloadClass", payload_class);
+        describeSegment(headerDesc, hdr);
         setProperty("GDDV2", headerDesc);
         OSSafeReleaseNULL(headerDesc);
-        if (hdr->v2.flags & ESIF_SERVICE_CONFIG_COMPRESSED) {
-            int res;
-            size_t destlen = 0;
-            res = lzma_decompress(NULL, &destlen, reinterpret_cast<const unsigned char *>(buf->getBytesNoCopy(hdr->headersize, hdr->v2.payload_size)), hdr->v2.payload_size);
-            AlwaysLog("Decompress res = %d req = %zx", res, destlen);
-            if (res != 0) {
-                AlwaysLog("Header verification failed");
-                OSSafeReleaseNULL(result);
-                return false;
-            }
-            if (destlen >> 32) {
-                AlwaysLog("Payload output size exceeded");
-                OSSafeReleaseNULL(result);
-                return false;
-            }
-            setProperty("PayloadOutputSize", destlen, 64);
-            unsigned char *tmp = reinterpret_cast<unsigned char*>(IOMalloc(destlen));
-            if (!tmp) {
-                AlwaysLog("Payload output alloc failed");
-                OSSafeReleaseNULL(result);
-                return false;
-            }
-            res = lzma_decompress(tmp, &destlen, reinterpret_cast<const unsigned char *>(buf->getBytesNoCopy(hdr->headersize, hdr->v2.payload_size)), hdr->v2.payload_size);
-            AlwaysLog("Decompress res = %d req = %zx", res, destlen);
-            if (res != 0) {
-                AlwaysLog("Decompress failed = %d", res);
-                IOFree(tmp, destlen);
-                OSSafeReleaseNULL(result);
-                return false;
-            }
-            decompressed = OSData::withBytes(tmp, (unsigned int)destlen);
-            IOFree(tmp, destlen);
-            if (!decompressed) {
-                AlwaysLog("Payload output copy failed");
-                OSSafeReleaseNULL(result);
+        if (!isDataVaultCompressed(hdr)) {
+            AlwaysLog("Non-uncompress flag not implemented");
+            OSSafeReleaseNULL(result);
+            return true;
+        }
+
+        if (gddvCache.lookup(hdr)) {
+            DebugLog("Payload unchanged, reusing %d keys", index.getCount());
+            OSSafeReleaseNULL(result);
+            err = kDataVaultOK;
+        } else {
+            OSSafeReleaseNULL(gddv);
+            // Keys are indexed while the payload is being decoded into its only copy
+            err = gddvCache.load(hdr, &segments);
+            AlwaysLog("Decompress res = %d len = %x/%x", err, gddvCache.decoder.getDecoded(), gddvCache.decoder.getLength());
+            OSSafeReleaseNULL(result);
+            if (!gddvCache.decoder.getDecoded() || err == kDataVaultDecompressFailed || err == kDataVaultBadSignature) {
+                AlwaysLog("Decompress failed: %s", dataVaultError(err));
+                // The policies borrow names and tables from the image that is going away
+                wheel.removeContext(&passive);
+                releasePassive();
+                wheel.removeContext(&adaptive);
+                adaptiveDue = UINT64_MAX;
+                adaptive.release();
+                adaptiveTarget = ADAPTIVE_NO_TARGET;
+                gddvCache.release();
                 return false;
             }
-            buf = decompressed;
-            hdr = reinterpret_cast<const GDDVHeader *>(buf->getBytesNoCopy());
-            memset(segmentid, 0, ESIFDV_NAME_LEN);
-            memset(comment, 0, ESIFDV_DESC_LEN);
-            memset(payload_class, 0, 4);
-            strncpy(segmentid, hdr->v2.segmentid, ESIFDV_NAME_LEN);
-            strncpy(comment, hdr->v2.comment, ESIFDV_DESC_LEN);
-            strncpy(payload_class, reinterpret_cast<const char *>(&hdr->v2.payload_class), 4);
+            setProperty("PayloadOutputSize", gddvCache.decoder.getLength(), 64);
+
+            hdr = reinterpret_cast<const GDDVHeader *>(gddvCache.decoder.getImage());
             headerDesc = OSDictionary::withCapacity(11);
-            setPropertyNumber(headerDesc, "Signature", hdr->signature, 16);
-            setPropertyNumber(headerDesc, "Major", hdr->version.major, 8);
-            setPropertyNumber(headerDesc, "Minor", hdr->version.minor, 8);
-            setPropertyNumber(headerDesc, "Revision", hdr->version.revision, 16);
-            setPropertyNumber(headerDesc, "Flags", hdr->v1.flags, 32);
-            setPropertyNumber(headerDesc, "DestLen", destlen, 64);
-            setPropertyString(headerDesc, "SegmentID", segmentid);
-            setPropertyString(headerDesc, "Comment", comment);
-            setPropertyBytes(headerDesc, "Hash", hdr->v2.payload_hash, SHA256_HASH_BYTES);
-            setPropertyNumber(headerDesc, "PayloadSize", hdr->v2.payload_size, 32);
-            setPropertyString(headerDesc, "PayloadClass", payload_class);
+            describeVersion(headerDesc, hdr);
+            setPropertyNumber(headerDesc, "DestLen", gddvCache.decoder.getLength(), 64);
+            if (gddvCache.decoder.getDecoded() >= sizeof(GDDVHeader))
+                describeSegment(headerDesc, hdr);
             setProperty("GDDV3", headerDesc);
             OSSafeReleaseNULL(headerDesc);
-
-            if (hdr->signature != ESIFDV_HEADER_SIGNATURE) {
-                AlwaysLog("Unsupported signature");
-                OSSafeReleaseNULL(result);
-                OSSafeReleaseNULL(decompressed);
-                return false;
-            }
-        } else {
-            AlwaysLog("Non-uncompress flag not implemented");
-            return true;
         }
+    } else {
+        gddvCache.release();
+        OSSafeReleaseNULL(gddv);
+        err = index.build(reinterpret_cast<const uint8_t *>(buf->getBytesNoCopy()), buf->getLength(), &segments);
+        gddv = buf;
+        gddv->retain();
+        OSSafeReleaseNULL(result);
     }
 
-    OSDictionary *entries = OSDictionary::withCapacity(1);
-    while ((offset < buf->getLength())) {
-        if (hdr->version.major == 2) {
-            const uint16_t *signature = reinterpret_cast<const uint16_t *>(buf->getBytesNoCopy(offset, sizeof(uint16_t)));
-            if (*signature == ESIFDV_ITEM_KEYS_REV0_SIGNATURE) {
-                offset += sizeof(uint16_t);
-            } else if (*signature == ESIFDV_HEADER_SIGNATURE) {
-                DebugLog("Found GDDV item at %x", offset);
-                const GDDVHeader *hdr_e = reinterpret_cast<const GDDVHeader *>(buf->getBytesNoCopy(offset, sizeof(GDDVHeader)));
-                headerDesc = OSDictionary::withCapacity(10);
-                setPropertyNumber(headerDesc, "Signature", hdr_e->signature, 16);
-                setPropertyNumber(headerDesc, "Major", hdr_e->version.major, 8);
-                setPropertyNumber(headerDesc, "Minor", hdr_e->version.minor, 8);
-                setPropertyNumber(headerDesc, "Revision", hdr_e->version.revision, 16);
-                setPropertyNumber(headerDesc, "Flags", hdr_e->v1.flags, 32);
-                if (hdr_e->version.major != 2) {
-                    AlwaysLog("Unsupport GDDV version: %x", hdr_e->version.raw);
-                    setProperty("GDDV4", headerDesc);
-                    OSSafeReleaseNULL(headerDesc);
-                    break;
-                }
-                char segmentid[ESIFDV_NAME_LEN+1];
-                char comment[ESIFDV_DESC_LEN+1];
-                char payload_class[5];
-                strncpy(segmentid, hdr->v2.segmentid, ESIFDV_NAME_LEN);
-                strncpy(comment, hdr->v2.comment, ESIFDV_DESC_LEN);
-                strncpy(payload_class, reinterpret_cast<const char *>(&hdr->v2.payload_class), 4);
-                segmentid[ESIFDV_NAME_LEN] = 0;
-                comment[ESIFDV_DESC_LEN] = 0;
-                payload_class[4] = 0;
-                setPropertyString(headerDesc, "SegmentID", segmentid);
-                setPropertyString(headerDesc, "Comment", comment);
-                setPropertyBytes(headerDesc, "Hash", hdr_e->v2.payload_hash, SHA256_HASH_BYTES);
-                setPropertyNumber(headerDesc, "PayloadSize", hdr_e->v2.payload_size, 32);
-                setPropertyString(headerDesc, "PayloadClass", payload_class);
-                setPropertyBytes(headerDesc, "Raw", buf->getBytesNoCopy(offset, hdr_e->headersize + hdr_e->v2.payload_size), hdr_e->headersize + hdr_e->v2.payload_size);
-                setProperty("GDDV4", headerDesc);
-                OSSafeReleaseNULL(headerDesc);
-                offset += hdr_e->headersize;
-                signature = reinterpret_cast<const uint16_t *>(buf->getBytesNoCopy(offset, sizeof(uint16_t)));
-                if (*signature == ESIFDV_ITEM_KEYS_REV0_SIGNATURE) {
-                    offset += sizeof(uint16_t);
-                } else {
-                    AlwaysLog("Unknown signature: %x", *signature);
-                    offset += hdr_e->v2.payload_size;
-                    continue;
-                }
-            } else {
-                AlwaysLog("Unknown signature: %x", *signature);
-                break;
-            }
-        }
-
-        const GDDVKeyHeader *key = reinterpret_cast<const GDDVKeyHeader *>(buf->getBytesNoCopy(offset, sizeof(GDDVKeyHeader)));
-        offset += sizeof(GDDVKeyHeader);
+    if (err != kDataVaultOK)
+        AlwaysLog("DataVault walk stopped: %s", dataVaultError(err));
+    if (gddvCache.hits == hits) {
+        compileAdaptive();
+        compilePassive();
+    }
 
-        const char *iname = reinterpret_cast<const char *>(buf->getBytesNoCopy(offset, key->length));
-        const char *oname = iname;
-        offset += key->length;
+    headerDesc = OSDictionary::withCapacity(5);
+    setPropertyNumber(headerDesc, "Keys", index.getCount(), 32);
+    setPropertyNumber(headerDesc, "IndexSize", index.getIndexSize(), 32);
+    setPropertyNumber(headerDesc, "ImageSize", index.getLength(), 32);
+    setPropertyNumber(headerDesc, "CacheHits", gddvCache.hits, 32);
+    setPropertyNumber(headerDesc, "CacheMisses", gddvCache.misses, 32);
+    setProperty("GDDVIndex", headerDesc);
+    OSSafeReleaseNULL(headerDesc);
+    return true;
+}
 
-        const GDDVKeyHeader *val = reinterpret_cast<const GDDVKeyHeader *>(buf->getBytesNoCopy(offset, sizeof(GDDVKeyHeader)));
-        offset += sizeof(GDDVKeyHeader);
+OSDictionary *ThermalSolution::queryGDDV(const char *path) {
+    OSDictionary *entries = OSDictionary::withCapacity(1);
+    size_t len = strlen(path);
+    DataVaultKey key;
 
-        if (iname[0] != '/' || key->flag != 1) {
-            entries->setObject(iname, kOSBooleanFalse);
-            offset += val->length;
+    for (uint32_t i = gddvCache.index.lowerBound(path); gddvCache.index.getKey(i, &key); i++) {
+        if (strncmp(key.name, path, len))
+            break;
+        // Match whole path components only
+        if (len && path[len - 1] != '/' && key.name[len] != '\0' && key.name[len] != '/')
             continue;
-        }
+        parseKey(entries, key);
+    }
+    return entries;
+}
 
-        OSDictionary *parent = parsePath(entries, iname);
-        OSObject *content = nullptr;
+bool ThermalSolution::findTable(int table, DataVaultKey *key) {
+    for (uint32_t i = 0; gddvCache.index.getKey(i, key); i++)
+        if (key->name[0] == '/' && key->flags == 1 && key->type == ESIF_DATA_BINARY &&
+            classifyDataVaultKey(key->name) == table)
+            return true;
+    return false;
+}
 
-        switch (val->flag) {
-            case ESIF_DATA_UINT32:
-            case ESIF_DATA_POWER:
-                if (val->length == 4)
-                    content = OSNumber::withNumber(*(reinterpret_cast<const uint32_t *>(buf->getBytesNoCopy(offset, val->length))), 32);
-                else
-                    AlwaysLog("Unknown length %d uint32/power data at: %x", val->length, offset);
-                break;
+static const char *leafName(const char *path) {
+    const char *leaf = path;
+    for (const char *c = path; *c; c++)
+        if (*c == '.' || *c == '\\')
+            leaf = c + 1;
+    return leaf;
+}
 
-            case ESIF_DATA_TEMPERATURE:
-                content = parseDeciKelvin(*(reinterpret_cast<const uint32_t *>(buf->getBytesNoCopy(offset, val->length))));
-                break;
+int ThermalSolution::findParticipant(const char *path) {
+    // Match the ACPI name of the consumer's provider with the last segment of the path
+    const char *leaf = leafName(path);
 
-            case ESIF_DATA_STRING:
-                content = OSString::withCString(reinterpret_cast<const char *>(buf->getBytesNoCopy(offset, val->length)));
-                break;
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+        IOService *service = participants[i].service;
+        IOService *provider = service ? service->getProvider() : nullptr;
+        if (provider && !strcmp(provider->getName(), leaf))
+            return i;
+    }
+    return -1;
+}
 
-            case ESIF_DATA_BINARY:
-                if (!strncmp(iname, "/apat", strlen("/apat")))
-                    content = parseAPAT(buf->getBytesNoCopy(offset, val->length), val->length);
-                else if (!strncmp(iname, "/apct", strlen("/apct")))
-                    content = parseAPCT(buf->getBytesNoCopy(offset, val->length), val->length);
-                else if (!strncmp(iname, "/appc", strlen("/appc")))
-                    content = parseAPPC(buf->getBytesNoCopy(offset, val->length), val->length);
-                else if (!strncmp(iname, "/ppcc", strlen("/ppcc")))
-                    content = parsePPCC(buf->getBytesNoCopy(offset, val->length), val->length);
-                else if (!strncmp(iname, "/psvt", strlen("/psvt")) || !!strstr(oname, "/psvt", 0))
-                    content = parsePSVT(buf->getBytesNoCopy(offset, val->length), val->length);
-                else if (!strncmp(iname, "/idsp", strlen("/idsp")))
-                    content = parseIDSP(buf->getBytesNoCopy(offset, val->length), val->length);
-                else {
-                    AlwaysLog("Unknown binary %s at %x", iname, offset);
-                    content = parseBinary(buf->getBytesNoCopy(offset, val->length), val->length);
-                }
-                break;
+void ThermalSolution::compileAdaptive() {
+    DataVaultKey key;
+    wheel.removeContext(&adaptive);
+    adaptiveDue = UINT64_MAX;
+    adaptive.release();
+    adaptiveTarget = ADAPTIVE_NO_TARGET;
+    adaptiveInputs.deviceValid = 0;
+    if (!findTable(kDataVaultTableAPCT, &key))
+        return;
 
-            case ESIF_DATA_JSON:
-                content = OSString::withCString(reinterpret_cast<const char *>(buf->getBytesNoCopy(offset, val->length)));
-                break;
-        }
-        if (!content) {
-            OSDictionary *keyDesc = OSDictionary::withCapacity(1);
-            setPropertyNumber(keyDesc, "type", val->flag, 32);
-            setPropertyNumber(keyDesc, "length", val->length, 32);
-            if (val->length < 0xff)
-                setPropertyBytes(keyDesc, "value", buf->getBytesNoCopy(offset, val->length), val->length);
-            content = keyDesc;
-#ifdef DEBUG
-        } else {
-            OSDictionary *keyDesc;
-            if ((keyDesc = OSDynamicCast(OSDictionary, content)))
-                setPropertyNumber(keyDesc, "length", val->length, 32);
-#endif
-        }
-        offset += val->length;
-        parent->setObject(iname, content);
-        OSSafeReleaseNULL(content);
-        OSSafeReleaseNULL(parent);
+    int err = adaptive.compile(key.value, key.length);
+    if (err != kDataVaultOK)
+        AlwaysLog("APCT %s not compiled: %s", key.name, dataVaultError(err));
+    bindAdaptive();
+
+    OSDictionary *desc = OSDictionary::withCapacity(4);
+    OSObject *value;
+    setPropertyString(desc, "Table", key.name);
+    setPropertyNumber(desc, "Version", adaptive.getVersion(), 64);
+    setPropertyNumber(desc, "Targets", adaptive.getTargetCount(), 32);
+    setPropertyNumber(desc, "Conditions", adaptive.getConditionCount(), 32);
+    setPropertyNumber(desc, "Devices", adaptive.getDeviceCount(), 32);
+    setProperty("Adaptive", desc);
+    OSSafeReleaseNULL(desc);
+    evaluateAdaptive();
+}
+
+void ThermalSolution::bindAdaptive() {
+    for (uint32_t i = 0; i < ADAPTIVE_DEVICE_MAX; i++) {
+        int slot = i < adaptive.getDeviceCount() ? findParticipant(adaptive.getDeviceName(i)) : -1;
+        adaptiveParticipants[i] = slot < 0 ? THERMAL_PARTICIPANT_MAX : slot;
     }
-    setProperty("GDDVEntry", entries);
-    entries->release();
-    OSSafeReleaseNULL(result);
-    OSSafeReleaseNULL(decompressed);
-    return true;
+}
+
+void ThermalSolution::evaluateAdaptive() {
+    if (!adaptive.getTargetCount())
+        return;
+
+    adaptiveInputs.now = uptimeMS();
+
+    // v2 temperature conditions read the participant they name
+    for (uint32_t i = 0; i < adaptive.getDeviceCount(); i++) {
+        UInt8 slot = adaptiveParticipants[i];
+        ThermalParticipant *participant = slot < THERMAL_PARTICIPANT_MAX ? &participants[slot] : nullptr;
+        UInt32 tmp = 0;
+        if (participant && participant->service) {
+            tmp = participant->temperature;
+            if (!participant->period)
+                participant->service->message(kThermal_getTemperature, this, &tmp);
+        }
+        if (tmp)
+            adaptiveInputs.setDevice(i, tmp);
+        else
+            adaptiveInputs.clearDevice(i);
+    }
+
+    // Hottest sensor in deci-Kelvin for conditions without a device, only sampled when a set depends on it
+    if (adaptive.dependsOn(Temperature)) {
+        UInt32 hottest = 0;
+        for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+            ThermalParticipant *participant = &participants[i];
+            if (!participant->service)
+                continue;
+            // Sampled participants are at most one period old
+            UInt32 tmp = participant->temperature;
+            if (!participant->period)
+                participant->service->message(kThermal_getTemperature, this, &tmp);
+            if (tmp > hottest)
+                hottest = tmp;
+        }
+        if (hottest)
+            adaptiveInputs.set(Temperature, hottest);
+    }
+
+    // Only sets reading a changed input are checked again
+    uint64_t target = adaptive.update(adaptiveInputs);
+
+    // A FOR condition can pass with no input changing, so wake up when the first one is due
+    if (adaptive.getDue() != adaptiveDue) {
+        wheel.removeContext(&adaptive);
+        adaptiveDue = adaptive.getDue();
+        if (adaptiveDue != UINT64_MAX) {
+            uint64_t tick = uptimeMS() / THERMAL_WHEEL_TICK_MS;
+            uint64_t dueTick = (adaptiveDue + THERMAL_WHEEL_TICK_MS - 1) / THERMAL_WHEEL_TICK_MS;
+            wheel.advance(tick);
+            if (wheel.add(dueTick > tick ? (uint32_t)(dueTick - tick) : 1, 0, &ThermalSolution::adaptiveAction,
+                          this, &adaptive, 0) == TIMER_WHEEL_INVALID)
+                AlwaysLog("Failed to schedule adaptive conditions");
+            armWheel();
+        }
+    }
+
+    if (target == adaptiveTarget)
+        return;
+    adaptiveTarget = target;
+
+    OSDictionary *desc = OSDictionary::withCapacity(6);
+    OSObject *value;
+    DataVaultKey key;
+    if (target != ADAPTIVE_NO_TARGET) {
+        setPropertyNumber(desc, "target_id", target, 64);
+        if (findTable(kDataVaultTableAPAT, &key)) {
+            DataVaultCursor cursor(key.value, key.length);
+            uint64_t version;
+            APATEntry entry;
+            if (readTableVersion(cursor, &version) && version == 2) {
+                while (nextAPATEntry(cursor, &entry)) {
+                    if (entry.target_id != target)
+                        continue;
+                    setPropertyString(desc, "name", entry.name);
+                    setPropertyString(desc, "participant", entry.participant);
+                    setPropertyNumber(desc, "domain", entry.domain, 64);
+                    setPropertyString(desc, "code", entry.code);
+                    setPropertyString(desc, "argument", entry.argument);
+                    break;
+                }
+            }
+        }
+    }
+    DebugLog("Adaptive target %lld", target);
+    setProperty("AdaptiveTarget", desc);
+    OSSafeReleaseNULL(desc);
+}
+
+void ThermalSolution::adaptiveAction(void *owner, void *context, uint32_t cookie) {
+    ThermalSolution *that = static_cast<ThermalSolution *>(owner);
+    // The one-shot is spent, a FOR condition still waiting schedules the next one
+    that->adaptiveDue = UINT64_MAX;
+    that->evaluateAdaptive();
+}
+
+void ThermalSolution::releasePassive() {
+    for (uint32_t i = 0; i < passiveSensorCount; i++)
+        OSSafeReleaseNULL(passiveSensors[i]);
+    if (passiveSensors)
+        IOFree(passiveSensors, passiveSensorCount * sizeof(IOService *));
+    passiveSensors = nullptr;
+    if (passiveVirtual)
+        IOFree(passiveVirtual, passiveSensorCount);
+    passiveVirtual = nullptr;
+    passiveSensorCount = 0;
+    if (passiveSources)
+        IOFree(passiveSources, passiveSourceCount);
+    passiveSources = nullptr;
+    passiveSourceCount = 0;
+    passive.release();
+}
+
+void ThermalSolution::compilePassive() {
+    DataVaultKey key;
+    wheel.removeContext(&passive);
+    releasePassive();
+    if (!findTable(kDataVaultTablePSVT, &key))
+        return;
+
+    int err = passive.compile(key.value, key.length);
+    if (err != kDataVaultOK) {
+        AlwaysLog("PSVT %s not compiled: %s", key.name, dataVaultError(err));
+        return;
+    }
+
+    passiveSensorCount = passive.getSensorCount();
+    passiveSensors = reinterpret_cast<IOService **>(IOMalloc(passiveSensorCount * sizeof(IOService *)));
+    passiveVirtual = reinterpret_cast<UInt8 *>(IOMalloc(passiveSensorCount));
+    passiveSourceCount = passive.getDeviceCount();
+    passiveSources = reinterpret_cast<UInt8 *>(IOMalloc(passiveSourceCount));
+    if (!passiveSensors || !passiveVirtual || !passiveSources) {
+        AlwaysLog("Passive state alloc failed");
+        releasePassive();
+        return;
+    }
+    bzero(passiveSensors, passiveSensorCount * sizeof(IOService *));
+    memset(passiveVirtual, VIRTUAL_SENSOR_MAX, passiveSensorCount);
+    memset(passiveSources, THERMAL_PARTICIPANT_MAX, passiveSourceCount);
+
+    // The DataVault PPCC only gives the PL1 range, other knobs have no range to step in
+    // and stay inactive, as does everything when there is no PPCC
+    PPCCTable ppcc;
+    uint32_t active = 0;
+    if (findTable(kDataVaultTablePPCC, &key) && readPPCC(key.value, key.length, &ppcc)) {
+        publishLimits(&ppcc);
+        for (uint32_t i = 0; i < passive.getEntryCount(); i++) {
+            const PassiveEntry *entry = passive.getEntry(i);
+            if (entry->knob != kPassiveKnobPL1)
+                continue;
+            if (entry->limit_kind == kPassiveLimitNumber &&
+                (entry->limit < (int64_t)ppcc.power_limit_min || entry->limit > (int64_t)ppcc.power_limit_max))
+                continue;
+            passive.setRange(i, ppcc.power_limit_min, ppcc.power_limit_max);
+            active++;
+        }
+    }
+
+    wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+    for (uint32_t i = 0; i < passive.getEntryCount(); i++) {
+        if (!passive.getState(i)->active)
+            continue;
+        UInt32 period = passive.getEntry(i)->period / THERMAL_WHEEL_TICK_MS;
+        if (wheel.add(1, period ? period : 1, &ThermalSolution::passiveAction, this, &passive, i) == TIMER_WHEEL_INVALID) {
+            AlwaysLog("Failed to schedule PSVT entry %d", i);
+            break;
+        }
+    }
+
+    OSDictionary *desc = OSDictionary::withCapacity(4);
+    OSObject *value;
+    setPropertyString(desc, "Table", key.name);
+    setPropertyNumber(desc, "Entries", passive.getEntryCount(), 32);
+    setPropertyNumber(desc, "Active", active, 32);
+    setPropertyNumber(desc, "Sensors", passiveSensorCount, 32);
+    setProperty("Passive", desc);
+    OSSafeReleaseNULL(desc);
+
+    bindPassive();
+    armWheel();
+}
+
+void ThermalSolution::bindPassive() {
+    for (uint32_t i = 0; i < passiveSensorCount; i++) {
+        OSSafeReleaseNULL(passiveSensors[i]);
+        const char *path = passive.getSensorName(i);
+        int slot = findParticipant(path);
+        if (slot >= 0) {
+            passiveSensors[i] = participants[slot].service;
+            passiveSensors[i]->retain();
+        }
+
+        // Otherwise the target may name a virtual sensor
+        int sensor = passiveSensors[i] ? -1 : findVirtual(leafName(path));
+        passiveVirtual[i] = sensor < 0 ? VIRTUAL_SENSOR_MAX : sensor;
+    }
+    for (uint32_t i = 0; i < passiveSourceCount; i++) {
+        int slot = findParticipant(passive.getDeviceName(i));
+        passiveSources[i] = slot < 0 ? THERMAL_PARTICIPANT_MAX : slot;
+    }
+}
+
+UInt32 ThermalSolution::readPassiveSensor(uint32_t sensor) {
+    UInt32 tmp = 0;
+    if (passiveSensors[sensor])
+        passiveSensors[sensor]->message(kThermal_getTemperature, this, &tmp);
+    else
+        tmp = virtuals.getValue(passiveVirtual[sensor]);
+    return tmp;
+}
+
+void ThermalSolution::passiveAction(void *owner, void *context, uint32_t cookie) {
+    ThermalSolution *that = static_cast<ThermalSolution *>(owner);
+    const PassiveEntry *entry = that->passive.getEntry(cookie);
+    if (that->passive.step(cookie, that->readPassiveSensor(entry->sensor)))
+        that->publishPassive();
+}
+
+void ThermalSolution::publishPassive() {
+    OSArray *arr = OSArray::withCapacity(passive.getEntryCount());
+    OSObject *value;
+    for (uint32_t i = 0; i < passive.getEntryCount(); i++) {
+        const PassiveEntry *entry = passive.getEntry(i);
+        const PassiveState *state = passive.getState(i);
+        if (!state->active)
+            continue;
+        OSDictionary *desc = OSDictionary::withCapacity(5);
+        setPropertyString(desc, "source", passive.getDeviceName(entry->device));
+        setPropertyString(desc, "target", passive.getSensorName(entry->sensor));
+        setPropertyNumber(desc, "control_knob", entry->knob, 32);
+        setPropertyNumber(desc, "value", state->value, 64);
+        setPropertyBoolean(desc, "throttling", state->throttling);
+        arr->setObject(desc);
+        desc->release();
+        if (state->changed)
+            DebugLog("%s knob %d -> %lld", passive.getDeviceName(entry->device), entry->knob, state->value);
+    }
+    setProperty("PassiveState", arr);
+    arr->release();
+}
+
+void ThermalSolution::handleEvents(IOTimerEventSource *sender) {
+    // Runs on the work loop, one evaluation however many notifications arrived
+    UInt32 pending = events.take();
+    if (pending & INT3400_EVENT_TABLE_CHANGED)
+        evaluateGDDV();
+    if (pending & INT3400_EVENT_ODVP_CHANGED)
+        evaluateODVP();
+
+    OSDictionary *stats = events.getStats();
+    setProperty("Events", stats);
+    stats->release();
+}
+
+void ThermalSolution::evaluateTablesGated() {
+    evaluateGDDV();
+    evaluateODVP();
 }
 
 bool ThermalSolution::evaluateODVP() {
     OSObject *result;
     OSArray *package;
     if ((dev->evaluateObject("ODVP", &result) == kIOReturnSuccess) &&
-        (package = OSDynamicCast(OSArray, result)))
-        setProperty("ODVP", package);
+        (package = OSDynamicCast(OSArray, result))) {
+        // Monitors poll the telemetry page, the registry only changes with the values
+        publishODVP(package);
+        OSObject *published = getProperty("ODVP");
+        if (!published || !package->isEqualTo(published))
+            setProperty("ODVP", package);
+        // OEM conditions compare against the ODVP variables
+        for (uint32_t i = 0; i <= Oem5 - Oem0; i++) {
+            OSNumber *odvp = OSDynamicCast(OSNumber, package->getObject(i));
+            if (odvp)
+                adaptiveInputs.set(Oem0 + i, odvp->unsigned32BitValue());
+            else
+                adaptiveInputs.clear(Oem0 + i);
+        }
+        evaluateAdaptive();
+    }
     OSSafeReleaseNULL(result);
     return true;
 }
 
+bool ThermalSolution::initOSC() {
+    // The buffers are referenced, not copied, so a switch only rewrites them
+    oscParams[0] = OSData::withBytesNoCopy(&oscGuid, sizeof(int3400_guid));
+    oscParams[1] = OSNumber::withNumber(DPTF_OSC_REVISION, 32);
+    oscParams[2] = OSNumber::withNumber(sizeof(oscCaps)/sizeof(UInt32), 32);
+    oscParams[3] = OSData::withBytesNoCopy(oscCaps, sizeof(oscCaps));
+    for (int i = 0; i < 4; i++)
+        if (!oscParams[i])
+            return false;
+    return true;
+}
+
+void ThermalSolution::releaseOSC() {
+    for (int i = 0; i < 4; i++)
+        OSSafeReleaseNULL(oscParams[i]);
+}
+
 bool ThermalSolution::changeMode(int i, bool enable) {
     if (!(uuid_bitmap & BIT(i))) {
         AlwaysLog("Mode %s is not available", int3400_thermal_uuids[i]);
         return false;
     }
 
-    uuid_t guid;
-    uuid_parse(int3400_thermal_uuids[i], guid);
+    oscGuid = int3400_thermal_guids[i];
+    oscCaps[OSC_QUERY_DWORD] = 0;
+    oscCaps[OSC_SUPPORT_DWORD] = enable;
 
-    // convert to mixed-endian
-    *(reinterpret_cast<uint32_t *>(guid)) = OSSwapInt32(*(reinterpret_cast<uint32_t *>(guid)));
-    *(reinterpret_cast<uint16_t *>(guid) + 2) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(guid) + 2));
-    *(reinterpret_cast<uint16_t *>(guid) + 3) = OSSwapInt16(*(reinterpret_cast<uint16_t *>(guid) + 3));
-
-    UInt32 buf[2];
-    buf[OSC_QUERY_DWORD] = 0;
-    buf[OSC_SUPPORT_DWORD] = enable;
-
-    OSObject *params[] = {
-        OSData::withBytes(guid, 16),
-        OSNumber::withNumber(DPTF_OSC_REVISION, 32),
-        OSNumber::withNumber(sizeof(buf)/sizeof(UInt32), 32),
-        OSData::withBytes(buf, sizeof(buf)),
-    };
-
-    OSObject *result;
+    OSObject *result = nullptr;
 
-    IOReturn ret = dev->evaluateObject("_OSC", &result, params, 4);
-    params[0]->release();
-    params[1]->release();
-    params[2]->release();
-    params[3]->release();
+    IOReturn ret = dev->evaluateObject("_OSC", &result, oscParams, 4);
     if (ret == kIOReturnSuccess) {
         OSData *data;
         const UInt32 *rbuf;
@@ -945,34 +1178,123 @@ bool ThermalSolution::changeMode(int i, bool enable) {
                 AlwaysLog("_OSC invalid UUID");
             if (error & OSC_INVALID_REVISION_ERROR)
                 AlwaysLog("_OSC invalid revision");
+            // ODVP is refreshed with the deferred notification work, not on the switch path
             if (!error || error & OSC_CAPABILITIES_MASK_ERROR)
-                evaluateODVP();
+                events.post(INT3400_EVENT_ODVP_CHANGED);
             else
                 ret = kIOReturnInvalid;
         }
     } else {
         AlwaysLog("_OSC evaluate failed");
     }
+    OSSafeReleaseNULL(result);
 
     if (ret != kIOReturnSuccess)
         return false;
 
-    setProperty("currentUUID", int3400_thermal_uuids[i]);
+    publishPolicy(i, enable);
     return true;
 }
 
+void ThermalSolution::requestMode(int i, bool enable) {
+    modeRequests++;
+    if (enable)
+        modeWanted |= BIT(i);
+    else
+        modeWanted &= ~BIT(i);
+    modePending |= BIT(i);
+
+    // Every request restarts the wait, the last state wins
+    wheel.removeContext(&modePending);
+    wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+    if (wheel.add(THERMAL_MODE_DEBOUNCE, 0, &ThermalSolution::modeAction, this, &modePending, 0) == TIMER_WHEEL_INVALID) {
+        applyModes();
+        return;
+    }
+    armWheel();
+}
+
+void ThermalSolution::modeAction(void *owner, void *context, uint32_t cookie) {
+    static_cast<ThermalSolution *>(owner)->applyModes();
+}
+
+void ThermalSolution::applyModes() {
+    uint32_t pending = modePending;
+    modePending = 0;
+
+    int last = -1;
+    while (pending) {
+        int i = __builtin_ctz(pending);
+        pending &= pending - 1;
+        bool enable = modeWanted & BIT(i);
+        // Flipped back before the wait ran out
+        if ((modeKnown & BIT(i)) && !((modeApplied ^ modeWanted) & BIT(i)))
+            continue;
+        if (!changeMode(i, enable))
+            continue;
+
+        if (enable)
+            modeApplied |= BIT(i);
+        else
+            modeApplied &= ~BIT(i);
+        modeKnown |= BIT(i);
+        modeSwitches++;
+        if (i == INT3400_THERMAL_ACTIVE && enable)
+            startCooling();
+        else if (i == INT3400_THERMAL_ACTIVE)
+            stopCooling();
+        last = i;
+        DebugLog("%s mode %s", enable ? "Enabled" : "Disabled", int3400_thermal_uuids[i]);
+    }
+    if (last < 0)
+        return;
+
+    setProperty("currentUUID", int3400_thermal_uuids[last]);
+    OSDictionary *stats = OSDictionary::withCapacity(2);
+    OSObject *value;
+    setPropertyNumber(stats, "Requests", modeRequests, 32);
+    setPropertyNumber(stats, "Switches", modeSwitches, 32);
+    setProperty("ModeScheduler", stats);
+    stats->release();
+}
+
 IOReturn ThermalSolution::message(UInt32 type, IOService *provider, void *argument) {
     switch (type) {
+        case kThermal_getTemperatures: {
+            ThermalReadings *readings = reinterpret_cast<ThermalReadings *>(argument);
+            if (!readings || (readings->capacity && !readings->readings))
+                return kIOReturnBadArgument;
+            readTemperatures(readings);
+            return readings->count < readings->total ? kIOReturnNoSpace : kIOReturnSuccess;
+        }
+
+        case kThermal_getHistory: {
+            ThermalHistory *history = reinterpret_cast<ThermalHistory *>(argument);
+            if (!history || (history->capacity && !history->samples))
+                return kIOReturnBadArgument;
+            return readHistory(history) ? kIOReturnSuccess : kIOReturnNotFound;
+        }
+
+        case kThermal_getVirtualTemperature: {
+            ThermalVirtualReading *reading = reinterpret_cast<ThermalVirtualReading *>(argument);
+            if (!reading)
+                return kIOReturnBadArgument;
+            reading->temperature = UINT32_MAX;
+            commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ThermalSolution::readVirtualGated), reading);
+            return reading->temperature == UINT32_MAX ? kIOReturnNotFound : kIOReturnSuccess;
+        }
+
         case kIOACPIMessageDeviceNotification:
             if (argument) {
                 switch (*(UInt32 *) argument) {
                     case INT3400_THERMAL_TABLE_CHANGED:
                         AlwaysLog("ACPI notification: thermal table changed");
+                        events.post(INT3400_EVENT_TABLE_CHANGED);
                         break;
 
                     case INT3400_ODVP_CHANGED:
-                        AlwaysLog("ACPI notification: ODVP changed");
-                        evaluateODVP();
+                        DebugLog("ACPI notification: ODVP changed");
+                        events.post(INT3400_EVENT_ODVP_CHANGED);
                         break;
 
                     default:
@@ -1002,39 +1324,706 @@ void ThermalSolution::setPropertiesGated(OSObject* props) {
     if (!dict)
         return;
 
+    OSString *query = OSDynamicCast(OSString, dict->getObject("GDDVQuery"));
+    if (query) {
+        OSDictionary *entries = queryGDDV(query->getCStringNoCopy());
+        DebugLog("GDDV query %s: %d entries", query->getCStringNoCopy(), entries->getCount());
+        setProperty("GDDVEntry", entries);
+        entries->release();
+        return;
+    }
+
+    // Batched read, e.g. `ioio -s ThermalSolution Temperatures 0`
+    if (dict->getObject("Temperatures")) {
+        ThermalReading buffer[THERMAL_PARTICIPANT_MAX];
+        ThermalReadings readings = {THERMAL_PARTICIPANT_MAX, 0, 0, buffer};
+        readTemperatures(&readings);
+        OSDictionary *temps = OSDictionary::withCapacity(readings.count);
+        OSObject *value;
+        for (uint32_t i = 0; i < readings.count; i++) {
+            IOService *provider = readings.readings[i].device->getProvider();
+            setPropertyTemp(temps, provider ? provider->getName() : readings.readings[i].device->getName(),
+                            acpi_deci_kelvin_to_deci_celsius(readings.readings[i].temperature));
+        }
+        setProperty("Temperatures", temps);
+        temps->release();
+        return;
+    }
+
+    // e.g. {"VirtualSensor": {"Name": "VTS1", "Mode": "Max", "Members": {"TSKN": 1, "TMEM": 1}}}
+    OSDictionary *definition = OSDynamicCast(OSDictionary, dict->getObject("VirtualSensor"));
+    if (definition) {
+        defineVirtual(definition);
+        return;
+    }
+
+    // Adaptive condition inputs, e.g. `ioio -s ThermalSolution Power_source 0`
+    bool input = false;
+    for (uint32_t i = Default + 1; i < ARRAY_SIZE(condition_names); i++) {
+        OSNumber *value = OSDynamicCast(OSNumber, dict->getObject(condition_names[i]));
+        if (value) {
+            adaptiveInputs.set(i, (int64_t)value->unsigned64BitValue());
+            input = true;
+        }
+    }
+    if (input) {
+        evaluateAdaptive();
+        return;
+    }
+
     for (int i = 0; i < INT3400_THERMAL_MAXIMUM_UUID; i++) {
         if ((dict->getObject(int3400_thermal_uuids[i]))) {
             OSBoolean *value = OSDynamicCast(OSBoolean, dict->getObject(int3400_thermal_uuids[i]));
             if (value == nullptr)
                 AlwaysLog("Invald status");
-
-            if (changeMode(i, value->getValue()))
-                DebugLog("%s mode %s", value->getValue() ? "Enabled" : "Disabled", int3400_thermal_uuids[i]);
+            else if (!(uuid_bitmap & BIT(i)))
+                AlwaysLog("Mode %s is not available", int3400_thermal_uuids[i]);
+            else
+                requestMode(i, value->getValue());
             return;
         }
     }
     AlwaysLog("Could not find known policy UUID");
 }
 
-void ThermalSolution::dispatchMessageGated(int* message, void* data)
-{
-    OSCollectionIterator* i = OSCollectionIterator::withCollection(_notificationServices);
+ThermalConsumers *ThermalConsumers::withServices(OSSet *services, IOService *owner) {
+    ThermalConsumers *set = new ThermalConsumers;
+    if (!set || !set->init()) {
+        OSSafeReleaseNULL(set);
+        return nullptr;
+    }
 
-    if (i) {
-        while (IOService* service = OSDynamicCast(IOService, i->getNextObject())) {
-            service->message(*message, this, data);
+    UInt32 capacity = services ? services->getCount() : 0;
+    if (capacity) {
+        set->consumers = reinterpret_cast<ThermalConsumer *>(IOMalloc(capacity * sizeof(ThermalConsumer)));
+        if (!set->consumers) {
+            set->release();
+            return nullptr;
+        }
+        set->capacity = capacity;
+        OSCollectionIterator *i = OSCollectionIterator::withCollection(services);
+        while (IOService *service = i ? OSDynamicCast(IOService, i->getNextObject()) : nullptr) {
+            if (set->count == capacity)
+                break;
+            ThermalConsumer consumer = {service, kThermalTypeAny, kThermalClassAll};
+            service->message(kThermal_getDeviceType, owner, &consumer.type);
+            service->message(kThermal_getSubscriptions, owner, &consumer.classes);
+            service->retain();
+
+            // Keep the consumers ordered by group, the set is small
+            UInt32 j = set->count++;
+            for (; j > 0 && group(set->consumers[j - 1].type) > group(consumer.type); j--)
+                set->consumers[j] = set->consumers[j - 1];
+            set->consumers[j] = consumer;
+            set->subscribed |= consumer.classes;
         }
-        i->release();
+        OSSafeReleaseNULL(i);
+    }
+
+    UInt32 next = 0;
+    for (UInt32 g = 0; g <= THERMAL_TYPE_GROUPS + 1; g++) {
+        while (next < set->count && group(set->consumers[next].type) < g)
+            next++;
+        set->groupStart[g] = next;
     }
+    return set;
 }
 
-void ThermalSolution::dispatchMessage(int message, void* data)
+void ThermalConsumers::free() {
+    for (UInt32 i = 0; i < count; i++)
+        consumers[i].service->release();
+    if (consumers)
+        IOFree(consumers, capacity * sizeof(ThermalConsumer));
+    consumers = nullptr;
+    capacity = 0;
+    count = 0;
+    super::free();
+}
+
+UInt32 ThermalConsumers::getGroup(UInt32 type, const ThermalConsumer **first) const {
+    if (type == kThermalTypeAny) {
+        *first = consumers;
+        return count;
+    }
+    UInt32 g = group(type);
+    *first = consumers + groupStart[g];
+    return groupStart[g + 1] - groupStart[g];
+}
+
+UInt32 ThermalConsumers::dispatch(UInt32 type, UInt32 messageClass, UInt32 message, IOService *sender, void *data) const {
+    if (!(subscribed & messageClass))
+        return 0;
+
+    const ThermalConsumer *first;
+    UInt32 n = getGroup(type, &first);
+    UInt32 delivered = 0;
+    for (UInt32 i = 0; i < n; i++) {
+        // Types past the last group share one, so filter them exactly
+        if ((type != kThermalTypeAny && first[i].type != type) || !(first[i].classes & messageClass))
+            continue;
+        first[i].service->message(message, sender, data);
+        delivered++;
+    }
+    return delivered;
+}
+
+void ThermalSolution::publishConsumers() {
+    ThermalConsumers *consumers = nullptr;
+    if (_notificationServices && !(consumers = ThermalConsumers::withServices(_notificationServices, this))) {
+        AlwaysLog("Failed to snapshot consumers");
+        return;
+    }
+
+    ThermalConsumers *old = __atomic_exchange_n(&_consumers, consumers, __ATOMIC_SEQ_CST);
+    // Readers arriving from now on count in the other slot and can only load the new snapshot.
+    // Those left in the old slot are between loading the pointer and retaining it.
+    UInt32 epoch = __atomic_fetch_add(&_consumerEpoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&_consumerReaders[epoch & 1], __ATOMIC_SEQ_CST))
+        ;
+    OSSafeReleaseNULL(old);
+}
+
+ThermalConsumers *ThermalSolution::acquireConsumers() {
+    UInt32 epoch;
+    for (;;) {
+        epoch = __atomic_load_n(&_consumerEpoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&_consumerReaders[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        // A publish that flipped meanwhile may not be waiting for this slot
+        if (__atomic_load_n(&_consumerEpoch, __ATOMIC_SEQ_CST) == epoch)
+            break;
+        __atomic_fetch_sub(&_consumerReaders[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    }
+    ThermalConsumers *consumers = __atomic_load_n(&_consumers, __ATOMIC_SEQ_CST);
+    if (consumers)
+        consumers->retain();
+    __atomic_fetch_sub(&_consumerReaders[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    return consumers;
+}
+
+static UInt32 messageClass(UInt32 message) {
+    switch (message) {
+        case kIOACPIMessageDeviceNotification:
+            return kThermalClassNotification;
+
+        case kThermal_getTemperature:
+        case kThermal_getSamplingPeriod:
+        case kThermal_setAuxTrips:
+            return kThermalClassTemperature;
+
+        case kThermal_getPowerCapability:
+        case kThermal_setPowerLimits:
+            return kThermalClassPower;
+
+        case kThermal_getActiveTrips:
+        case kThermal_setFanLevel:
+            return kThermalClassCooling;
+
+        default:
+            return kThermalClassAll;
+    }
+}
+
+void ThermalSolution::dispatchMessage(int message, void* data, UInt32 type)
 {
-    if (_notificationServices->getCount() == 0) {
-        AlwaysLog("No available notification consumer");
+    // No gate and no allocation, the snapshot is never modified once published
+    ThermalConsumers *consumers = acquireConsumers();
+    if (!consumers || !consumers->dispatch(type, messageClass(message), message, this, data))
+        DebugLog("No consumer for message %x", message);
+    OSSafeReleaseNULL(consumers);
+}
+
+void ThermalSolution::addParticipant(IOService *service) {
+    ThermalParticipant *participant = nullptr;
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX && !participant; i++)
+        if (!participants[i].service)
+            participant = &participants[i];
+    if (!participant) {
+        AlwaysLog("Too many participants, %s not tracked", service->getName());
+        return;
+    }
+
+    UInt32 type = 0, tsp = 0;
+    service->message(kThermal_getDeviceType, this, &type);
+    service->message(kThermal_getSamplingPeriod, this, &tsp);
+    participant->service = service;
+    participant->type = type;
+    participant->period = 0;
+    participant->temperature = 0;
+    publishSensor((UInt32)(participant - participants));
+
+    const ThermalPowerCapability *capability = nullptr;
+    service->message(kThermal_getPowerCapability, this, &capability);
+    if (capability && !powerParticipant)
+        startPower(participant, capability);
+
+    // _TSP of 0 means the participant notifies on its own, so it's not polled
+    if (!tsp)
+        return;
+    wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+    if (wheel.add(1, tsp, &ThermalSolution::sampleAction, this, participant, 0) == TIMER_WHEEL_INVALID) {
+        AlwaysLog("Failed to schedule sampling of %s", service->getName());
+        return;
+    }
+    participant->period = tsp;
+    participant->history = &rings[participant - participants];
+    participant->history->reset();
+    if (modeApplied & BIT(INT3400_THERMAL_ACTIVE))
+        bindCooling(participant);
+    armWheel();
+}
+
+void ThermalSolution::removeParticipant(IOService *service) {
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+        if (participants[i].service != service)
+            continue;
+        if (powerParticipant == &participants[i])
+            stopPower();
+        wheel.removeContext(&participants[i]);
+        bzero(&participants[i], sizeof(ThermalParticipant));
+        virtuals.setReading(i, 0);
+        publishSensor(i);
+    }
+}
+
+void ThermalSolution::sampleAction(void *owner, void *context, uint32_t cookie) {
+    ThermalSolution *that = static_cast<ThermalSolution *>(owner);
+    ThermalParticipant *participant = static_cast<ThermalParticipant *>(context);
+    UInt32 tmp = 0;
+    participant->service->message(kThermal_getTemperature, that, &tmp);
+    // The wheel runs on the work loop, so this is the only writer of the ring
+    UInt32 now = (UInt32)uptimeMS();
+    participant->history->push(now, tmp);
+
+    thermal_telemetry_sensor *sensor = &that->telemetry->sensors[participant - that->participants];
+    thermal_telemetry_begin(that->telemetry);
+    sensor->temperature = tmp;
+    sensor->time = now;
+    thermal_telemetry_end(that->telemetry, now);
+    that->virtuals.setReading((UInt32)(participant - that->participants), tmp);
+
+    // Ramping runs on every sample, steady readings included
+    if (participant->cooling && participant->cooling->update(tmp, now))
+        that->publishCooling(participant);
+    if (tmp == participant->temperature)
+        return;
+
+    participant->temperature = tmp;
+    if (that->adaptive.dependsOn(Temperature) || that->adaptive.dependsOn(Temperature_without_hysteresis))
+        that->evaluateAdaptive();
+}
+
+bool ThermalSolution::readHistory(UInt32 slot, ThermalSample *samples, UInt32 capacity, UInt32 *count) {
+    *count = 0;
+    // The rings outlive the participants, a slot going away mid-copy only yields stale samples
+    ReadingRing *ring = slot < THERMAL_PARTICIPANT_MAX ? participants[slot].history : nullptr;
+    if (!ring)
+        return false;
+    *count = ring->readLast(samples, capacity);
+    return true;
+}
+
+bool ThermalSolution::readHistory(ThermalHistory *history) {
+    history->count = 0;
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+        ThermalParticipant *participant = &participants[i];
+        if (participant->service != history->device || !participant->history)
+            continue;
+        history->count = participant->history->readLast(history->samples, history->capacity);
+        return true;
+    }
+    return false;
+}
+
+void ThermalSolution::startPower(ThermalParticipant *participant, const ThermalPowerCapability *capability) {
+    powerParticipant = participant;
+    powerCapability = capability;
+    // Odd never matches a finished write, so the first tick reads the ranges
+    powerSequence = 1;
+    wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+    if (wheel.add(1, THERMAL_POWER_PERIOD, &ThermalSolution::powerAction, this, &power, 0) == TIMER_WHEEL_INVALID) {
+        AlwaysLog("Failed to schedule power control");
+        stopPower();
+        return;
+    }
+    armWheel();
+}
+
+void ThermalSolution::stopPower() {
+    wheel.removeContext(&power);
+    power.configure(nullptr, 0);
+    powerParticipant = nullptr;
+    powerCapability = nullptr;
+}
+
+void ThermalSolution::powerAction(void *owner, void *context, uint32_t cookie) {
+    ThermalSolution *that = static_cast<ThermalSolution *>(owner);
+    bool changed = false;
+
+    // PPCC changes rarely, the ranges are copied again only after a rewrite
+    if (that->powerCapability->sequence != that->powerSequence) {
+        ThermalPowerLimit limits[kThermalPowerLimitMax];
+        PowerLimitRange ranges[kThermalPowerLimitMax];
+        UInt32 sequence = seqReadBegin(&that->powerCapability->sequence);
+        UInt32 count = readPowerCapability(that->powerCapability, limits);
+        for (UInt32 i = 0; i < count; i++) {
+            ranges[i].min_uw = limits[i].min_uw;
+            ranges[i].max_uw = limits[i].max_uw;
+            ranges[i].step_uw = limits[i].step_uw;
+        }
+        changed = that->power.configure(ranges, count);
+        that->powerSequence = sequence;
+    }
+
+    PowerControllerInputs inputs {};
+    ThermalParticipant *participant = that->powerParticipant;
+    UInt8 slot = (UInt8)(participant - that->participants);
+    inputs.temperature = participant->temperature;
+    if (!participant->period)
+        participant->service->message(kThermal_getTemperature, that, &inputs.temperature);
+
+    // PSVT power limit entries of the processor, ODVP reaches them through the adaptive PSVT choice.
+    // Each trip is checked against its own sensor, the controller follows the one furthest over.
+    int32_t worst = INT32_MIN;
+    for (uint32_t i = 0; i < that->passive.getEntryCount(); i++) {
+        const PassiveEntry *entry = that->passive.getEntry(i);
+        if (!isPowerLimitKnob(entry->knob) || that->passiveSources[entry->device] != slot)
+            continue;
+        UInt32 tmp = that->readPassiveSensor(entry->sensor);
+        if (tmp && (int32_t)(tmp - entry->trip) > worst) {
+            worst = (int32_t)(tmp - entry->trip);
+            inputs.temperature = tmp;
+            inputs.target = entry->trip;
+        }
+        // PSVT limits are in mW like the DataVault PPCC
+        const PassiveState *state = that->passive.getState(i);
+        uint32_t ceiling = (uint32_t)(state->value * PPCC_UNIT_SCALE);
+        if (entry->knob == kPassiveKnobPL1 && state->throttling &&
+            (!inputs.ceiling_uw || ceiling < inputs.ceiling_uw))
+            inputs.ceiling_uw = ceiling;
+    }
+
+    if (that->power.step(inputs) || changed)
+        that->publishPower();
+}
+
+void ThermalSolution::publishPower() {
+    ThermalPowerLimits limits {};
+    limits.count = power.getRangeCount();
+    for (UInt32 i = 0; i < limits.count; i++)
+        limits.limit_uw[i] = power.getLimit(i);
+    powerParticipant->service->message(kThermal_setPowerLimits, this, &limits);
+
+    UInt32 now = (UInt32)uptimeMS();
+    thermal_telemetry_begin(telemetry);
+    telemetry->limit_count = limits.count;
+    for (UInt32 i = 0; i < limits.count; i++) {
+        const PowerLimitRange *range = power.getRange(i);
+        telemetry->limits[i].min_uw = range->min_uw;
+        telemetry->limits[i].max_uw = range->max_uw;
+        telemetry->limits[i].step_uw = range->step_uw;
+        telemetry->limits[i].limit_uw = limits.limit_uw[i];
+    }
+    thermal_telemetry_end(telemetry, now);
+}
+
+void ThermalSolution::bindCooling(ThermalParticipant *participant) {
+    // Zones that are not polled would only move on notifications, leave them to the firmware
+    if (!participant->period)
+        return;
+
+    ThermalActiveTrips trips {};
+    participant->service->message(kThermal_getActiveTrips, this, &trips);
+    ActivePolicy *cooling = &coolers[participant - participants];
+    if (!cooling->configure(trips.temps, min(trips.count, kThermalActiveTripMax), trips.hysteresis))
+        return;
+    participant->cooling = cooling;
+    DebugLog("Active cooling of %s with %d levels", participant->service->getName(), cooling->getLevelCount());
+}
+
+void ThermalSolution::startCooling() {
+    // Trips are read again on every enable, so a changed _ACx is picked up by toggling DASP
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++)
+        if (participants[i].service && !participants[i].cooling)
+            bindCooling(&participants[i]);
+}
+
+void ThermalSolution::stopCooling() {
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+        if (!participants[i].cooling)
+            continue;
+        participants[i].cooling = nullptr;
+        publishCooling(&participants[i]);
+    }
+}
+
+void ThermalSolution::publishCooling(ThermalParticipant *participant) {
+    // No engine means the fan is handed back, count 0
+    ThermalFanLevel fan {};
+    fan.device = participant->service;
+    if (participant->cooling) {
+        fan.level = participant->cooling->getLevel();
+        fan.count = participant->cooling->getLevelCount();
+        fan.percent = participant->cooling->getPercent();
+    }
+    dispatchMessage(kThermal_setFanLevel, &fan);
+    DebugLog("Fan level of %s %d/%d", participant->service->getName(), fan.level, fan.count);
+
+    // Switches are rare, the summary is rebuilt on each one
+    OSArray *zones = OSArray::withCapacity(1);
+    OSObject *value;
+    for (uint32_t i = 0; i < THERMAL_PARTICIPANT_MAX; i++) {
+        const ActivePolicy *cooling = participants[i].cooling;
+        if (!cooling)
+            continue;
+        const ActivePolicyState *state = cooling->getState();
+        OSDictionary *zone = OSDictionary::withCapacity(5);
+        setPropertyString(zone, "Participant", participants[i].service->getName());
+        setPropertyNumber(zone, "Level", state->level, 32);
+        setPropertyNumber(zone, "Levels", cooling->getLevelCount(), 32);
+        setPropertyNumber(zone, "Decisions", state->decisions, 32);
+        setPropertyNumber(zone, "Switches", state->switches, 32);
+        zones->setObject(zone);
+        zone->release();
+    }
+    setProperty("ActiveCooling", zones);
+    zones->release();
+}
+
+static const char *virtual_modes[] = {
+    "Weighted",
+    "Max",
+    "Min",
+};
+
+// Weighted when left out, -1 for an unknown mode
+static int virtualMode(OSString *mode) {
+    if (!mode)
+        return kVirtualSensorWeighted;
+    for (int i = 0; i < (int)ARRAY_SIZE(virtual_modes); i++)
+        if (mode->isEqualTo(virtual_modes[i]))
+            return i;
+    return -1;
+}
+
+int ThermalSolution::findVirtual(const char *name) {
+    for (int i = 0; i < VIRTUAL_SENSOR_MAX; i++) {
+        OSString *entry = virtualDefs[i] ? OSDynamicCast(OSString, virtualDefs[i]->getObject("Name")) : nullptr;
+        if (entry && entry->isEqualTo(name))
+            return i;
+    }
+    return -1;
+}
+
+void ThermalSolution::defineVirtual(OSDictionary *definition) {
+    OSString *name = OSDynamicCast(OSString, definition->getObject("Name"));
+    OSString *mode = OSDynamicCast(OSString, definition->getObject("Mode"));
+    OSDictionary *members = OSDynamicCast(OSDictionary, definition->getObject("Members"));
+    if (!name || !name->getLength() || name->getLength() >= sizeof(ThermalVirtualReading::name)) {
+        AlwaysLog("Virtual sensor names are 1 to %lu characters", sizeof(ThermalVirtualReading::name) - 1);
         return;
     }
-    commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ThermalSolution::dispatchMessageGated), &message, data);
+
+    int i = findVirtual(name->getCStringNoCopy());
+    if (!members || !members->getCount()) {
+        // No members removes the sensor
+        if (i < 0)
+            return;
+        virtuals.remove(i);
+        OSSafeReleaseNULL(virtualDefs[i]);
+        DebugLog("Virtual sensor %s removed", name->getCStringNoCopy());
+    } else {
+        if (virtualMode(mode) < 0) {
+            AlwaysLog("Unknown virtual sensor mode %s", mode->getCStringNoCopy());
+            return;
+        }
+        if (i < 0)
+            for (i = 0; i < VIRTUAL_SENSOR_MAX && virtualDefs[i]; i++)
+                ;
+        if (i >= VIRTUAL_SENSOR_MAX) {
+            AlwaysLog("Too many virtual sensors, %s not defined", name->getCStringNoCopy());
+            return;
+        }
+        definition->retain();
+        OSSafeReleaseNULL(virtualDefs[i]);
+        virtualDefs[i] = definition;
+        DebugLog("Virtual sensor %s over %d participants", name->getCStringNoCopy(), members->getCount());
+    }
+    bindVirtual();
+    bindPassive();
+
+    // One wheel entry fuses every sensor, only while any is defined
+    wheel.removeContext(&virtuals);
+    for (int j = 0; j < VIRTUAL_SENSOR_MAX; j++) {
+        if (!virtualDefs[j])
+            continue;
+        wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+        if (wheel.add(1, THERMAL_VIRTUAL_PERIOD, &ThermalSolution::virtualAction, this, &virtuals, 0) == TIMER_WHEEL_INVALID)
+            AlwaysLog("Failed to schedule virtual sensors");
+        armWheel();
+        return;
+    }
+    publishVirtual();
+}
+
+void ThermalSolution::bindVirtual() {
+    virtualPolled = 0;
+    for (int i = 0; i < VIRTUAL_SENSOR_MAX; i++) {
+        if (!virtualDefs[i])
+            continue;
+        OSDictionary *members = OSDynamicCast(OSDictionary, virtualDefs[i]->getObject("Members"));
+        int mode = virtualMode(OSDynamicCast(OSString, virtualDefs[i]->getObject("Mode")));
+
+        // Members are named like PSVT targets, by the ACPI name of the participant
+        uint32_t weights[VIRTUAL_SENSOR_SLOTS] = {};
+        for (uint32_t j = 0; j < THERMAL_PARTICIPANT_MAX; j++) {
+            IOService *service = participants[j].service;
+            IOService *provider = service ? service->getProvider() : nullptr;
+            OSNumber *weight = provider ? OSDynamicCast(OSNumber, members->getObject(provider->getName())) : nullptr;
+            if (!weight)
+                continue;
+            weights[j] = mode == kVirtualSensorWeighted ? weight->unsigned32BitValue() : 1;
+            if (weights[j] && !participants[j].period)
+                virtualPolled |= BIT(j);
+        }
+        virtuals.define(i, mode, weights);
+    }
+}
+
+void ThermalSolution::releaseVirtual() {
+    for (int i = 0; i < VIRTUAL_SENSOR_MAX; i++) {
+        virtuals.remove(i);
+        OSSafeReleaseNULL(virtualDefs[i]);
+    }
+    virtualPolled = 0;
+}
+
+void ThermalSolution::readVirtualGated(ThermalVirtualReading *reading) {
+    // The name fills the field when it's 8 characters long
+    char name[sizeof(reading->name) + 1] = {};
+    memcpy(name, reading->name, sizeof(reading->name));
+    int i = findVirtual(name);
+    if (i >= 0)
+        reading->temperature = virtuals.getValue(i);
+}
+
+void ThermalSolution::virtualAction(void *owner, void *context, uint32_t cookie) {
+    ThermalSolution *that = static_cast<ThermalSolution *>(owner);
+    // Sampled members are already current, the others are read once for all sensors
+    uint32_t polled = that->virtualPolled;
+    while (polled) {
+        uint32_t j = __builtin_ctz(polled);
+        polled &= polled - 1;
+        UInt32 tmp = 0;
+        that->participants[j].service->message(kThermal_getTemperature, that, &tmp);
+        that->virtuals.setReading(j, tmp);
+    }
+    if (that->virtuals.update())
+        that->publishVirtual();
+}
+
+void ThermalSolution::publishVirtual() {
+    OSDictionary *sensors = OSDictionary::withCapacity(VIRTUAL_SENSOR_MAX);
+    OSObject *value;
+    for (int i = 0; i < VIRTUAL_SENSOR_MAX; i++) {
+        OSString *name = virtualDefs[i] ? OSDynamicCast(OSString, virtualDefs[i]->getObject("Name")) : nullptr;
+        SInt32 temp = (SInt32)virtuals.getValue(i);
+        if (!name || !temp)
+            continue;
+        temp = acpi_deci_kelvin_to_deci_celsius(temp);
+        setPropertyTemp(sensors, name->getCStringNoCopy(), temp);
+    }
+    setProperty("VirtualSensors", sensors);
+    sensors->release();
+}
+
+void ThermalSolution::publishSensor(UInt32 slot) {
+    ThermalParticipant *participant = &participants[slot];
+    thermal_telemetry_sensor *sensor = &telemetry->sensors[slot];
+    UInt32 now = (UInt32)uptimeMS();
+
+    thermal_telemetry_begin(telemetry);
+    bzero(sensor, sizeof(thermal_telemetry_sensor));
+    if (participant->service) {
+        IOService *provider = participant->service->getProvider();
+        strlcpy(sensor->name, provider ? provider->getName() : participant->service->getName(), sizeof(sensor->name));
+        sensor->type = participant->type;
+        sensor->temperature = participant->temperature;
+    }
+    thermal_telemetry_end(telemetry, now);
+}
+
+void ThermalSolution::publishODVP(OSArray *package) {
+    thermal_telemetry_begin(telemetry);
+    telemetry->odvp_count = min(package->getCount(), THERMAL_TELEMETRY_ODVP);
+    for (uint32_t i = 0; i < THERMAL_TELEMETRY_ODVP; i++) {
+        OSNumber *odvp = i < telemetry->odvp_count ? OSDynamicCast(OSNumber, package->getObject(i)) : nullptr;
+        telemetry->odvp[i] = odvp ? odvp->unsigned32BitValue() : 0;
+    }
+    thermal_telemetry_end(telemetry, (UInt32)uptimeMS());
+}
+
+void ThermalSolution::publishPolicy(int i, bool enable) {
+    thermal_telemetry_begin(telemetry);
+    if (enable)
+        guidToUUID(&int3400_thermal_guids[i], telemetry->policy);
+    else
+        bzero(telemetry->policy, sizeof(telemetry->policy));
+    thermal_telemetry_end(telemetry, (UInt32)uptimeMS());
+}
+
+void ThermalSolution::publishLimits(const PPCCTable *ppcc) {
+    // The processor's own PPCC takes over once the power controller runs
+    if (power.getRangeCount())
+        return;
+
+    thermal_telemetry_limit *limit = &telemetry->limits[0];
+    thermal_telemetry_begin(telemetry);
+    limit->min_uw = (uint32_t)(ppcc->power_limit_min * PPCC_UNIT_SCALE);
+    limit->max_uw = (uint32_t)(ppcc->power_limit_max * PPCC_UNIT_SCALE);
+    limit->tmin_us = (uint32_t)(ppcc->time_wind_min * PPCC_UNIT_SCALE);
+    limit->tmax_us = (uint32_t)(ppcc->time_wind_max * PPCC_UNIT_SCALE);
+    limit->step_uw = (uint32_t)(ppcc->step_size * PPCC_UNIT_SCALE);
+    telemetry->limit_count = 1;
+    thermal_telemetry_end(telemetry, (UInt32)uptimeMS());
+}
+
+void ThermalSolution::readTemperatures(ThermalReadings *readings) {
+    readings->count = 0;
+    readings->total = 0;
+    ThermalConsumers *consumers = acquireConsumers();
+    if (!consumers)
+        return;
+
+    const ThermalConsumer *sensors;
+    UInt32 n = consumers->getGroup(INT3403_TYPE_SENSOR, &sensors);
+    for (UInt32 i = 0; i < n; i++) {
+        if (readings->count < readings->capacity) {
+            ThermalReading *reading = &readings->readings[readings->count++];
+            reading->device = sensors[i].service;
+            reading->type = sensors[i].type;
+            reading->temperature = 0;
+            sensors[i].service->message(kThermal_getTemperature, this, &reading->temperature);
+        }
+        readings->total++;
+    }
+    consumers->release();
+}
+
+void ThermalSolution::tickWheel(IOTimerEventSource *sender) {
+    wheel.advance(uptimeMS() / THERMAL_WHEEL_TICK_MS);
+    armWheel();
+}
+
+void ThermalSolution::armWheel() {
+    uint64_t next = wheel.nextExpiry();
+    if (next == UINT64_MAX) {
+        wheelTimer->cancelTimeout();
+        return;
+    }
+
+    uint64_t now = uptimeMS();
+    next *= THERMAL_WHEEL_TICK_MS;
+    wheelTimer->setTimeoutMS((UInt32)(next > now ? next - now : 1));
 }
 
 void ThermalSolution::notificationHandlerGated(IOService *newService, IONotifier *notifier)
@@ -1042,16 +2031,19 @@ void ThermalSolution::notificationHandlerGated(IOService *newService, IONotifier
     if (notifier == _publishNotify) {
         DebugLog("Notification consumer published: %s", newService->getName());
         _notificationServices->setObject(newService);
-        UInt32 type;
-        newService->message(kThermal_getDeviceType, this, &type);
-        if (type == INT3400_THERMAL_VIRTUAL_SENSOR)
-            DebugLog("Sensor consumer published: %s", newService->getName());
+        addParticipant(newService);
     }
 
     if (notifier == _terminateNotify) {
         DebugLog("Notification consumer terminated: %s", newService->getName());
+        removeParticipant(newService);
         _notificationServices->removeObject(newService);
     }
+    publishConsumers();
+    bindVirtual();
+    bindPassive();
+    bindAdaptive();
+    evaluateAdaptive();
 }
 
 bool ThermalSolution::notificationHandler(void *refCon, IOService *newService, IONotifier *notifier)
@@ -10,11 +10,24 @@
 #ifndef ThermalSolution_hpp
 #define ThermalSolution_hpp
 
+#include <IOKit/IOBufferMemoryDescriptor.h>
 #include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
 #include <IOKit/IOService.h>
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
 #include "common.h"
+#include "ActivePolicy.hpp"
+#include "AdaptivePolicy.hpp"
+#include "DataVault.hpp"
+#include "EventQueue.hpp"
+#include "PassivePolicy.hpp"
+#include "PowerController.hpp"
+#include "ReadingRing.hpp"
+#include "ThermalTelemetry.h"
+#include "TimerWheel.hpp"
 #include "ThermalZone.hpp"
+#include "UTF16.hpp"
+#include "VirtualSensor.hpp"
 
 #define DPTF_OSC_REVISION 1
 
@@ -37,6 +50,9 @@
 #define INT3400_THERMAL_TABLE_CHANGED 0x83
 #define INT3400_ODVP_CHANGED 0x88
 
+#define INT3400_EVENT_TABLE_CHANGED BIT(0)
+#define INT3400_EVENT_ODVP_CHANGED  BIT(1)
+
 enum int3400_thermal_uuid {
     INT3400_THERMAL_PASSIVE_1,
     INT3400_THERMAL_ACTIVE,
@@ -66,6 +82,48 @@ static const char *int3400_thermal_uuids[INT3400_THERMAL_MAXIMUM_UUID] = {
     "0e56fab6-bdfc-4e8c-8246-40ecfd4d74ea",     // DA2P
 };
 
+// The same GUIDs in the mixed-endian byte order of IDSP and _OSC, loaded as two
+// little-endian words so an IDSP entry matches with two compares
+struct int3400_guid {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+#define INT3400_GUID(a, b, c, d, e) { \
+    ((uint64_t)(c) << 48) | ((uint64_t)(b) << 32) | (uint64_t)(a), \
+    __builtin_bswap64(((uint64_t)(d) << 48) | (uint64_t)(e)) }
+
+static const int3400_guid int3400_thermal_guids[INT3400_THERMAL_MAXIMUM_UUID] = {
+    INT3400_GUID(0x42A441D6, 0xAE6A, 0x462B, 0xA84B, 0x4A8CE79027D3), // DPSP
+    INT3400_GUID(0x3A95C389, 0xE4B8, 0x4629, 0xA526, 0xC52C88626BAE), // DASP
+    INT3400_GUID(0x97C68AE7, 0x15FA, 0x499C, 0xB8C9, 0x5DA81D606E0A), // DCSP
+    INT3400_GUID(0x63BE270F, 0x1C11, 0x48FD, 0xA6F7, 0x3AF253FF3E2D), // DAPP
+    INT3400_GUID(0x5349962F, 0x71E6, 0x431D, 0x9AE8, 0x0A635B710AEE),
+    INT3400_GUID(0x9E04115A, 0xAE87, 0x4D1C, 0x9500, 0x0F3E340BFE75), // DP2P
+    INT3400_GUID(0xF5A35014, 0xC209, 0x46A4, 0x993A, 0xEB56DE7530A1), // POBP
+    INT3400_GUID(0x6ED722A7, 0x9240, 0x48A5, 0xB479, 0x31EEF723D7CF), // DVSP
+    INT3400_GUID(0x16CAF1B7, 0xDD38, 0x40ED, 0xB1C1, 0x1B8A1913D531), // DMSP
+    INT3400_GUID(0xBE84BABF, 0xC4D4, 0x403D, 0xB495, 0x3128FD44DAC1), // HDCP
+    INT3400_GUID(0x0E56FAB6, 0xBDFC, 0x4E8C, 0x8246, 0x40ECFD4D74EA), // DA2P
+};
+
+static const char *int3400_thermal_names[INT3400_THERMAL_MAXIMUM_UUID] = {
+    "INT3400_THERMAL_PASSIVE_1",
+    "INT3400_THERMAL_ACTIVE",
+    "INT3400_THERMAL_CRITICAL",
+    "INT3400_THERMAL_ADAPTIVE_PERFORMANCE",
+    "INT3400_THERMAL_EMERGENCY_CALL_MODE",
+    "INT3400_THERMAL_PASSIVE_2",
+    "INT3400_THERMAL_POWER_BOSS",
+    "INT3400_THERMAL_VIRTUAL_SENSOR",
+    "INT3400_THERMAL_COOLING_MODE",
+    "INT3400_THERMAL_HARDWARE_DUTY_CYCLING",
+    "INT3400_THERMAL_ACTIVE_2",
+};
+
+// Unrecognized IDSP entries kept for the Available Mode property
+#define INT3400_UNKNOWN_UUID_MAX 16
+
 // 42496e14-bc1b-46e8-a798-ca915464426f // DPID
 // a01dbc39-a15a-4915-a215-9324b4c03366 // DGPS
 // b9455b06-7949-40c6-abf2-363a70c8706c // LPSP
@@ -73,65 +131,6 @@ static const char *int3400_thermal_uuids[INT3400_THERMAL_MAXIMUM_UUID] = {
 
 // from intel/thermal_daemon/src/thd_engine_adaptive.h
 
-enum adaptive_condition {
-    Default = 0x01,
-    Orientation,
-    Proximity,
-    Motion,
-    Dock,
-    Workload,
-    Cooling_mode,
-    Power_source,
-    Aggregate_power_percentage,
-    Lid_state,
-    Platform_type,
-    Platform_SKU,
-    Utilisation,
-    TDP,
-    Duty_cycle,
-    Power,
-    Temperature,
-    Display_orientation,
-    Oem0,
-    Oem1,
-    Oem2,
-    Oem3,
-    Oem4,
-    Oem5,
-    PMAX,
-    PSRC,
-    ARTG,
-    CTYP,
-    PROP,
-    Unk1,
-    Unk2,
-    Battery_state,
-    Battery_rate,
-    Battery_remaining,
-    Battery_voltage,
-    PBSS,
-    Battery_cycles,
-    Battery_last_full,
-    Power_personality,
-    Battery_design_capacity,
-    Screen_state,
-    AVOL,
-    ACUR,
-    AP01,
-    AP02,
-    AP10,
-    Time,
-    Temperature_without_hysteresis,
-    Mixed_reality,
-    User_presence,
-    RBHF,
-    VBNL,
-    CMPP,
-    Battery_percentage,
-    Battery_count,
-    Power_slider
-};
-
 static const char *condition_names[] = {
         "Invalid",
         "Default",
@@ -199,113 +198,76 @@ static const char *comp_strs[] = {
         "ADAPTIVE_GREATER_OR_EQUAL"
 };
 
-enum adaptive_operation {
-    AND = 0x01,
-    FOR
+// _TSP and PSVT sample_period are in tenths of a second
+#define THERMAL_WHEEL_TICK_MS 100
+// Power limits are revisited every second, well above the PPCC time windows
+#define THERMAL_POWER_PERIOD 10
+
+// Virtual sensors are fused once a second
+#define THERMAL_VIRTUAL_PERIOD 10
+
+// Policy switches wait for requests to settle, so a flip and its revert never reach _OSC
+#define THERMAL_MODE_DEBOUNCE 5
+
+// One telemetry slot per participant
+#define THERMAL_PARTICIPANT_MAX THERMAL_TELEMETRY_SENSORS
+static_assert(THERMAL_PARTICIPANT_MAX == VIRTUAL_SENSOR_SLOTS, "virtual sensors fuse one lane per participant slot");
+
+struct ThermalParticipant {
+    IOService *service;
+    UInt32 type;
+    UInt32 period;          // _TSP, wheel ticks
+    UInt32 temperature;     // last sample, deci-Kelvin
+    ReadingRing *history;   // every sample, sampled participants only
+    ActivePolicy *cooling;  // _ACx engine while DASP is on, sampled zones with active trips only
 };
 
-enum adaptive_comparison {
-    ADAPTIVE_EQUAL = 0x01,
-    ADAPTIVE_LESSER_OR_EQUAL,
-    ADAPTIVE_GREATER_OR_EQUAL,
+// Device types below this get a dispatch group of their own, the rest share one
+#define THERMAL_TYPE_GROUPS 64
+#define kThermalTypeAny 0xFFFFFFFF
+
+struct ThermalConsumer {
+    IOService *service;
+    UInt32 type;            // kThermal_getDeviceType
+    UInt32 classes;         // kThermal_getSubscriptions
 };
 
-// From Common/esif_sdk_iface_esif.h:
-#define ESIF_SERVICE_CONFIG_COMPRESSED  0x40000000/* Payload is Compressed */
-//From ESIF/Products/ESIF_LIB/Sources/esif_lib_datavault.c
-#define ESIFDV_HEADER_SIGNATURE            0x1FE5
-#define ESIFDV_ITEM_KEYS_REV0_SIGNATURE    0xA0D8
-
-/* From esif_lilb_datavault.h */
-#define ESIFDV_NAME_LEN                32    // Max DataVault Name (Cache Name) Length (not including NULL)
-#define ESIFDV_DESC_LEN                64    // Max DataVault Description Length (not including NULL)
-
-#define SHA256_HASH_BYTES            32
-
-typedef struct __attribute__ ((packed)) {
-    uint16_t signature;
-    uint16_t headersize;
-    union {
-        uint32_t raw;
-        struct {
-            uint16_t revision;
-            uint8_t  minor;
-            uint8_t  major;
-        };
-    } version;
-    union {
-        /* Added in V1 */
-        struct {
-            uint32_t flags;
-        } v1;
-
-        /* Added in V2 */
-        struct {
-            uint32_t flags;
-            char     segmentid[ESIFDV_NAME_LEN];
-            char     comment[ESIFDV_DESC_LEN];
-            uint8_t  payload_hash[SHA256_HASH_BYTES];
-            uint32_t payload_size;
-            uint32_t payload_class;
-        } v2;
-    };
-} GDDVHeader;
-
-typedef struct __attribute__ ((packed)) {
-    uint32_t flag;
-    uint32_t length;
-} GDDVKeyHeader;
-
-/* From esif_sdk_data_type.h */
-typedef enum esif_data_type {
-    ESIF_DATA_ANGLE = 41,
-    ESIF_DATA_AUTO = 36,
-    ESIF_DATA_BINARY = 7,
-    ESIF_DATA_BLOB = 34,
-    ESIF_DATA_DECIBEL = 39,
-    ESIF_DATA_DSP = 33,
-    ESIF_DATA_ENUM = 19,
-    ESIF_DATA_FREQUENCY = 40,
-    ESIF_DATA_GUID = 5,
-    ESIF_DATA_HANDLE = 20,
-    ESIF_DATA_INSTANCE = 30,
-    ESIF_DATA_INT16 = 12,
-    ESIF_DATA_INT32 = 13,
-    ESIF_DATA_INT64 = 14,
-    ESIF_DATA_INT8 = 11,
-    ESIF_DATA_IPV4 = 16,
-    ESIF_DATA_IPV6 = 17,
-    ESIF_DATA_JSON = 42,
-    ESIF_DATA_PERCENT = 29,
-    ESIF_DATA_POINTER = 18,
-    ESIF_DATA_POWER = 26,
-    ESIF_DATA_QUALIFIER = 28,
-    ESIF_DATA_REGISTER = 15,
-    ESIF_DATA_STRING = 8,
-    ESIF_DATA_STRUCTURE = 32,
-    ESIF_DATA_TABLE = 35,
-    ESIF_DATA_TEMPERATURE = 6,
-    ESIF_DATA_TIME = 31,
-    ESIF_DATA_UINT16 = 2,
-    ESIF_DATA_UINT32 = 3,
-    ESIF_DATA_UINT64 = 4,
-    ESIF_DATA_UINT8 = 1,
-    ESIF_DATA_UNICODE = 9,
-    ESIF_DATA_VOID = 24,
-    ESIF_DATA_XML = 38,
-} esif_data_type_t;
-
-typedef struct __attribute__ ((packed)) {
-    uint32_t type;
-    uint64_t value;
-} uint64Container;
-
-typedef struct __attribute__ ((packed)) {
-    uint32_t type;
-    uint64_t length;
-    uuid_t guid;
-} guidContainer;
+// Immutable set of consumers grouped by device type, replaced as a whole on change
+class ThermalConsumers : public OSObject {
+    typedef OSObject super;
+    OSDeclareDefaultStructors(ThermalConsumers)
 
+    ThermalConsumer *consumers {nullptr};
+    UInt32 capacity {0};
+    UInt32 count {0};
+    UInt32 subscribed {0};
+    // Consumers of group g are [groupStart[g], groupStart[g + 1])
+    UInt16 groupStart[THERMAL_TYPE_GROUPS + 2] {};
+
+    static UInt32 group(UInt32 type) { return type < THERMAL_TYPE_GROUPS ? type : THERMAL_TYPE_GROUPS; };
+
+public:
+    static ThermalConsumers *withServices(OSSet *services, IOService *owner);
+    void free() APPLE_KEXT_OVERRIDE;
+
+    UInt32 getCount() const { return count; };
+
+    /**
+     * Consumers of a device type
+     * @param type Device type, kThermalTypeAny for all
+     * @param first Set to the first consumer
+     *
+     * @return Number of consumers starting at first
+     */
+    UInt32 getGroup(UInt32 type, const ThermalConsumer **first) const;
+
+    /**
+     * Deliver a message to the consumers of a type subscribed to its class
+     *
+     * @return Number of consumers messaged
+     */
+    UInt32 dispatch(UInt32 type, UInt32 messageClass, UInt32 message, IOService *sender, void *data) const;
+};
 
 class ThermalSolution : public IOService {
     typedef IOService super;
@@ -323,17 +285,61 @@ class ThermalSolution : public IOService {
     OSDictionary* _SensorServices {nullptr};
     const OSSymbol* _deliverNotification {nullptr};
 
-    void dispatchMessage(int message, void* data);
-    void dispatchMessageGated(int* message, void* data);
+    // Immutable snapshot of _notificationServices for dispatch, replaced as a whole
+    ThermalConsumers *_consumers {nullptr};
+    // Readers count themselves in the slot of the epoch they saw, a publish flips the epoch
+    // and only waits for the slot of the previous one
+    volatile SInt32 _consumerReaders[2] {};
+    volatile UInt32 _consumerEpoch {0};
+    void publishConsumers();
+    ThermalConsumers *acquireConsumers();
+
+    void dispatchMessage(int message, void* data, UInt32 type=kThermalTypeAny);
     bool notificationHandler(void * refCon, IOService * newService, IONotifier * notifier);
     void notificationHandlerGated(IOService * newService, IONotifier * notifier);
 
+    ThermalParticipant participants[THERMAL_PARTICIPANT_MAX] {};
+    void addParticipant(IOService *service);
+    void removeParticipant(IOService *service);
+    static void sampleAction(void *owner, void *context, uint32_t cookie);
+    void readTemperatures(ThermalReadings *readings);
+
+    // One ring per participant slot, cache-line aligned
+    ReadingRing *rings {nullptr};
+    bool readHistory(ThermalHistory *history);
+
+    // One hardware timer for every periodic sampler
+    TimerWheel wheel;
+    IOTimerEventSource *wheelTimer {nullptr};
+    void tickWheel(IOTimerEventSource *sender);
+    void armWheel();
+
     bool evaluateAvailableMode();
     uint32_t uuid_bitmap {0};
     bool changeMode(int i, bool enable);
 
+    // _OSC arguments built once, the GUID and capabilities are rewritten in place
+    int3400_guid oscGuid;
+    UInt32 oscCaps[2];
+    OSObject *oscParams[4] {};
+    bool initOSC();
+    void releaseOSC();
+
+    // Requested policy states settle for THERMAL_MODE_DEBOUNCE before _OSC runs
+    uint32_t modeWanted {0};
+    uint32_t modeApplied {0};
+    uint32_t modeKnown {0};
+    uint32_t modePending {0};
+    uint32_t modeRequests {0};
+    uint32_t modeSwitches {0};
+    void requestMode(int i, bool enable);
+    void applyModes();
+    static void modeAction(void *owner, void *context, uint32_t cookie);
+
+    friend class GDDVSegmentDescriber;
+
     OSDictionary *parsePath(OSDictionary *entry, const char *&path);
-    
+
     OSDictionary *parseAPAT(const void *data, uint32_t length);
     OSDictionary *parseAPCT(const void *data, uint32_t length);
     OSDictionary *parseAPPC(const void *data, uint32_t length);
@@ -342,11 +348,89 @@ class ThermalSolution : public IOService {
     OSDictionary *parseIDSP(const void *data, uint32_t length);
     OSDictionary *parseBinary(const void *data, uint32_t length);
 
+    void parseSegment(const DataVaultSegment &segment);
+    void parseKey(OSDictionary *entries, const DataVaultKey &key);
+
+    OSData *gddv {nullptr};
+    DataVaultCache gddvCache;
+    OSDictionary *queryGDDV(const char *path);
+
     bool evaluateGDDV();
     bool evaluateODVP();
+    void evaluateTablesGated();
+
+    // Deferred work for ACPI notifications
+    EventQueue events;
+    void handleEvents(IOTimerEventSource *sender);
+
+    AdaptivePolicy adaptive;
+    AdaptiveInputs adaptiveInputs;
+    uint64_t adaptiveTarget {ADAPTIVE_NO_TARGET};
+    // Participant slot of each APCT device, THERMAL_PARTICIPANT_MAX for none
+    UInt8 adaptiveParticipants[ADAPTIVE_DEVICE_MAX];
+    uint64_t adaptiveDue {UINT64_MAX};
+    bool findTable(int table, DataVaultKey *key);
+    int findParticipant(const char *path);
+    void compileAdaptive();
+    void bindAdaptive();
+    void evaluateAdaptive();
+    static void adaptiveAction(void *owner, void *context, uint32_t cookie);
+
+    PassivePolicy passive;
+    IOService **passiveSensors {nullptr};
+    // Virtual sensor of a PSVT target with no participant, VIRTUAL_SENSOR_MAX for none
+    UInt8 *passiveVirtual {nullptr};
+    uint32_t passiveSensorCount {0};
+    // Participant slot of each PSVT source, THERMAL_PARTICIPANT_MAX for none
+    UInt8 *passiveSources {nullptr};
+    uint32_t passiveSourceCount {0};
+    void compilePassive();
+    void bindPassive();
+    UInt32 readPassiveSensor(uint32_t sensor);
+    void releasePassive();
+    void publishPassive();
+    static void passiveAction(void *owner, void *context, uint32_t cookie);
+
+    // PL1/PL2 of the processor participant, steered toward the PSVT trip of the power knobs
+    PowerController power;
+    const ThermalPowerCapability *powerCapability {nullptr};
+    ThermalParticipant *powerParticipant {nullptr};
+    UInt32 powerSequence {0};
+    void startPower(ThermalParticipant *participant, const ThermalPowerCapability *capability);
+    void stopPower();
+    static void powerAction(void *owner, void *context, uint32_t cookie);
+    void publishPower();
+
+    // One active cooling engine per participant slot, bound while DASP is applied
+    ActivePolicy *coolers {nullptr};
+    void bindCooling(ThermalParticipant *participant);
+    void startCooling();
+    void stopCooling();
+    void publishCooling(ThermalParticipant *participant);
+
+    // Weighted or max/min combinations of participants, defined through setProperties
+    VirtualSensors virtuals;
+    OSDictionary *virtualDefs[VIRTUAL_SENSOR_MAX] {};
+    // Member slots that are not sampled, read before each fusion
+    uint32_t virtualPolled {0};
+    int findVirtual(const char *name);
+    void defineVirtual(OSDictionary *definition);
+    void bindVirtual();
+    void releaseVirtual();
+    void readVirtualGated(ThermalVirtualReading *reading);
+    static void virtualAction(void *owner, void *context, uint32_t cookie);
+    void publishVirtual();
 
     ThermalZone *tz {nullptr};
 
+    // Shared with user clients, only written on the work loop
+    IOBufferMemoryDescriptor *telemetryBuffer {nullptr};
+    thermal_telemetry *telemetry {nullptr};
+    void publishSensor(UInt32 slot);
+    void publishODVP(OSArray *package);
+    void publishPolicy(int i, bool enable);
+    void publishLimits(const PPCCTable *ppcc);
+
     void setPropertiesGated(OSObject* props);
 
 public:
@@ -355,5 +439,16 @@ public:
 
     IOReturn message(UInt32 type, IOService *provider, void *argument) APPLE_KEXT_OVERRIDE;
     IOReturn setProperties(OSObject *props) APPLE_KEXT_OVERRIDE;
+
+    IOMemoryDescriptor *getTelemetry() { return telemetryBuffer; };
+
+    /**
+     * Copy the last samples of a participant slot, without blocking the sampler
+     * @param slot Index of the participant, as in the telemetry sensors
+     * @param count Samples copied, oldest first
+     *
+     * @return false if the slot is not sampled
+     */
+    bool readHistory(UInt32 slot, ThermalSample *samples, UInt32 capacity, UInt32 *count);
 };
 #endif /* DPTFSolution_hpp */
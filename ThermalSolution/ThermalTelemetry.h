@@ -0,0 +1,106 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ThermalTelemetry.h
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Layout of the telemetry page ThermalSolution shares with user space. Map
+//  it with IOConnectMapMemory64(connect, kThermalTelemetryMemory, ...) on a
+//  connection to ThermalSolution and copy it out with thermal_telemetry_read.
+//  Recent samples of a sensor slot are copied with kThermalMethodGetHistory.
+//  Plain C so clients can include it as is.
+//
+
+#ifndef ThermalTelemetry_h
+#define ThermalTelemetry_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define kThermalTelemetryMemory     0
+
+// IOConnectCallMethod selectors
+enum {
+    // scalar in: sensor slot, struct out: thermal_history_sample array, oldest first
+    kThermalMethodGetHistory = 0,
+    kThermalMethodCount
+};
+#define THERMAL_TELEMETRY_VERSION   1
+
+#define THERMAL_TELEMETRY_SENSORS   32
+#define THERMAL_TELEMETRY_ODVP      16
+#define THERMAL_TELEMETRY_LIMITS    2
+
+struct thermal_telemetry_sensor {
+    char name[8];           // ACPI name of the participant, empty for a free slot
+    uint32_t type;          // PTYP
+    uint32_t temperature;   // deci-Kelvin, 0 until sampled
+    uint32_t time;          // uptime in ms of the sample, truncated
+};
+
+struct thermal_history_sample {
+    uint32_t time;          // uptime in ms, truncated
+    uint32_t temperature;   // deci-Kelvin
+};
+
+struct thermal_telemetry_limit {
+    uint32_t min_uw;
+    uint32_t max_uw;
+    uint32_t tmin_us;
+    uint32_t tmax_us;
+    uint32_t step_uw;
+    uint32_t limit_uw;      // programmed limit, 0 if none
+};
+
+struct thermal_telemetry {
+    uint32_t version;       // THERMAL_TELEMETRY_VERSION
+    uint32_t size;          // sizeof(struct thermal_telemetry)
+    // Odd while the kext is writing, bumped twice per update
+    volatile uint32_t sequence;
+    uint32_t time;          // uptime in ms of the last update, truncated
+
+    uint8_t policy[16];     // _OSC UUID of the active policy, all zero if none
+    uint32_t odvp_count;
+    uint32_t limit_count;
+    uint32_t odvp[THERMAL_TELEMETRY_ODVP];
+    struct thermal_telemetry_limit limits[THERMAL_TELEMETRY_LIMITS];
+    struct thermal_telemetry_sensor sensors[THERMAL_TELEMETRY_SENSORS];
+};
+
+// Writer side, the kext only ever updates from its work loop
+
+static inline void thermal_telemetry_begin(struct thermal_telemetry *t)
+{
+    __atomic_store_n(&t->sequence, t->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void thermal_telemetry_end(struct thermal_telemetry *t, uint32_t time)
+{
+    t->time = time;
+    __atomic_store_n(&t->sequence, t->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copy a consistent snapshot, retrying while an update is in progress
+ * @param page Mapped telemetry page
+ * @param copy Snapshot
+ *
+ * @return Sequence number of the snapshot, compare to skip unchanged pages
+ */
+static inline uint32_t thermal_telemetry_read(const struct thermal_telemetry *page, struct thermal_telemetry *copy)
+{
+    uint32_t begin, end;
+    do {
+        while ((begin = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE)) & 1)
+            ;
+        memcpy(copy, (const void *)page, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    } while (begin != end);
+    return begin;
+}
+
+#endif /* ThermalTelemetry_h */
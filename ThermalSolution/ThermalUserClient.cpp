@@ -0,0 +1,67 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ThermalUserClient.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include "ThermalUserClient.hpp"
+
+OSDefineMetaClassAndStructors(ThermalUserClient, IOUserClient)
+
+bool ThermalUserClient::start(IOService *provider) {
+    if (!super::start(provider) || !(owner = OSDynamicCast(ThermalSolution, provider)))
+        return false;
+    return true;
+}
+
+IOReturn ThermalUserClient::clientClose() {
+    if (!isInactive())
+        terminate();
+    return kIOReturnSuccess;
+}
+
+IOReturn ThermalUserClient::clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) {
+    if (type != kThermalTelemetryMemory)
+        return kIOReturnUnsupported;
+
+    IOMemoryDescriptor *telemetry = owner->getTelemetry();
+    if (!telemetry)
+        return kIOReturnNotReady;
+
+    // Ownership of the reference passes to the caller
+    telemetry->retain();
+    *options = kIOMapReadOnly;
+    *memory = telemetry;
+    return kIOReturnSuccess;
+}
+
+static_assert(sizeof(thermal_history_sample) == sizeof(ThermalSample), "history samples are copied as is");
+
+const IOExternalMethodDispatch ThermalUserClient::methods[kThermalMethodCount] = {
+    {   // kThermalMethodGetHistory
+        reinterpret_cast<IOExternalMethodAction>(&ThermalUserClient::getHistory), 1, 0, 0, kIOUCVariableStructureSize
+    },
+};
+
+IOReturn ThermalUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch,
+                                           OSObject *target, void *reference) {
+    if (selector >= kThermalMethodCount)
+        return kIOReturnUnsupported;
+    return super::externalMethod(selector, arguments, const_cast<IOExternalMethodDispatch *>(&methods[selector]), this, reference);
+}
+
+IOReturn ThermalUserClient::getHistory(ThermalUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    // A full ring is well under a page, so it always comes back in the inline output
+    if (!arguments->structureOutput)
+        return kIOReturnBadArgument;
+    UInt32 capacity = min(arguments->structureOutputSize / (UInt32)sizeof(ThermalSample), READING_RING_SIZE);
+    UInt32 count;
+    if (!target->owner->readHistory((UInt32)arguments->scalarInput[0],
+                                    reinterpret_cast<ThermalSample *>(arguments->structureOutput), capacity, &count))
+        return kIOReturnNotFound;
+    arguments->structureOutputSize = count * sizeof(ThermalSample);
+    return kIOReturnSuccess;
+}
@@ -0,0 +1,37 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  ThermalUserClient.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Connection to ThermalSolution that maps the telemetry page read-only, so
+//  monitors can poll it without a call into the kext, and copies the sample
+//  history of a sensor slot on request.
+//
+
+#ifndef ThermalUserClient_hpp
+#define ThermalUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+#include "ThermalSolution.hpp"
+
+class ThermalUserClient : public IOUserClient {
+    typedef IOUserClient super;
+    OSDeclareDefaultStructors(ThermalUserClient)
+
+    ThermalSolution *owner {nullptr};
+
+    // Indexed by selector
+    static const IOExternalMethodDispatch methods[kThermalMethodCount];
+    static IOReturn getHistory(ThermalUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+
+public:
+    bool start(IOService *provider) APPLE_KEXT_OVERRIDE;
+    IOReturn clientClose() APPLE_KEXT_OVERRIDE;
+    IOReturn clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) APPLE_KEXT_OVERRIDE;
+    IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch,
+                            OSObject *target, void *reference) APPLE_KEXT_OVERRIDE;
+};
+#endif /* ThermalUserClient_hpp */
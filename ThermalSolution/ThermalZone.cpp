@@ -11,7 +11,7 @@
 
 IOReturn ThermalZone::getZoneTemp(UInt32 *temp) {
     UInt32 tmp;
-    IOReturn ret = dev->evaluateInteger("_TMP", &tmp);
+    IOReturn ret = readTemperature(&tmp);
 
     if (ret == kIOReturnSuccess)
         *temp = acpi_deci_kelvin_to_deci_celsius(tmp);
@@ -19,19 +19,105 @@ IOReturn ThermalZone::getZoneTemp(UInt32 *temp) {
     return ret;
 }
 
+IOReturn ThermalZone::readTemperature(UInt32 *temp) {
+    UInt32 now = (UInt32)uptimeMS();
+    uint64_t entry = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+
+    // Wrapping subtraction keeps the age right across the 32-bit rollover
+    if ((UInt32)entry && now - (UInt32)(entry >> 32) < maxAge) {
+        __atomic_fetch_add(&cacheHits, 1, __ATOMIC_RELAXED);
+        *temp = (UInt32)entry;
+        return kIOReturnSuccess;
+    }
+
+    __atomic_fetch_add(&cacheMisses, 1, __ATOMIC_RELAXED);
+    UInt32 tmp;
+    IOReturn ret = dev->evaluateInteger("_TMP", &tmp);
+    if (ret != kIOReturnSuccess)
+        return ret;
+
+    // LPAT gives deci-Celsius, as in linux int340x_thermal_zone, cached values stay in deci-Kelvin
+    if (lpat) {
+        int32_t conv;
+        if (!lpat->convert((int32_t)tmp, &conv))
+            return kIOReturnNotFound;
+        tmp = acpi_deci_celsius_to_deci_kelvin(conv);
+    }
+
+    __atomic_store_n(&cached, ((uint64_t)now << 32) | tmp, __ATOMIC_RELAXED);
+    *temp = tmp;
+    return kIOReturnSuccess;
+}
+
+OSDictionary *ThermalZone::getCacheStats() {
+    OSDictionary *ret = OSDictionary::withCapacity(3);
+    OSObject *value;
+    setPropertyNumber(ret, "Hits", __atomic_load_n(&cacheHits, __ATOMIC_RELAXED), 32);
+    setPropertyNumber(ret, "Misses", __atomic_load_n(&cacheMisses, __ATOMIC_RELAXED), 32);
+    setPropertyNumber(ret, "MaxAge", maxAge, 32);
+    return ret;
+}
+
+void ThermalZone::readLPAT() {
+    OSObject *result;
+    OSArray *package;
+    if (dev->evaluateObject("LPAT", &result) != kIOReturnSuccess)
+        return;
+
+    int32_t values[LPAT_MAX_POINTS * 2];
+    UInt32 length = 0;
+    bool complete = false;
+    if ((package = OSDynamicCast(OSArray, result)) && package->getCount() <= LPAT_MAX_POINTS * 2) {
+        for (; length < package->getCount(); length++) {
+            OSNumber *number = OSDynamicCast(OSNumber, package->getObject(length));
+            if (!number)
+                break;
+            values[length] = (int32_t)number->unsigned32BitValue();
+        }
+        complete = length == package->getCount();
+    }
+    OSSafeReleaseNULL(result);
+
+    LPATTable *table = new LPATTable;
+    if (table && (!complete || !table->build(values, length))) {
+        delete table;
+        table = nullptr;
+    }
+    lpat = table;
+}
+
 OSDictionary *ThermalZone::readTrips() {
     UInt32 trip_cnt;
     OSDictionary *ret = OSDictionary::withCapacity(1);
     OSObject *value;
 
+    // The table is read once, the count goes into every trip dictionary that replaces the last
+    if (!lpat)
+        readLPAT();
+    setPropertyNumber(ret, "LPAT", lpat ? lpat->getCount() : 0, 32);
+
+    if (aux_trips)
+        delete [] aux_trips;
+    aux_trips = nullptr;
+    aux_trip_nr = 0;
+    aux_dirty = 0;
+    crt_trip_id = hot_trip_id = psv_trip_id = -1;
+    bzero(act_trips, sizeof(act_trips));
+
     if (dev->evaluateInteger("PATC", &trip_cnt) == kIOReturnSuccess) {
         aux_trips = new UInt32[trip_cnt];
+        bzero(aux_trips, trip_cnt * sizeof(UInt32));
         aux_trip_nr = trip_cnt;
         setPropertyNumber(ret, "PATC", trip_cnt, 32);
     } else {
         trip_cnt = 0;
     }
 
+    // Zone hysteresis in deci-Kelvin, GTSH on DPTF participants
+    hyst = 0;
+    if (dev->evaluateInteger("GTSH", &hyst) == kIOReturnSuccess || dev->evaluateInteger("_HYS", &hyst) == kIOReturnSuccess)
+        setPropertyNumber(ret, "Hysteresis", hyst, 32);
+
     if (dev->evaluateInteger("_CR3", &cr3_temp) == kIOReturnSuccess)
         setPropertyTemp(ret, "Warm/Standby Temperature", acpi_deci_kelvin_to_deci_celsius(cr3_temp));
 
@@ -66,10 +152,159 @@ OSDictionary *ThermalZone::readTrips() {
     }
     ret->setObject("Active Cooling Temperature", arr);
     arr->release();
+
+    trip_nr = trip_cnt;
+    sortTrips();
     return ret;
 }
 
+bool ThermalZone::setTripTemp(UInt32 trip, UInt32 temp) {
+    if (trip >= (UInt32)aux_trip_nr || trip >= MAX_AUX_TRIP_COUNT)
+        return false;
+    aux_staged[trip] = temp;
+    aux_dirty |= BIT(trip);
+    return true;
+}
+
+UInt32 ThermalZone::commitTrips() {
+    UInt32 dirty = aux_dirty;
+    UInt32 written = 0;
+    char name[5];
+    aux_dirty = 0;
+
+    while (dirty) {
+        UInt32 trip = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        if (aux_staged[trip] == aux_trips[trip])
+            continue;
+
+        snprintf(name, 5, "PAT%1X", trip);
+        OSObject *params[] = {
+            OSNumber::withNumber(aux_staged[trip], 32),
+        };
+        IOReturn ret = dev->evaluateObject(name, nullptr, params, 1);
+        params[0]->release();
+        if (ret != kIOReturnSuccess)
+            continue;
+
+        aux_trips[trip] = aux_staged[trip];
+        written++;
+    }
+    if (written)
+        sortTrips();
+    return written;
+}
+
+UInt32 ThermalZone::getActiveTrips(UInt32 *temps) {
+    UInt32 n = 0;
+    for (int i = 0; i < MAX_ACT_TRIP_COUNT; i++)
+        if (act_trips[i].valid)
+            temps[n++] = act_trips[i].temp;
+    return n;
+}
+
+void ThermalZone::sortTrips() {
+    UInt32 n = 0;
+    struct trip_point trips[MAX_SORTED_TRIP_COUNT];
+    for (int i = 0; i < trip_nr && n < MAX_SORTED_TRIP_COUNT; i++) {
+        UInt32 type = getTripType(i);
+        UInt32 temp = getTripTemp(i);
+        if (type == THERMAL_TRIP_INVALID || !temp)
+            continue;
+
+        UInt32 j = n++;
+        for (; j > 0 && trips[j - 1].temp > temp; j--)
+            trips[j] = trips[j - 1];
+        trips[j].temp = temp;
+        trips[j].type = type;
+        trips[j].id = i;
+    }
+
+    // Only ever called under the owner's gate, readers see an odd generation until the end
+    uint64_t state = __atomic_load_n(&band, __ATOMIC_RELAXED);
+    uint64_t generation = (state >> 32) + 1;
+    __atomic_store_n(&band, (generation << 32) | (UInt32)state, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(sorted_trips, trips, sizeof(trips));
+    sorted_trip_nr = n;
+
+    // Keep the band where the last reading puts it, so moving a trip is not reported as a crossing
+    UInt32 to = walkBand((UInt32)state, (UInt32)__atomic_load_n(&cached, __ATOMIC_RELAXED));
+    __atomic_store_n(&band, ((generation + 1) << 32) | to, __ATOMIC_RELEASE);
+}
+
+UInt32 ThermalZone::getTripType(UInt32 trip) {
+    if (trip < (UInt32)aux_trip_nr)
+        return THERMAL_TRIP_AUX;
+    if ((int)trip == crt_trip_id)
+        return THERMAL_TRIP_CRITICAL;
+    if ((int)trip == hot_trip_id)
+        return THERMAL_TRIP_HOT;
+    if ((int)trip == psv_trip_id)
+        return THERMAL_TRIP_PASSIVE;
+    for (int i = 0; i < MAX_ACT_TRIP_COUNT; i++)
+        if (act_trips[i].valid && act_trips[i].id == (int)trip)
+            return THERMAL_TRIP_ACTIVE;
+    return THERMAL_TRIP_INVALID;
+}
+
+UInt32 ThermalZone::getTripTemp(UInt32 trip) {
+    if (trip < (UInt32)aux_trip_nr)
+        return aux_trips[trip];
+    if ((int)trip == crt_trip_id)
+        return crt_temp;
+    if ((int)trip == hot_trip_id)
+        return hot_temp;
+    if ((int)trip == psv_trip_id)
+        return psv_temp;
+    for (int i = 0; i < MAX_ACT_TRIP_COUNT; i++)
+        if (act_trips[i].valid && act_trips[i].id == (int)trip)
+            return act_trips[i].temp;
+    return 0;
+}
+
+UInt32 ThermalZone::walkBand(UInt32 from, UInt32 temp) {
+    // A band from before the trips were sorted again may be past the end
+    UInt32 n = sorted_trip_nr;
+    UInt32 start = from < n ? from : n;
+    UInt32 to = start;
+
+    // Steady state touches only the two neighbours, a jump walks just the trips it crosses
+    while (to < n && temp >= sorted_trips[to].temp)
+        to++;
+    if (to == start)
+        while (to > 0 && temp + hyst < sorted_trips[to - 1].temp)
+            to--;
+    return to;
+}
+
+bool ThermalZone::updateTrips(UInt32 temp, struct trip_crossing *crossing) {
+    uint64_t state = __atomic_load_n(&band, __ATOMIC_ACQUIRE);
+    // The trips are being sorted again, the writer places the band itself
+    if ((state >> 32) & 1)
+        return false;
+
+    UInt32 from = (UInt32)state;
+    UInt32 to = walkBand(from, temp);
+    if (to == from)
+        return false;
+    struct trip_point trip = sorted_trips[to > from ? to - 1 : to];
+
+    // Concurrent readers race on the same transition and the trips may be sorted again
+    // meanwhile, only a reader that saw neither reports it
+    if (!__atomic_compare_exchange_n(&band, &state, (state & ~0xFFFFFFFFULL) | to, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return false;
+
+    crossing->from = from;
+    crossing->to = to;
+    crossing->temp = temp;
+    crossing->trip = trip;
+    return true;
+}
+
 ThermalZone::~ThermalZone() {
+    if (lpat)
+        delete lpat;
     if (aux_trips)
         delete [] aux_trips;
 }
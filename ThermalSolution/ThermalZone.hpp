@@ -12,6 +12,7 @@
 
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
 #include "common.h"
+#include "LPAT.hpp"
 
 // from linux/include/linux/units.h
 
@@ -41,9 +42,28 @@ static inline SInt32 acpi_deci_kelvin_to_deci_celsius(UInt32 t)
     return t + ACPI_ABSOLUTE_ZERO_DECI_CELSIUS;
 }
 
+static inline UInt32 acpi_deci_celsius_to_deci_kelvin(SInt32 t)
+{
+    return t - ACPI_ABSOLUTE_ZERO_DECI_CELSIUS;
+}
+
+static inline uint64_t uptimeMS()
+{
+    uint64_t now;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now, &now);
+    return now / 1000000;
+}
+
+// Reads within this many milliseconds of the last _TMP evaluation are served from memory
+#define THERMAL_ZONE_MAX_AGE_MS 100
+
 // from linux/drivers/thermal/intel/int340x_thermal/int340x_thermal_zone.c
 
-#define MAX_ACT_TRIP_COUNT    10
+// _AC0 to _AC9
+#define MAX_ACT_TRIP_COUNT    kThermalActiveTripMax
+// PAT0 to PATF, ACPI names are four characters
+#define MAX_AUX_TRIP_COUNT    kThermalAuxTripMax
 
 struct active_trip {
     UInt32 temp;
@@ -51,13 +71,43 @@ struct active_trip {
     bool valid;
 };
 
+enum thermal_trip_type {
+    THERMAL_TRIP_INVALID = 0,
+    THERMAL_TRIP_CRITICAL,
+    THERMAL_TRIP_HOT,
+    THERMAL_TRIP_PASSIVE,
+    THERMAL_TRIP_ACTIVE,
+    THERMAL_TRIP_AUX,
+};
+
+// Critical, hot, passive, the active trips and a few aux trips
+#define MAX_SORTED_TRIP_COUNT 16
+
+struct trip_point {
+    UInt32 temp;
+    UInt16 type;
+    UInt16 id;
+};
+
+struct trip_crossing {
+    UInt32 from;            // band before, number of trips below the temperature
+    UInt32 to;              // band after
+    UInt32 temp;            // reading that crossed, deci-Kelvin
+    struct trip_point trip; // outermost trip crossed
+};
+
 class ThermalZone {
     IOACPIPlatformDevice *dev {nullptr};
 
-    // TODO: LPAT table parse
+    // Raw _TMP to deci-Kelvin, only on sensors that have an LPAT
+    LPATTable *lpat {nullptr};
+    void readLPAT();
 
     struct active_trip act_trips[MAX_ACT_TRIP_COUNT];
     UInt32 *aux_trips {nullptr};
+    // Aux trip writes waiting for commitTrips, one bit per trip
+    UInt32 aux_staged[MAX_AUX_TRIP_COUNT];
+    UInt32 aux_dirty {0};
 
     int aux_trip_nr {0};
     UInt32 cr3_temp {0};
@@ -69,18 +119,81 @@ class ThermalZone {
     int psv_trip_id {-1};
 
     UInt32 tsp {0};
+    UInt32 hyst {0};
+    int trip_nr {0};
+
+    // Valid trips by ascending temperature, the band is the number of trips at or below the zone
+    struct trip_point sorted_trips[MAX_SORTED_TRIP_COUNT];
+    UInt32 sorted_trip_nr {0};
+    // Band in the low half, generation of sorted_trips in the high half, odd while they are
+    // rewritten. Readers only report a crossing if the word did not move while they walked.
+    uint64_t band {0};
+    UInt32 walkBand(UInt32 from, UInt32 temp);
+    void sortTrips();
+
+    // Last _TMP in the low half, truncated uptime in ms in the high half, swapped as one word
+    uint64_t cached {0};
+    UInt32 maxAge {THERMAL_ZONE_MAX_AGE_MS};
+    UInt32 cacheHits {0};
+    UInt32 cacheMisses {0};
 
 public:
     ThermalZone(IOACPIPlatformDevice *dev) : dev(dev) {};
     ~ThermalZone();
 
-//    UInt32 getTripConfig();
-//    UInt32 getTripHyst(UInt32 trip);
-//    UInt32 getTripTemp(UInt32 trip);
-//    UInt32 getTripType(UInt32 trip);
+    UInt32 getTripConfig() { return trip_nr; };
+    UInt32 getTripHyst(UInt32 trip) { return hyst; };
+    UInt32 getTripTemp(UInt32 trip);
+    UInt32 getTripType(UInt32 trip);
     IOReturn getZoneTemp(UInt32 *temp);
 
-//    bool setTripTemp(UInt32 trip, UInt32 temp);
+    /**
+     * Track the band of the zone, comparing only against the trips right above and below it.
+     * Going down needs the temperature to fall below the trip by the hysteresis.
+     * @param temp Deci-Kelvin
+     * @param crossing Filled when the band changed
+     *
+     * @return true if the band changed
+     */
+    bool updateTrips(UInt32 temp, struct trip_crossing *crossing);
+    UInt32 getBand() { return (UInt32)__atomic_load_n(&band, __ATOMIC_RELAXED); };
+
+    /**
+     * Evaluate _TMP unless the last reading is younger than the max age
+     * @param temp Deci-Kelvin
+     *
+     * @return kIOReturnSuccess upon success
+     */
+    IOReturn readTemperature(UInt32 *temp);
+    void setMaxAge(UInt32 ms) { maxAge = ms; };
+    void invalidate() { __atomic_store_n(&cached, 0, __ATOMIC_RELAXED); };
+    OSDictionary *getCacheStats();
+    UInt32 getSamplingPeriod() { return tsp; };
+
+    /**
+     * Stage a new temperature for an aux trip, nothing is written until commitTrips
+     * @param trip Aux trip index, below PATC
+     * @param temp Deci-Kelvin
+     *
+     * @return false if the trip is not programmable
+     */
+    bool setTripTemp(UInt32 trip, UInt32 temp);
+
+    /**
+     * Write the staged aux trips through PATx and sort the trips once for the whole batch.
+     * Trips already at the staged temperature cost no evaluation.
+     *
+     * @return Number of trips written
+     */
+    UInt32 commitTrips();
+    UInt32 getAuxTripCount() { return aux_trip_nr; };
+
+    /**
+     * @param temps Room for MAX_ACT_TRIP_COUNT trips
+     *
+     * @return Number of valid _ACx copied, in _ACx order
+     */
+    UInt32 getActiveTrips(UInt32 *temps);
 
     OSDictionary *readTrips();
 };
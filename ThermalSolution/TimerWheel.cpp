@@ -0,0 +1,246 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  TimerWheel.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include <string.h>
+#include "TimerWheel.hpp"
+#include "portable.h"
+
+static inline uint64_t rotate(uint64_t bits, uint32_t shift) {
+    shift &= TIMER_WHEEL_MASK;
+    return shift ? (bits >> shift) | (bits << (64 - shift)) : bits;
+}
+
+bool TimerWheel::init(uint64_t start, uint32_t size) {
+    release();
+    now = start;
+    return grow(size ? size : 1);
+}
+
+void TimerWheel::release() {
+    if (block)
+        IOFree(block, blockSize);
+    block = nullptr;
+    blockSize = 0;
+    links = nullptr;
+    entries = nullptr;
+    capacity = 0;
+    count = 0;
+    freeList = TIMER_WHEEL_INVALID;
+    memset(occupied, 0, sizeof(occupied));
+}
+
+bool TimerWheel::grow(uint32_t size) {
+    size_t linkSize = (TIMER_WHEEL_HEADS + size) * sizeof(TimerWheelLink);
+    size_t total = linkSize + size * sizeof(TimerWheelEntry);
+    void *grown = IOMalloc(total);
+    if (!grown)
+        return false;
+
+    TimerWheelLink *newLinks = reinterpret_cast<TimerWheelLink *>(grown);
+    TimerWheelEntry *newEntries = reinterpret_cast<TimerWheelEntry *>(reinterpret_cast<uint8_t *>(grown) + linkSize);
+    if (block) {
+        // Links are indices, so they survive the move
+        memcpy(newLinks, links, (TIMER_WHEEL_HEADS + capacity) * sizeof(TimerWheelLink));
+        memcpy(newEntries, entries, capacity * sizeof(TimerWheelEntry));
+        IOFree(block, blockSize);
+    } else {
+        for (uint32_t i = 0; i < TIMER_WHEEL_HEADS; i++)
+            newLinks[i].next = newLinks[i].prev = i;
+    }
+
+    for (uint32_t i = size; i > capacity; i--) {
+        newEntries[i - 1].head = TIMER_WHEEL_INVALID;
+        newLinks[TIMER_WHEEL_HEADS + i - 1].next = freeList;
+        freeList = i - 1;
+    }
+
+    block = grown;
+    blockSize = total;
+    links = newLinks;
+    entries = newEntries;
+    capacity = size;
+    return true;
+}
+
+void TimerWheel::link(uint32_t id) {
+    TimerWheelEntry *entry = &entries[id];
+    uint64_t expires = entry->expires;
+    uint64_t delta = expires > now ? expires - now : 0;
+    if (delta >= TIMER_WHEEL_SPAN) {
+        // Parked at the far end, re-linked instead of fired when it gets there
+        delta = TIMER_WHEEL_SPAN - 1;
+        expires = now + delta;
+    }
+
+    uint32_t level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+    uint32_t index = (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    uint32_t head = level * TIMER_WHEEL_SIZE + index;
+
+    uint32_t node = TIMER_WHEEL_HEADS + id;
+    links[node].next = head;
+    links[node].prev = links[head].prev;
+    links[links[head].prev].next = node;
+    links[head].prev = node;
+    occupied[level] |= 1ULL << index;
+    entry->head = head;
+}
+
+void TimerWheel::unlink(uint32_t id) {
+    uint32_t node = TIMER_WHEEL_HEADS + id;
+    uint32_t head = entries[id].head;
+    links[links[node].prev].next = links[node].next;
+    links[links[node].next].prev = links[node].prev;
+    if (head < TIMER_WHEEL_FIRING && links[head].next == head)
+        occupied[head / TIMER_WHEEL_SIZE] &= ~(1ULL << (head % TIMER_WHEEL_SIZE));
+}
+
+void TimerWheel::splice(uint32_t from, uint32_t to) {
+    if (links[from].next == from)
+        return;
+
+    uint32_t first = links[from].next;
+    uint32_t last = links[from].prev;
+    links[first].prev = links[to].prev;
+    links[links[to].prev].next = first;
+    links[last].next = to;
+    links[to].prev = last;
+    links[from].next = links[from].prev = from;
+
+    for (uint32_t node = first; node != to; node = links[node].next)
+        entries[node - TIMER_WHEEL_HEADS].head = to;
+    if (from < TIMER_WHEEL_FIRING)
+        occupied[from / TIMER_WHEEL_SIZE] &= ~(1ULL << (from % TIMER_WHEEL_SIZE));
+}
+
+void TimerWheel::cascade(uint32_t level, uint32_t index) {
+    uint32_t head = level * TIMER_WHEEL_SIZE + index;
+    if (!(occupied[level] & (1ULL << index)))
+        return;
+
+    // Everything in the slot expires within this level's span from now, so it moves down
+    splice(head, TIMER_WHEEL_FIRING);
+    uint32_t node;
+    while ((node = links[TIMER_WHEEL_FIRING].next) != TIMER_WHEEL_FIRING) {
+        unlink(node - TIMER_WHEEL_HEADS);
+        link(node - TIMER_WHEEL_HEADS);
+    }
+}
+
+uint32_t TimerWheel::add(uint32_t delay, uint32_t period, TimerWheelAction action, void *owner, void *context, uint32_t cookie) {
+    if (freeList == TIMER_WHEEL_INVALID && !grow(capacity * 2))
+        return TIMER_WHEEL_INVALID;
+
+    uint32_t id = freeList;
+    freeList = links[TIMER_WHEEL_HEADS + id].next;
+
+    TimerWheelEntry *entry = &entries[id];
+    entry->expires = now + (delay ? delay : 1);
+    entry->period = period;
+    entry->action = action;
+    entry->owner = owner;
+    entry->context = context;
+    entry->cookie = cookie;
+    link(id);
+    count++;
+    return id;
+}
+
+bool TimerWheel::remove(uint32_t id) {
+    if (id >= capacity || entries[id].head == TIMER_WHEEL_INVALID)
+        return false;
+
+    unlink(id);
+    entries[id].head = TIMER_WHEEL_INVALID;
+    links[TIMER_WHEEL_HEADS + id].next = freeList;
+    freeList = id;
+    count--;
+    return true;
+}
+
+uint32_t TimerWheel::removeContext(const void *context) {
+    uint32_t removed = 0;
+    for (uint32_t id = 0; id < capacity; id++)
+        if (entries[id].head != TIMER_WHEEL_INVALID && entries[id].context == context && remove(id))
+            removed++;
+    return removed;
+}
+
+uint64_t TimerWheel::nextExpiry() const {
+    uint64_t next = UINT64_MAX;
+
+    // Level 0 holds the next TIMER_WHEEL_SIZE ticks, wrapping around the current slot
+    if (occupied[0])
+        next = now + 1 + __builtin_ctzll(rotate(occupied[0], (uint32_t)(now + 1)));
+
+    // A slot of a later level is due when its block starts, the current one was already cascaded
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!occupied[level])
+            continue;
+        uint32_t shift = TIMER_WHEEL_BITS * level;
+        uint64_t block = now >> shift;
+        uint32_t ahead = __builtin_ctzll(rotate(occupied[level], (uint32_t)(block + 1))) + 1;
+        uint64_t tick = (block + ahead) << shift;
+        if (tick < next)
+            next = tick;
+    }
+    return next;
+}
+
+uint32_t TimerWheel::advance(uint64_t tick) {
+    uint32_t fired = 0;
+    uint64_t next;
+
+    while ((next = nextExpiry()) <= tick) {
+        now = next;
+        for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            uint32_t shift = TIMER_WHEEL_BITS * level;
+            if (now & ((1ULL << shift) - 1))
+                break;
+            cascade(level, (now >> shift) & TIMER_WHEEL_MASK);
+        }
+
+        // Detach the slot first so the actions are free to modify the wheel
+        splice(now & TIMER_WHEEL_MASK, TIMER_WHEEL_FIRING);
+        uint32_t node;
+        while ((node = links[TIMER_WHEEL_FIRING].next) != TIMER_WHEEL_FIRING) {
+            uint32_t id = node - TIMER_WHEEL_HEADS;
+            TimerWheelEntry *entry = &entries[id];
+            unlink(id);
+            if (entry->expires > now) {
+                link(id);
+                continue;
+            }
+
+            TimerWheelAction action = entry->action;
+            void *owner = entry->owner;
+            void *context = entry->context;
+            uint32_t cookie = entry->cookie;
+            if (entry->period) {
+                // Keep the phase, but do not try to catch up on missed expiries
+                entry->expires += entry->period;
+                if (entry->expires <= now)
+                    entry->expires = now + entry->period;
+                link(id);
+            } else {
+                entry->head = TIMER_WHEEL_INVALID;
+                links[node].next = freeList;
+                freeList = id;
+                count--;
+            }
+            action(owner, context, cookie);
+            fired++;
+        }
+    }
+
+    if (tick > now)
+        now = tick;
+    return fired;
+}
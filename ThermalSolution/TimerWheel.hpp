@@ -0,0 +1,125 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  TimerWheel.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Hierarchical timer wheel multiplexing periodic samplers on a single
+//  hardware timer. Kernel-agnostic, time is in caller-defined ticks.
+//
+
+#ifndef TimerWheel_hpp
+#define TimerWheel_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SIZE        (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_SPAN        (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+// List heads: one per slot, plus the list of timers being fired
+#define TIMER_WHEEL_FIRING      (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE)
+#define TIMER_WHEEL_HEADS       (TIMER_WHEEL_FIRING + 1)
+
+#define TIMER_WHEEL_INVALID     UINT32_MAX
+
+/**
+ * Called on expiry with the values given to TimerWheel::add. The action may add and
+ * remove timers, including its own.
+ */
+typedef void (*TimerWheelAction)(void *owner, void *context, uint32_t cookie);
+
+struct TimerWheelLink {
+    uint32_t next;
+    uint32_t prev;
+};
+
+struct TimerWheelEntry {
+    uint64_t expires;           // tick
+    uint32_t period;            // ticks, 0 for one-shot
+    uint32_t head;              // list the entry is on, TIMER_WHEEL_INVALID if free
+    TimerWheelAction action;
+    void *owner;
+    void *context;
+    uint32_t cookie;
+};
+
+class TimerWheel {
+    // Links of the heads followed by those of the entries, then the entries
+    void *block {nullptr};
+    size_t blockSize {0};
+
+    TimerWheelLink *links {nullptr};
+    TimerWheelEntry *entries {nullptr};
+    uint32_t capacity {0};
+    uint32_t count {0};
+    uint32_t freeList {TIMER_WHEEL_INVALID};
+
+    uint64_t occupied[TIMER_WHEEL_LEVELS] {};
+    uint64_t now {0};
+
+    bool grow(uint32_t size);
+    void link(uint32_t id);
+    void unlink(uint32_t id);
+    void splice(uint32_t from, uint32_t to);
+    void cascade(uint32_t level, uint32_t index);
+
+public:
+    ~TimerWheel() { release(); };
+
+    /**
+     * Allocate room for a number of timers, it grows on demand afterwards
+     * @param start Current tick
+     * @param size Initial capacity
+     *
+     * @return true upon success
+     */
+    bool init(uint64_t start, uint32_t size);
+    void release();
+
+    /**
+     * Schedule a timer relative to the last tick passed to advance()
+     * @param delay Ticks until the first expiry, at least 1
+     * @param period Ticks between expiries, 0 for one-shot
+     *
+     * @return Timer id, *TIMER_WHEEL_INVALID* when out of memory
+     */
+    uint32_t add(uint32_t delay, uint32_t period, TimerWheelAction action, void *owner, void *context, uint32_t cookie);
+
+    bool remove(uint32_t id);
+
+    /**
+     * Remove every timer scheduled with a context, O(capacity)
+     *
+     * @return Number of timers removed
+     */
+    uint32_t removeContext(const void *context);
+
+    /**
+     * Fire every timer that expires up to a tick. Empty ticks are skipped using the slot
+     * bitmaps, so the cost depends on the number of expiries and cascades, not on the gap.
+     * @param tick Current tick, ignored if in the past
+     *
+     * @return Number of actions called
+     */
+    uint32_t advance(uint64_t tick);
+
+    /**
+     * Earliest tick advance() has work at, either an expiry or a cascade of a later level.
+     * Programming the hardware timer for it gives one interrupt per busy tick.
+     *
+     * @return Tick, UINT64_MAX if no timer is pending
+     */
+    uint64_t nextExpiry() const;
+
+    uint64_t getNow() const { return now; };
+    uint32_t getCount() const { return count; };
+    uint32_t getCapacity() const { return capacity; };
+};
+
+#endif /* TimerWheel_hpp */
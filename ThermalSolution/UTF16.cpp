@@ -0,0 +1,165 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  UTF16.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include <string.h>
+#include "UTF16.hpp"
+
+#ifdef KERNEL
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSString.h>
+#endif
+
+// Lanes are loaded straight from the little-endian buffer
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "UTF-16LE lanes need a little-endian host");
+
+// SSE2 on x86_64
+typedef uint16_t utf16_units __attribute__((vector_size(UTF16_BLOCK * sizeof(uint16_t))));
+typedef uint8_t utf16_narrow __attribute__((vector_size(UTF16_BLOCK)));
+
+static inline uint16_t unitAt(const uint8_t *src, uint32_t i) {
+    return src[2 * i] | (src[2 * i + 1] << 8);
+}
+
+/**
+ * Load a block and check it holds only ASCII, without NUL
+ * @param src First code unit of the block
+ * @param block The block as loaded
+ *
+ * @return true if every unit is in 1 to 0x7F
+ */
+static inline bool asciiBlock(const uint8_t *src, utf16_units *block) {
+    memcpy(block, src, sizeof(utf16_units));
+    // NUL wraps around to 0xFFFF, so one unsigned compare covers both ends
+    utf16_units ascii = (utf16_units)((*block - 1) < 0x7F);
+    uint64_t lanes[2];
+    memcpy(lanes, &ascii, sizeof(lanes));
+    return (lanes[0] & lanes[1]) == UINT64_MAX;
+}
+
+/**
+ * @param cp Set to the code point, U+FFFD for a lone surrogate
+ *
+ * @return Code units used
+ */
+static inline uint32_t decodeChar(const uint8_t *src, uint32_t i, uint32_t units, uint32_t *cp) {
+    uint32_t c = unitAt(src, i);
+    if (c < 0xD800 || c > 0xDFFF) {
+        *cp = c;
+        return 1;
+    }
+    if (c <= 0xDBFF && i + 1 < units) {
+        uint32_t low = unitAt(src, i + 1);
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            *cp = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+            return 2;
+        }
+    }
+    *cp = 0xFFFD;
+    return 1;
+}
+
+static inline uint32_t utf8Size(uint32_t cp) {
+    return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static inline void encodeChar(uint32_t cp, uint32_t size, char *out) {
+    switch (size) {
+        case 1:
+            out[0] = cp;
+            break;
+
+        case 2:
+            out[0] = 0xC0 | (cp >> 6);
+            out[1] = 0x80 | (cp & 0x3F);
+            break;
+
+        case 3:
+            out[0] = 0xE0 | (cp >> 12);
+            out[1] = 0x80 | ((cp >> 6) & 0x3F);
+            out[2] = 0x80 | (cp & 0x3F);
+            break;
+
+        default:
+            out[0] = 0xF0 | (cp >> 18);
+            out[1] = 0x80 | ((cp >> 12) & 0x3F);
+            out[2] = 0x80 | ((cp >> 6) & 0x3F);
+            out[3] = 0x80 | (cp & 0x3F);
+            break;
+    }
+}
+
+// Measuring and converting share one walk, store is a compile-time switch
+template <bool store>
+static uint32_t convert(const uint8_t *src, uint32_t units, char *dst, uint32_t room) {
+    uint32_t i = 0, j = 0;
+    utf16_units block;
+    while (i < units) {
+        if (units - i >= UTF16_BLOCK && (!store || room - j >= UTF16_BLOCK) && asciiBlock(src + 2 * i, &block)) {
+            if (store) {
+                utf16_narrow narrow = __builtin_convertvector(block, utf16_narrow);
+                memcpy(dst + j, &narrow, UTF16_BLOCK);
+            }
+            i += UTF16_BLOCK;
+            j += UTF16_BLOCK;
+            continue;
+        }
+
+        // One character at a time up to the end of the block that failed, a pair may cross it
+        uint32_t end = units - i > UTF16_BLOCK ? i + UTF16_BLOCK : units;
+        while (i < end) {
+            if (!unitAt(src, i))
+                return j;
+            uint32_t cp;
+            uint32_t used = decodeChar(src, i, units, &cp);
+            uint32_t size = utf8Size(cp);
+            if (store) {
+                if (room - j < size)
+                    return j;
+                encodeChar(cp, size, dst + j);
+            }
+            i += used;
+            j += size;
+        }
+    }
+    return j;
+}
+
+uint32_t utf16leLength(const void *src, uint32_t units) {
+    return convert<false>(static_cast<const uint8_t *>(src), units, nullptr, 0);
+}
+
+uint32_t utf16leToUTF8(const void *src, uint32_t units, char *dst, uint32_t capacity) {
+    if (!capacity)
+        return 0;
+    uint32_t length = convert<true>(static_cast<const uint8_t *>(src), units, dst, capacity - 1);
+    dst[length] = '\0';
+    return length;
+}
+
+#ifdef KERNEL
+OSString *utf16leString(const void *src, uint32_t length) {
+    uint32_t units = length / 2;
+
+    // Participant names decode in one pass on the stack, longer strings are measured first
+    // so the buffer has the exact size
+    char small[128];
+    uint32_t size = sizeof(small);
+    char *out = small;
+    if (UTF16_UTF8_MAX(units) >= sizeof(small)) {
+        size = utf16leLength(src, units) + 1;
+        if (size > sizeof(small) && !(out = reinterpret_cast<char *>(IOMalloc(size))))
+            return nullptr;
+    }
+    utf16leToUTF8(src, units, out, size);
+    OSString *ret = OSString::withCString(out);
+    if (out != small)
+        IOFree(out, size);
+    return ret;
+}
+#endif
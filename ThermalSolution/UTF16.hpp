@@ -0,0 +1,58 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  UTF16.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  UTF-16LE to UTF-8 for ACPI _STR buffers and DataVault unicode values.
+//  Runs of ASCII are checked and narrowed eight code units per vector, the
+//  rest is encoded one character at a time. Kernel-agnostic, the caller owns
+//  the output.
+//
+
+#ifndef UTF16_hpp
+#define UTF16_hpp
+
+#include <stdint.h>
+
+// Code units per vector
+#define UTF16_BLOCK 8
+// Enough UTF-8 for any number of code units, without the terminator
+#define UTF16_UTF8_MAX(units) ((units) * 3)
+
+/**
+ * Length of the UTF-8 form, up to the first NUL
+ * @param src Code units, any alignment
+ * @param units Number of code units
+ *
+ * @return Bytes without the terminator
+ */
+uint32_t utf16leLength(const void *src, uint32_t units);
+
+/**
+ * Convert to NUL terminated UTF-8, stopping at the first NUL. Lone surrogates become U+FFFD.
+ * Output that does not fit is cut at the last whole character.
+ * @param src Code units, any alignment
+ * @param units Number of code units
+ * @param dst Output
+ * @param capacity Bytes in dst including the terminator, at least 1
+ *
+ * @return Bytes written without the terminator
+ */
+uint32_t utf16leToUTF8(const void *src, uint32_t units, char *dst, uint32_t capacity);
+
+#ifdef KERNEL
+class OSString;
+
+/**
+ * @param src UTF-16LE bytes
+ * @param length Length in bytes, an odd trailing byte is ignored
+ *
+ * @return New string, nullptr if out of memory
+ */
+OSString *utf16leString(const void *src, uint32_t length);
+#endif
+
+#endif /* UTF16_hpp */
@@ -0,0 +1,98 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  VirtualSensor.cpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+
+#include "VirtualSensor.hpp"
+
+static inline uint32_t sumLanes(virtual_lanes v) {
+    return v[0] + v[1] + v[2] + v[3];
+}
+
+bool VirtualSensors::define(uint32_t i, uint32_t mode, const uint32_t *weights) {
+    if (i >= VIRTUAL_SENSOR_MAX || mode > kVirtualSensorMin)
+        return false;
+    for (uint32_t slot = 0; slot < VIRTUAL_SENSOR_SLOTS; slot++) {
+        uint32_t weight = weights[slot] < VIRTUAL_SENSOR_WEIGHT_MAX ? weights[slot] : VIRTUAL_SENSOR_WEIGHT_MAX;
+        this->weights[i][slot / VIRTUAL_SENSOR_LANES][slot % VIRTUAL_SENSOR_LANES] = weight;
+    }
+    modes[i] = mode;
+    defined |= 1U << i;
+    return true;
+}
+
+void VirtualSensors::remove(uint32_t i) {
+    if (i >= VIRTUAL_SENSOR_MAX)
+        return;
+    defined &= ~(1U << i);
+    __atomic_store_n(&values[i], 0, __ATOMIC_RELAXED);
+}
+
+uint32_t VirtualSensors::fuse(uint32_t i) const {
+    const virtual_lanes zero = {};
+    const virtual_lanes *weight = weights[i];
+
+    switch (modes[i]) {
+        case kVirtualSensorWeighted: {
+            virtual_lanes sum = zero, total = zero;
+            for (uint32_t v = 0; v < vectors; v++) {
+                // Comparisons give all ones per true lane
+                virtual_lanes w = weight[v] & (virtual_lanes)(readings[v] != zero);
+                sum += readings[v] * w;
+                total += w;
+            }
+            uint32_t t = sumLanes(total);
+            return t ? (sumLanes(sum) + t / 2) / t : 0;
+        }
+
+        case kVirtualSensorMax: {
+            virtual_lanes best = zero;
+            for (uint32_t v = 0; v < vectors; v++) {
+                virtual_lanes r = readings[v] & (virtual_lanes)(weight[v] != zero);
+                virtual_lanes greater = (virtual_lanes)(r > best);
+                best = (r & greater) | (best & ~greater);
+            }
+            uint32_t value = best[0];
+            for (uint32_t l = 1; l < VIRTUAL_SENSOR_LANES; l++)
+                value = best[l] > value ? best[l] : value;
+            return value;
+        }
+
+        case kVirtualSensorMin: {
+            virtual_lanes best = ~zero;
+            for (uint32_t v = 0; v < vectors; v++) {
+                // Slots left out read as the largest value, so they never win
+                virtual_lanes member = (virtual_lanes)(weight[v] != zero) & (virtual_lanes)(readings[v] != zero);
+                virtual_lanes r = readings[v] | ~member;
+                virtual_lanes less = (virtual_lanes)(r < best);
+                best = (r & less) | (best & ~less);
+            }
+            uint32_t value = best[0];
+            for (uint32_t l = 1; l < VIRTUAL_SENSOR_LANES; l++)
+                value = best[l] < value ? best[l] : value;
+            return ~value ? value : 0;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+uint32_t VirtualSensors::update() {
+    uint32_t changed = 0;
+    uint32_t pending = defined;
+    while (pending) {
+        uint32_t i = __builtin_ctz(pending);
+        pending &= pending - 1;
+        uint32_t value = fuse(i);
+        if (value == values[i])
+            continue;
+        __atomic_store_n(&values[i], value, __ATOMIC_RELAXED);
+        changed |= 1U << i;
+    }
+    return changed;
+}
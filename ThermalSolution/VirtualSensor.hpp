@@ -0,0 +1,90 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  VirtualSensor.hpp
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Virtual sensors fused from the latest reading of each participant slot.
+//  Readings and weights are laid out as vectors of four lanes, so every
+//  definition is a handful of vector multiplies and compares followed by a
+//  single horizontal reduction. Kernel-agnostic and allocation free.
+//
+
+#ifndef VirtualSensor_hpp
+#define VirtualSensor_hpp
+
+#include <stdint.h>
+
+// Participant slots, a multiple of the lane count
+#define VIRTUAL_SENSOR_SLOTS        32
+#define VIRTUAL_SENSOR_LANES        4
+#define VIRTUAL_SENSOR_MAX          8
+// Keeps the weighted sum of 32 clamped readings inside 32 bits
+#define VIRTUAL_SENSOR_WEIGHT_MAX   1000
+#define VIRTUAL_SENSOR_READING_MAX  0xFFFF
+
+enum VirtualSensorMode {
+    kVirtualSensorWeighted = 0,
+    kVirtualSensorMax,
+    kVirtualSensorMin,
+};
+
+// SSE2 on x86_64
+typedef uint32_t virtual_lanes __attribute__((vector_size(VIRTUAL_SENSOR_LANES * sizeof(uint32_t))));
+
+class VirtualSensors {
+    static const uint32_t vectors = VIRTUAL_SENSOR_SLOTS / VIRTUAL_SENSOR_LANES;
+
+    // Deci-Kelvin per slot, 0 if unavailable
+    virtual_lanes readings[vectors] {};
+    // Per slot weight of each sensor, 0 for slots that are not members
+    virtual_lanes weights[VIRTUAL_SENSOR_MAX][vectors] {};
+    uint8_t modes[VIRTUAL_SENSOR_MAX] {};
+    uint32_t defined {0};
+    uint32_t values[VIRTUAL_SENSOR_MAX] {};
+
+public:
+    /**
+     * @param slot Participant slot
+     * @param temperature Deci-Kelvin, 0 if unavailable
+     */
+    void setReading(uint32_t slot, uint32_t temperature) {
+        if (slot < VIRTUAL_SENSOR_SLOTS)
+            readings[slot / VIRTUAL_SENSOR_LANES][slot % VIRTUAL_SENSOR_LANES] =
+                temperature < VIRTUAL_SENSOR_READING_MAX ? temperature : VIRTUAL_SENSOR_READING_MAX;
+    };
+
+    /**
+     * Define or replace a sensor
+     * @param i Sensor index
+     * @param mode VirtualSensorMode
+     * @param weights VIRTUAL_SENSOR_SLOTS weights, any nonzero weight marks a member for Max and Min
+     *
+     * @return false if the index or mode is invalid
+     */
+    bool define(uint32_t i, uint32_t mode, const uint32_t *weights);
+    void remove(uint32_t i);
+
+    /**
+     * Fuse the current readings for one sensor. Members without a reading are left out,
+     * a weighted sensor is averaged over the weights of the members that have one.
+     *
+     * @return Deci-Kelvin, 0 if no member has a reading
+     */
+    uint32_t fuse(uint32_t i) const;
+
+    /**
+     * Fuse every defined sensor once
+     *
+     * @return Mask of the sensors whose value changed
+     */
+    uint32_t update();
+
+    bool isDefined(uint32_t i) const { return i < VIRTUAL_SENSOR_MAX && (defined & (1U << i)); };
+    uint32_t getValue(uint32_t i) const { return i < VIRTUAL_SENSOR_MAX ? __atomic_load_n(&values[i], __ATOMIC_RELAXED) : 0; };
+    uint32_t getMode(uint32_t i) const { return i < VIRTUAL_SENSOR_MAX ? modes[i] : 0; };
+};
+
+#endif /* VirtualSensor_hpp */
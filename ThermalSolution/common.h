@@ -27,8 +27,146 @@ enum
     // Thermal message types
     kThermal_getDeviceType  = iokit_vendor_specific_msg(900),   // get temperature from sensor (data is UInt32*)
     kThermal_getTemperature = iokit_vendor_specific_msg(901),   // get temperature from sensor (data is UInt32*)
+    kThermal_getSamplingPeriod = iokit_vendor_specific_msg(902),    // get _TSP in tenths of a second (data is UInt32*)
+    kThermal_getTemperatures = iokit_vendor_specific_msg(903),  // read all sensors in one pass (data is ThermalReadings*)
+    kThermal_getSubscriptions = iokit_vendor_specific_msg(904), // get message classes to receive, all if unanswered (data is UInt32*)
+    kThermal_setAuxTrips = iokit_vendor_specific_msg(905),      // program aux trips in one pass (data is ThermalAuxTrips*)
+    kThermal_getHistory = iokit_vendor_specific_msg(906),       // recent samples of a sampled participant (data is ThermalHistory*)
+    kThermal_getPowerCapability = iokit_vendor_specific_msg(907),   // PPCC of the processor, valid while it is registered (data is const ThermalPowerCapability**)
+    kThermal_setPowerLimits = iokit_vendor_specific_msg(908),   // PL1/PL2 chosen by the power controller (data is ThermalPowerLimits*)
+    kThermal_getActiveTrips = iokit_vendor_specific_msg(909),   // _ACx of a participant zone (data is ThermalActiveTrips*)
+    kThermal_setFanLevel = iokit_vendor_specific_msg(910),      // fan level chosen by the active policy (data is ThermalFanLevel*)
+    kThermal_getVirtualTemperature = iokit_vendor_specific_msg(911),    // fused value of a virtual sensor (data is ThermalVirtualReading*)
 };
 
+// Message classes for kThermal_getSubscriptions
+#define kThermalClassNotification   BIT(0)  // relayed ACPI notifications
+#define kThermalClassTemperature    BIT(1)  // temperature reads and trip events
+#define kThermalClassPower          BIT(2)  // power limits and capabilities
+#define kThermalClassPolicy         BIT(3)  // policy and mode changes
+#define kThermalClassCooling        BIT(4)  // active cooling and fans
+#define kThermalClassAll            0xFFFFFFFF
+
+class IOService;
+
+struct ThermalReading {
+    IOService *device;
+    UInt32 type;
+    UInt32 temperature;     // deci-Kelvin
+};
+
+struct ThermalReadings {
+    UInt32 capacity;        // in: records available in readings
+    UInt32 count;           // out: records filled
+    UInt32 total;           // out: sensors registered, more than count if capacity is short
+    ThermalReading *readings;
+};
+
+struct ThermalSample {
+    UInt32 time;            // uptime in ms, truncated
+    UInt32 temperature;     // deci-Kelvin
+};
+
+struct ThermalHistory {
+    IOService *device;      // in: participant
+    UInt32 capacity;        // in: samples available in samples
+    UInt32 count;           // out: samples filled, oldest first
+    ThermalSample *samples;
+};
+
+#define kThermalAuxTripMax 16
+
+struct ThermalAuxTrips {
+    UInt32 mask;            // in: trips to program, bit n for PATn
+    UInt32 temps[kThermalAuxTripMax];   // in: deci-Kelvin, 0 disables the trip
+    UInt32 written;         // out: trips actually written
+};
+
+// Sequence counter of a snapshot with one writer, odd while it is being written
+
+static inline void seqWriteBegin(volatile UInt32 *sequence) {
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqWriteEnd(volatile UInt32 *sequence) {
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+}
+
+static inline UInt32 seqReadBegin(const volatile UInt32 *sequence) {
+    UInt32 begin;
+    while ((begin = __atomic_load_n(sequence, __ATOMIC_ACQUIRE)) & 1)
+        ;
+    return begin;
+}
+
+static inline bool seqReadRetry(const volatile UInt32 *sequence, UInt32 begin) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(sequence, __ATOMIC_RELAXED) != begin;
+}
+
+#define kThermalActiveTripMax 10
+
+struct ThermalActiveTrips {
+    UInt32 count;           // out: trips filled, in _ACx order
+    UInt32 hysteresis;      // out: deci-Kelvin
+    UInt32 temps[kThermalActiveTripMax];    // out: deci-Kelvin
+};
+
+struct ThermalFanLevel {
+    IOService *device;      // participant whose trips set the level
+    UInt32 level;           // trips at or below the zone, 0 is off
+    UInt32 count;           // levels above off
+    UInt32 percent;         // level as a fan speed
+};
+
+struct ThermalVirtualReading {
+    char name[8];           // in: virtual sensor name
+    UInt32 temperature;     // out: deci-Kelvin, 0 if no member has a reading
+};
+
+#define kThermalPowerLimitMax 2
+
+// PPCC gives mW and ms, the limits below are scaled once to uW and us
+#define PPCC_UNIT_SCALE 1000
+
+struct ThermalPowerLimit {
+    UInt32 min_uw;
+    UInt32 max_uw;
+    UInt32 tmin_us;
+    UInt32 tmax_us;
+    UInt32 step_uw;
+};
+
+struct ThermalPowerCapability {
+    volatile UInt32 sequence;
+    UInt32 count;           // limits present, PL1 then PL2
+    ThermalPowerLimit limits[kThermalPowerLimitMax];
+};
+
+struct ThermalPowerLimits {
+    UInt32 count;           // limits set, PL1 then PL2
+    UInt32 limit_uw[kThermalPowerLimitMax];
+};
+
+/**
+ * Copy the limits without blocking the writer
+ * @param capability Published by the processor participant
+ * @param limits Room for kThermalPowerLimitMax limits
+ *
+ * @return Number of limits copied
+ */
+static inline UInt32 readPowerCapability(const ThermalPowerCapability *capability, ThermalPowerLimit *limits) {
+    UInt32 begin, count;
+    do {
+        begin = seqReadBegin(&capability->sequence);
+        count = capability->count;
+        for (UInt32 i = 0; i < kThermalPowerLimitMax; i++)
+            limits[i] = capability->limits[i];
+    } while (seqReadRetry(&capability->sequence, begin));
+    return count;
+}
+
 #ifdef DEBUG
 #define DebugLog(str, ...) do { IOLog("%s::%s " str "\n", getName(), name, ## __VA_ARGS__); } while (0)
 #else
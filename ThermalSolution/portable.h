@@ -0,0 +1,24 @@
+//  SPDX-License-Identifier: GPL-2.0-only
+//
+//  portable.h
+//  ThermalSolution
+//
+//  Created by Zhen on 2026/10/17.
+//  Copyright © 2026 Zhen. All rights reserved.
+//
+//  Allocation for the kernel-agnostic sources, IOMalloc in the kext and the
+//  C library in the host build.
+//
+
+#ifndef portable_h
+#define portable_h
+
+#ifdef KERNEL
+#include <IOKit/IOLib.h>
+#else
+#include <stdlib.h>
+#define IOMalloc(size) malloc(size)
+#define IOFree(address, size) free(address)
+#endif
+
+#endif /* portable_h */